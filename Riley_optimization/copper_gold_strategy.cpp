@@ -5,47 +5,221 @@
 // No synthetic data. No lookahead bias. All signals use only data[0..i].
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <cmath>
-#include <ctime>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <functional>
 #include <unordered_set>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <numeric>
 #include <deque>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 // ============================================================
 // Date utilities
 // ============================================================
-static std::string trim(const std::string& s) {
+static std::string_view trim(std::string_view s) {
     size_t b = s.find_first_not_of(" \t\r\n");
-    if (b == std::string::npos) return "";
+    if (b == std::string_view::npos) return {};
     size_t e = s.find_last_not_of(" \t\r\n");
     return s.substr(b, e - b + 1);
 }
 
-static int parse_date(const std::string& d) {
-    std::tm t = {};
-    std::istringstream ss(d);
-    ss >> std::get_time(&t, "%Y-%m-%d");
-    if (ss.fail()) return -1;
-    t.tm_isdst = -1;
-    time_t ts = std::mktime(&t);
-    return static_cast<int>(ts / 86400);
+// Day keys are days since 1970-01-01 in the proleptic Gregorian calendar.
+// The codec below is pure integer arithmetic (H. Hinnant's days_from_civil /
+// civil_from_days), so keys never depend on libc time calls or the host TZ.
+struct CivilDate {
+    int y, m, d;
+};
+
+static constexpr int days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;                                  // [0, 399]
+    const int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;  // [0, 365]
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;          // [0, 146096]
+    return era * 146097 + doe - 719468;
+}
+
+static constexpr CivilDate civil_from_days(int z) {
+    z += 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const int doe = z - era * 146097;                                      // [0, 146096]
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;  // [0, 399]
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                // [0, 365]
+    const int mp = (5 * doy + 2) / 153;                                     // [0, 11]
+    const int d = doy - (153 * mp + 2) / 5 + 1;
+    const int m = mp < 10 ? mp + 3 : mp - 9;
+    return {era * 400 + yoe + (m <= 2), m, d};
+}
+
+// Parses YYYY-MM-DD (1-2 digit month/day accepted); -1 on malformed input.
+// constexpr so literals fold at compile time: parse_date("2014-11-01").
+static constexpr int parse_date(std::string_view s) {
+    int field[3] = {0, 0, 0};
+    size_t pos = 0;
+    for (int f = 0; f < 3; ++f) {
+        if (f > 0) {
+            if (pos >= s.size() || s[pos] != '-') return -1;
+            ++pos;
+        }
+        size_t start = pos;
+        while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9' && pos - start < 4)
+            field[f] = field[f] * 10 + (s[pos++] - '0');
+        if (pos == start) return -1;
+    }
+    if (field[1] < 1 || field[1] > 12 || field[2] < 1 || field[2] > 31) return -1;
+    return days_from_civil(field[0], field[1], field[2]);
+}
+
+static_assert(parse_date("1970-01-01") == 0, "epoch");
+static_assert(parse_date("2014-11-01") == 16375, "codec");
+static_assert(civil_from_days(16375).y == 2014 && civil_from_days(16375).m == 11 &&
+              civil_from_days(16375).d == 1, "codec round trip");
+
+// Writes YYYY-MM-DD into out[0..9] (not NUL-terminated)
+static void format_date(int day_key, char* out) {
+    const CivilDate c = civil_from_days(day_key);
+    int y = c.y;
+    for (int k = 3; k >= 0; --k) { out[k] = static_cast<char>('0' + y % 10); y /= 10; }
+    out[4] = '-';
+    out[5] = static_cast<char>('0' + c.m / 10);
+    out[6] = static_cast<char>('0' + c.m % 10);
+    out[7] = '-';
+    out[8] = static_cast<char>('0' + c.d / 10);
+    out[9] = static_cast<char>('0' + c.d % 10);
 }
 
 static std::string date_from_int(int day_key) {
-    time_t ts = static_cast<time_t>(day_key) * 86400;
-    std::tm* t = std::gmtime(&ts);
-    char buf[16];
-    std::strftime(buf, sizeof(buf), "%Y-%m-%d", t);
-    return std::string(buf);
+    char buf[10];
+    format_date(day_key, buf);
+    return std::string(buf, sizeof(buf));
+}
+
+// Batch formatter: one string per key, computed once up front
+static std::vector<std::string> format_dates(const std::vector<int>& day_keys) {
+    std::vector<std::string> out(day_keys.size(), std::string(10, '0'));
+    for (size_t k = 0; k < day_keys.size(); ++k)
+        format_date(day_keys[k], out[k].data());
+    return out;
+}
+
+// 0 = Sunday .. 6 = Saturday (1970-01-01 was a Thursday)
+static constexpr int weekday(int day_key) {
+    return ((day_key % 7) + 11) % 7;
 }
+static_assert(weekday(0) == 4 && weekday(16375) == 6, "weekday");
+
+// ISO-8601 week as yyyyww: weeks start on Monday and belong to the year
+// holding their Thursday
+static constexpr int iso_week(int day_key) {
+    const int thursday = day_key - (weekday(day_key) + 6) % 7 + 3;
+    const int y = civil_from_days(thursday).y;
+    return y * 100 + (thursday - days_from_civil(y, 1, 1)) / 7 + 1;
+}
+static_assert(iso_week(parse_date("2014-11-01")) == 201444, "iso week");
+static_assert(iso_week(parse_date("2021-01-01")) == 202053, "iso week year");
+
+// ============================================================
+// Trading calendar
+// ============================================================
+// Built once from the panel's day keys: weekday per row, a start-of-period
+// bitset and the row offsets of every period per boundary, so schedules
+// and rolling-year counters are lookups rather than date arithmetic in
+// the daily loops. A period ends on the row before the next one starts;
+// the last row of the calendar closes nothing until another is appended.
+class TradingCalendar {
+public:
+    enum Boundary { WEEK, MONTH, QUARTER, YEAR, BOUNDARY_COUNT };
+
+    // Index steps the signal loops and metrics treat as one year
+    static constexpr int TRADING_YEAR = 252;
+
+    TradingCalendar() = default;
+    explicit TradingCalendar(const std::vector<int>& days) {
+        days_.reserve(days.size());
+        weekday_.reserve(days.size());
+        for (int d : days) append(d);
+    }
+
+    // Day keys must be ascending
+    void append(int day) {
+        const size_t i = days_.size();
+        if (i % 64 == 0)
+            for (auto& bits : starts_) bits.push_back(0);
+        for (int b = 0; b < BOUNDARY_COUNT; ++b) {
+            const int key = period_key(static_cast<Boundary>(b), day);
+            if (i == 0 || key != last_key_[b]) {
+                starts_[b][i / 64] |= uint64_t(1) << (i % 64);
+                offsets_[b].push_back(static_cast<uint32_t>(i));
+                last_key_[b] = key;
+            }
+            period_[b].push_back(static_cast<uint32_t>(offsets_[b].size() - 1));
+        }
+        days_.push_back(day);
+        weekday_.push_back(static_cast<uint8_t>(::weekday(day)));
+        // First row less than 365 calendar days back
+        size_t lo = i == 0 ? 0 : year_back_.back();
+        while (days_[lo] <= day - 365) ++lo;
+        year_back_.push_back(static_cast<uint32_t>(lo));
+    }
+
+    size_t size() const { return days_.size(); }
+    int day(size_t i) const { return days_[i]; }
+    int weekday(size_t i) const { return weekday_[i]; }
+    bool is_friday(size_t i) const { return weekday_[i] == 5; }
+    int iso_week(size_t i) const { return ::iso_week(days_[i]); }
+
+    bool starts(Boundary b, size_t i) const { return (starts_[b][i / 64] >> (i % 64)) & 1; }
+    bool ends(Boundary b, size_t i) const { return i + 1 < size() && starts(b, i + 1); }
+
+    // Periods of a boundary and their first rows, ascending
+    size_t periods(Boundary b) const { return offsets_[b].size(); }
+    size_t period_begin(Boundary b, size_t i) const { return offsets_[b][period_[b][i]]; }
+
+    // 1-based business day of row i within its period; nth(MONTH, i) == 1
+    // flags the first trading day of each month
+    int nth(Boundary b, size_t i) const { return static_cast<int>(i - period_begin(b, i)) + 1; }
+
+    // First row of the TRADING_YEAR-step window ending at row i
+    static constexpr size_t trailing_year_begin(size_t i) {
+        return i > static_cast<size_t>(TRADING_YEAR) ? i - TRADING_YEAR : 0;
+    }
+    // First row of the 365-calendar-day window ending at row i
+    size_t trailing_calendar_year_begin(size_t i) const { return year_back_[i]; }
+
+private:
+    static int period_key(Boundary b, int day) {
+        if (b == WEEK) return (day + 3 - (day + 3 < 0 ? 6 : 0)) / 7;   // Monday-based week
+        const CivilDate c = civil_from_days(day);
+        switch (b) {
+            case MONTH:   return c.y * 12 + c.m - 1;
+            case QUARTER: return c.y * 4 + (c.m - 1) / 3;
+            default:      return c.y;
+        }
+    }
+
+    std::vector<int> days_;
+    std::vector<uint8_t> weekday_;
+    std::vector<uint64_t> starts_[BOUNDARY_COUNT];
+    std::vector<uint32_t> offsets_[BOUNDARY_COUNT];
+    std::vector<uint32_t> period_[BOUNDARY_COUNT];
+    std::vector<uint32_t> year_back_;
+    int last_key_[BOUNDARY_COUNT] = {};
+};
 
 // ============================================================
 // Data types
@@ -57,80 +231,231 @@ struct OHLCVBar {
 using TimeSeries = std::map<int, double>;
 using FuturesSeries = std::map<int, OHLCVBar>;
 
+// ============================================================
+// Thread pool
+// ============================================================
+// Fixed set of workers fed from one task queue. parallel_for() fans a loop
+// out across the workers, runs its share on the calling thread and returns
+// once every index is done (rethrowing the first exception, if any).
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = default_threads()) {
+        for (unsigned t = 0; t < threads; ++t)
+            workers_.emplace_back([this] { worker_loop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static unsigned default_threads() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn) {
+        if (count == 0) return;
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_mu;
+        auto drain = [&] {
+            for (size_t k = next++; k < count; k = next++) {
+                try {
+                    fn(k);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lk(error_mu);
+                    if (!error) error = std::current_exception();
+                }
+            }
+        };
+
+        size_t active = std::min(count - 1, workers_.size());  // guarded by mu_
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            for (size_t h = active; h > 0; --h)
+                tasks_.emplace_back([&] {
+                    drain();
+                    {
+                        std::lock_guard<std::mutex> lk2(mu_);
+                        --active;
+                    }
+                    cv_.notify_all();
+                });
+        }
+        cv_.notify_all();
+        drain();
+
+        // Run queued tasks while waiting instead of blocking, so a
+        // parallel_for issued from inside a worker cannot deadlock the pool
+        std::unique_lock<std::mutex> lk(mu_);
+        while (active > 0) {
+            if (tasks_.empty()) {
+                cv_.wait(lk);
+                continue;
+            }
+            auto task = std::move(tasks_.front());
+            tasks_.pop_front();
+            lk.unlock();
+            task();
+            lk.lock();
+        }
+        lk.unlock();
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    void worker_loop() {
+        std::unique_lock<std::mutex> lk(mu_);
+        for (;;) {
+            cv_.wait(lk, [this] { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;  // stop_ with nothing left to run
+            auto task = std::move(tasks_.front());
+            tasks_.pop_front();
+            lk.unlock();
+            task();
+            lk.lock();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+// Process-wide pool shared by the loaders
+static ThreadPool& shared_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// ============================================================
+// CSV tokenizer
+// ============================================================
+// Each file is read into one buffer and walked with string_view cursors;
+// numbers are parsed in place with std::from_chars, so a row costs no
+// heap allocation.
+static bool read_file(const std::string& path, std::string& buf) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    buf.clear();
+    if (std::fseek(f, 0, SEEK_END) == 0) {
+        long len = std::ftell(f);
+        if (len > 0) buf.reserve(static_cast<size_t>(len));
+        std::rewind(f);
+    }
+    char chunk[1 << 16];
+    size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.append(chunk, got);
+    std::fclose(f);
+    return true;
+}
+
+// Splits the next line (without its '\n') off the front of `rest`
+static bool next_line(std::string_view& rest, std::string_view& line) {
+    if (rest.empty()) return false;
+    size_t nl = rest.find('\n');
+    if (nl == std::string_view::npos) {
+        line = rest;
+        rest = {};
+    } else {
+        line = rest.substr(0, nl);
+        rest.remove_prefix(nl + 1);
+    }
+    return true;
+}
+
+// Splits the next comma-separated field off the front of `line`;
+// empty once the line is used up
+static std::string_view next_field(std::string_view& line) {
+    size_t comma = line.find(',');
+    std::string_view field = line.substr(0, comma);
+    if (comma == std::string_view::npos) line = {};
+    else line.remove_prefix(comma + 1);
+    return field;
+}
+
+// Same acceptance as std::stod on a trimmed field: optional '+', longest
+// numeric prefix, false when nothing converts or the value is out of range
+static bool parse_double(std::string_view s, double& out) {
+    if (!s.empty() && s.front() == '+') {
+        s.remove_prefix(1);
+        if (!s.empty() && (s.front() == '+' || s.front() == '-')) return false;
+    }
+    auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+    return r.ec == std::errc();
+}
+
 // ============================================================
 // CSV loaders
 // ============================================================
-static FuturesSeries load_futures(const std::string& path) {
+static FuturesSeries load_futures(const std::string& path, std::ostream& warn = std::cerr) {
     FuturesSeries out;
-    std::ifstream f(path);
-    if (!f.is_open()) {
-        std::cerr << "[WARN] Cannot open: " << path << "\n";
+    std::string buf;
+    if (!read_file(path, buf)) {
+        warn << "[WARN] Cannot open: " << path << "\n";
         return out;
     }
-    std::string line;
-    std::getline(f, line); // skip header
-    while (std::getline(f, line)) {
+    std::string_view rest(buf), line;
+    next_line(rest, line); // skip header
+    while (next_line(rest, line)) {
         if (line.empty()) continue;
-        std::istringstream ss(line);
-        std::string date_s, o_s, h_s, l_s, c_s, v_s;
-        std::getline(ss, date_s, ',');
-        std::getline(ss, o_s, ',');
-        std::getline(ss, h_s, ',');
-        std::getline(ss, l_s, ',');
-        std::getline(ss, c_s, ',');
-        std::getline(ss, v_s, ',');
+        std::string_view date_s = next_field(line);
+        std::string_view o_s = next_field(line);
+        std::string_view h_s = next_field(line);
+        std::string_view l_s = next_field(line);
+        std::string_view c_s = next_field(line);
+        std::string_view v_s = next_field(line);
 
         int dk = parse_date(trim(date_s));
         if (dk < 0) continue;
 
+        // HG (Copper) needs no conversion - data is in $/lb and the
+        // notional normalization formula handles the conversion
         OHLCVBar bar;
-        try {
-            double raw_open = std::stod(trim(o_s));
-            double raw_high = std::stod(trim(h_s));
-            double raw_low = std::stod(trim(l_s));
-            double raw_close = std::stod(trim(c_s));
-
-            // Check if this is HG (Copper) - no conversion needed, data is in $/lb
-            // The notional normalization formula handles the conversion
-            bar.open = raw_open;
-            bar.high = raw_high;
-            bar.low = raw_low;
-            bar.close = raw_close;
-
-            bar.volume = v_s.empty() ? 0.0 : std::stod(trim(v_s));
-        } catch (...) { continue; }
-        out[dk] = bar;
+        if (!parse_double(trim(o_s), bar.open) ||
+            !parse_double(trim(h_s), bar.high) ||
+            !parse_double(trim(l_s), bar.low) ||
+            !parse_double(trim(c_s), bar.close))
+            continue;
+        if (v_s.empty()) bar.volume = 0.0;
+        else if (!parse_double(trim(v_s), bar.volume)) continue;
+
+        out.insert_or_assign(out.end(), dk, bar);
     }
     return out;
 }
-// Helper function to check if all positions are zero
-static bool all_positions_zero(const std::unordered_map<std::string, double>& positions) {
-    for (const auto& [sym, qty] : positions) {
-        if (qty != 0.0) return false;
-    }
-    return true;
-}
 
-static TimeSeries load_macro(const std::string& path) {
+static TimeSeries load_macro(const std::string& path, std::ostream& warn = std::cerr) {
     TimeSeries out;
-    std::ifstream f(path);
-    if (!f.is_open()) {
-        std::cerr << "[WARN] Cannot open: " << path << "\n";
+    std::string buf;
+    if (!read_file(path, buf)) {
+        warn << "[WARN] Cannot open: " << path << "\n";
         return out;
     }
-    std::string line;
-    std::getline(f, line); // skip header
-    while (std::getline(f, line)) {
+    std::string_view rest(buf), line;
+    next_line(rest, line); // skip header
+    while (next_line(rest, line)) {
         if (line.empty()) continue;
-        std::istringstream ss(line);
-        std::string date_s, val_s;
-        std::getline(ss, date_s, ',');
-        std::getline(ss, val_s, ',');
-        date_s = trim(date_s);
-        val_s = trim(val_s);
+        std::string_view date_s = trim(next_field(line));
+        std::string_view val_s = trim(next_field(line));
         int dk = parse_date(date_s);
         if (dk < 0 || val_s.empty() || val_s == "." || val_s == "NA") continue;
-        try { out[dk] = std::stod(val_s); } catch (...) { continue; }
+        double v;
+        if (!parse_double(val_s, v)) continue;
+        out.insert_or_assign(out.end(), dk, v);
     }
     return out;
 }
@@ -153,43 +478,208 @@ static double ffill_fut_close(const FuturesSeries& ts, int dk) {
 // ============================================================
 // Rolling statistics
 // ============================================================
+// Neumaier-compensated running sum
+struct CompensatedSum {
+    double sum = 0.0, comp = 0.0;
+
+    void add(double x) {
+        double t = sum + x;
+        if (std::abs(sum) >= std::abs(x)) comp += (sum - t) + x;
+        else                              comp += (x - t) + sum;
+        sum = t;
+    }
+    double value() const { return sum + comp; }
+};
+
+// Fixed-window mean / population std over a stream, O(1) per push. The sum
+// is compensated and the second moment is updated with the sliding Welford
+// recurrence; both are recomputed exactly (same order as the naive loop)
+// every `window` pushes so rounding cannot drift. Non-finite values are
+// counted instead of summed, which reproduces the naive results: NaN (or
+// both infinities) in the window gives a NaN mean, one-signed infinity gives
+// that infinity, and std is NaN while any non-finite value is in the window.
+class RollingWindow {
+public:
+    explicit RollingWindow(int window)
+        : window_(window), ring_(static_cast<size_t>(std::max(window, 1)), 0.0) {}
+
+    void push(double x) {
+        const size_t w = ring_.size();
+        const size_t slot = pushed_ % w;
+        const bool evict = pushed_ >= w;
+        const double y = ring_[slot];
+        ring_[slot] = x;
+        ++pushed_;
+
+        if (evict) drop(y);
+        take(x);
+        if (evict && std::isfinite(x) && std::isfinite(y) && nonfinite() == 0 && !dirty_) {
+            double old_mean = mean_;
+            mean_ = sum_.value() / window_;
+            m2_ += (x - y) * (x - mean_ + y - old_mean);
+        } else {
+            dirty_ = true;
+        }
+        if (full() && (dirty_ || ++since_sync_ >= w) && nonfinite() == 0) resync();
+    }
+
+    bool full() const { return pushed_ >= ring_.size(); }
+
+    double mean() const {
+        if (nan_ > 0 || (pos_inf_ > 0 && neg_inf_ > 0)) return std::numeric_limits<double>::quiet_NaN();
+        if (pos_inf_ > 0) return std::numeric_limits<double>::infinity();
+        if (neg_inf_ > 0) return -std::numeric_limits<double>::infinity();
+        return sum_.value() / window_;
+    }
+
+    double stddev() const {
+        if (nonfinite() > 0) return std::numeric_limits<double>::quiet_NaN();
+        return std::sqrt(std::max(m2_, 0.0) / window_);
+    }
+
+private:
+    int nonfinite() const { return nan_ + pos_inf_ + neg_inf_; }
+
+    void take(double x) {
+        if (std::isnan(x)) ++nan_;
+        else if (std::isinf(x)) ++(x > 0 ? pos_inf_ : neg_inf_);
+        else sum_.add(x);
+    }
+    void drop(double y) {
+        if (std::isnan(y)) --nan_;
+        else if (std::isinf(y)) --(y > 0 ? pos_inf_ : neg_inf_);
+        else sum_.add(-y);
+    }
+
+    // Exact two-pass recompute over the window, oldest value first
+    void resync() {
+        const size_t w = ring_.size();
+        double sum = 0.0;
+        for (size_t k = 0; k < w; ++k) sum += ring_[(pushed_ + k) % w];
+        sum_ = CompensatedSum{sum, 0.0};
+        mean_ = sum / window_;
+        double var = 0.0;
+        for (size_t k = 0; k < w; ++k) {
+            double d = ring_[(pushed_ + k) % w] - mean_;
+            var += d * d;
+        }
+        m2_ = var;
+        dirty_ = false;
+        since_sync_ = 0;
+    }
+
+    int window_;
+    std::vector<double> ring_;
+    size_t pushed_ = 0;
+    size_t since_sync_ = 0;
+    CompensatedSum sum_;
+    double mean_ = 0.0, m2_ = 0.0;
+    bool dirty_ = true;
+    int nan_ = 0, pos_inf_ = 0, neg_inf_ = 0;
+};
+
 static std::vector<double> rolling_mean(const std::vector<double>& v, int window) {
     std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
-    for (int i = window - 1; i < (int)v.size(); ++i) {
-        double sum = 0.0;
-        for (int j = i - window + 1; j <= i; ++j) sum += v[j];
-        out[i] = sum / window;
+    RollingWindow rw(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        rw.push(v[i]);
+        if (rw.full()) out[i] = rw.mean();
     }
     return out;
 }
 
 static std::vector<double> rolling_std(const std::vector<double>& v, int window) {
     std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
-    for (int i = window - 1; i < (int)v.size(); ++i) {
-        double mean = 0.0;
-        for (int j = i - window + 1; j <= i; ++j) mean += v[j];
-        mean /= window;
-        double var = 0.0;
-        for (int j = i - window + 1; j <= i; ++j) var += (v[j] - mean) * (v[j] - mean);
-        out[i] = std::sqrt(var / window);
+    RollingWindow rw(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        rw.push(v[i]);
+        if (rw.full()) out[i] = rw.stddev();
     }
     return out;
 }
 
 static std::vector<double> rolling_zscore(const std::vector<double>& v, int window) {
-    auto sma = rolling_mean(v, window);
-    auto std_ = rolling_std(v, window);
     std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
-    for (int i = 0; i < (int)v.size(); ++i) {
-        if (!std::isnan(sma[i]) && !std::isnan(std_[i]) && std_[i] > 0.0)
-            out[i] = (v[i] - sma[i]) / std_[i];
+    RollingWindow rw(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        rw.push(v[i]);
+        if (!rw.full()) continue;
+        double sma = rw.mean(), sd = rw.stddev();
+        if (!std::isnan(sma) && !std::isnan(sd) && sd > 0.0)
+            out[i] = (v[i] - sma) / sd;
     }
     return out;
 }
 
-// ATR calculation
-static std::vector<double> compute_atr(const std::vector<int>& dates,
-                                       const FuturesSeries& fut, int window = 20) {
+// Sliding window of the last w values kept as a sorted ring: the raw ring
+// remembers arrival order for eviction, `sorted_` holds the non-NaN values
+// in order for rank and quantile queries. Both are allocated once.
+class SlidingRank {
+public:
+    explicit SlidingRank(int window) : ring_(static_cast<size_t>(std::max(window, 1))) {
+        sorted_.reserve(ring_.size());
+    }
+
+    // NaN occupies a slot in the window but is never ranked
+    void push(double x) {
+        const size_t w = ring_.size();
+        const size_t slot = pushed_ % w;
+        if (pushed_ >= w && !std::isnan(ring_[slot]))
+            sorted_.erase(std::lower_bound(sorted_.begin(), sorted_.end(), ring_[slot]));
+        ring_[slot] = x;
+        ++pushed_;
+        if (!std::isnan(x))
+            sorted_.insert(std::upper_bound(sorted_.begin(), sorted_.end(), x), x);
+    }
+
+    bool full() const { return pushed_ >= ring_.size(); }
+    size_t count() const { return sorted_.size(); }
+
+    // Number of ranked values strictly below x (0 for NaN)
+    size_t rank(double x) const {
+        return std::lower_bound(sorted_.begin(), sorted_.end(), x) - sorted_.begin();
+    }
+
+    // floor(q * count)-th order statistic, clamped to the largest value
+    double quantile(double q) const {
+        if (sorted_.empty()) return std::numeric_limits<double>::quiet_NaN();
+        size_t idx = static_cast<size_t>(q * sorted_.size());
+        return sorted_[std::min(idx, sorted_.size() - 1)];
+    }
+
+private:
+    std::vector<double> ring_;
+    std::vector<double> sorted_;
+    size_t pushed_ = 0;
+};
+
+// Percentile rank of each value within its trailing window (NaNs skipped);
+// NaN until the window is full or while it holds no values
+static std::vector<double> rolling_percentile_rank(const std::vector<double>& v, int window) {
+    std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
+    SlidingRank sr(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        sr.push(v[i]);
+        if (sr.full() && sr.count() > 0)
+            out[i] = static_cast<double>(sr.rank(v[i])) / sr.count();
+    }
+    return out;
+}
+
+// Trailing-window q-quantile (NaNs skipped), NaN until the window is full
+static std::vector<double> rolling_quantile(const std::vector<double>& v, int window, double q) {
+    std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
+    SlidingRank sr(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        sr.push(v[i]);
+        if (sr.full()) out[i] = sr.quantile(q);
+    }
+    return out;
+}
+
+// True range per calendar day; NaN where the instrument has no bar that day
+// or no earlier bar to take the previous close from
+static std::vector<double> true_range(const std::vector<int>& dates, const FuturesSeries& fut) {
     std::vector<double> tr(dates.size(), std::numeric_limits<double>::quiet_NaN());
     for (int i = 1; i < (int)dates.size(); ++i) {
         auto it = fut.find(dates[i]);
@@ -204,44 +694,194 @@ static std::vector<double> compute_atr(const std::vector<int>& dates,
                           std::abs(hi - prev_close),
                           std::abs(lo - prev_close)});
     }
-    return rolling_mean(tr, window);
+    return tr;
 }
 
-// Average pairwise correlation
-static double avg_pairwise_corr(
-    const std::vector<std::vector<double>>& ret_series,
-    int i, int window)
-{
-    int n = static_cast<int>(ret_series.size());
-    if (n < 2 || i < window - 1) return 0.0;
-
-    double sum_corr = 0.0;
-    int pairs = 0;
-    for (int a = 0; a < n; ++a) {
-        for (int b = a + 1; b < n; ++b) {
-            double ma = 0.0, mb = 0.0;
-            int valid = 0;
-            for (int k = i - window + 1; k <= i; ++k) {
-                double ra = ret_series[a][k], rb = ret_series[b][k];
-                if (!std::isnan(ra) && !std::isnan(rb)) {
-                    ma += ra; mb += rb; ++valid;
+// ATR calculation
+static std::vector<double> compute_atr(const std::vector<int>& dates,
+                                       const FuturesSeries& fut, int window = 20) {
+    return rolling_mean(true_range(dates, fut), window);
+}
+
+// Mean of the defined values in each trailing window, NaN if there are none.
+// Summed in window order so it matches a per-day loop bit for bit; meant for
+// short windows like the ATR stop's.
+static std::vector<double> rolling_nanmean(const std::vector<double>& v, int window) {
+    std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
+    for (int i = window - 1; i < (int)v.size(); ++i) {
+        double sum = 0.0;
+        int count = 0;
+        for (int k = i - window + 1; k <= i; ++k) {
+            if (std::isnan(v[k])) continue;
+            sum += v[k];
+            ++count;
+        }
+        if (count > 0) out[i] = sum / count;
+    }
+    return out;
+}
+
+// Rolling cross-moments of N series over a fixed window with pairwise NaN
+// masking: pair (a, b) only accumulates the days on which both are present,
+// as the per-day correlation loop did. Each push adds the new day and evicts
+// the oldest in O(N^2) with the sliding Welford / co-moment recurrence; the
+// moments are rebuilt two-pass from the ring every `window` pushes so
+// add/evict rounding cannot accumulate. Infinite values are counted instead
+// of accumulated, as RollingWindow does: a pair is undefined (NaN) while one
+// is in its window, which is what the naive loop's inf - inf gave.
+class RollingCrossMoments {
+public:
+    RollingCrossMoments(int nseries, int window)
+        : n_(nseries), w_(static_cast<size_t>(std::max(window, 1))),
+          ring_(w_ * nseries), pairs_(static_cast<size_t>(nseries) * nseries) {}
+
+    // One day's values, row[0..N); NaN marks a missing observation
+    void push(const double* row) {
+        const size_t slot = pushed_ % w_;
+        double* dst = &ring_[slot * n_];
+        if (pushed_ >= w_) accumulate(dst, false);
+        std::copy(row, row + n_, dst);
+        accumulate(dst, true);
+        ++pushed_;
+        if (++since_sync_ >= w_) resync();
+    }
+
+    bool full() const { return pushed_ >= w_; }
+
+    // Pairwise correlation over jointly present days; NaN with fewer than
+    // two such days, an infinite value in the window or zero variance on
+    // either side
+    double correlation(int a, int b) const {
+        const Moments& m = pairs_[index(a, b)];
+        if (m.n < 2 || m.inf > 0) return std::numeric_limits<double>::quiet_NaN();
+        const double denom = std::sqrt(std::max(m.m2a, 0.0) * std::max(m.m2b, 0.0));
+        return denom > 0.0 ? m.cab / denom : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // Full N x N correlation matrix, row-major
+    std::vector<double> correlation_matrix() const {
+        std::vector<double> out(static_cast<size_t>(n_) * n_);
+        for (int a = 0; a < n_; ++a)
+            for (int b = 0; b < n_; ++b)
+                out[static_cast<size_t>(a) * n_ + b] = correlation(a, b);
+        return out;
+    }
+
+    // Mean of the defined off-diagonal correlations, 0 if there are none
+    double avg_offdiag_corr() const {
+        double sum = 0.0;
+        int pairs = 0;
+        for (int a = 0; a < n_; ++a)
+            for (int b = a + 1; b < n_; ++b) {
+                double c = correlation(a, b);
+                if (!std::isnan(c)) { sum += c; ++pairs; }
+            }
+        return pairs > 0 ? sum / pairs : 0.0;
+    }
+
+private:
+    // Moments of the jointly present finite days of pair (a, b), a <= b:
+    // means, centred second moments and co-moment; `inf` counts the days
+    // held back because either value is infinite
+    struct Moments {
+        int n = 0, inf = 0;
+        double ma = 0.0, mb = 0.0, m2a = 0.0, m2b = 0.0, cab = 0.0;
+    };
+
+    // Upper triangle only (a <= b)
+    size_t index(int a, int b) const {
+        if (a > b) std::swap(a, b);
+        return static_cast<size_t>(a) * n_ + b;
+    }
+
+    // Adds (or evicts) one day
+    void accumulate(const double* row, bool add) {
+        for (int a = 0; a < n_; ++a) {
+            const double ra = row[a];
+            if (std::isnan(ra)) continue;
+            for (int b = a; b < n_; ++b) {
+                const double rb = row[b];
+                if (std::isnan(rb)) continue;
+                Moments& m = pairs_[static_cast<size_t>(a) * n_ + b];
+                if (std::isinf(ra) || std::isinf(rb)) {
+                    m.inf += add ? 1 : -1;
+                    continue;
+                }
+                // Deviations from the old means, updated means, then the
+                // moments against the new means (add and evict are mirrors)
+                if (!add && m.n == 1) {
+                    m = Moments{0, m.inf};
+                    continue;
                 }
+                const double da = ra - m.ma, db = rb - m.mb;
+                const int sign = add ? 1 : -1;
+                m.n += sign;
+                m.ma += sign * da / m.n;
+                m.mb += sign * db / m.n;
+                m.m2a += sign * da * (ra - m.ma);
+                m.m2b += sign * db * (rb - m.mb);
+                m.cab += sign * da * (rb - m.mb);
             }
-            if (valid < 2) continue;
-            ma /= valid; mb /= valid;
-            double cov = 0.0, va = 0.0, vb = 0.0;
-            for (int k = i - window + 1; k <= i; ++k) {
-                double ra = ret_series[a][k], rb = ret_series[b][k];
-                if (!std::isnan(ra) && !std::isnan(rb)) {
-                    double da = ra - ma, db = rb - mb;
-                    cov += da * db; va += da * da; vb += db * db;
+        }
+    }
+
+    // Exact two-pass rebuild over the window, oldest day first
+    void resync() {
+        const size_t rows = std::min(pushed_, w_);
+        const size_t first = pushed_ >= w_ ? pushed_ % w_ : 0;
+        auto row = [&](size_t k) { return &ring_[((first + k) % w_) * n_]; };
+        for (int a = 0; a < n_; ++a) {
+            for (int b = a; b < n_; ++b) {
+                Moments m;
+                double sa = 0.0, sb = 0.0;
+                for (size_t k = 0; k < rows; ++k) {
+                    const double ra = row(k)[a], rb = row(k)[b];
+                    if (std::isnan(ra) || std::isnan(rb)) continue;
+                    if (std::isinf(ra) || std::isinf(rb)) { ++m.inf; continue; }
+                    sa += ra; sb += rb; ++m.n;
                 }
+                if (m.n > 0) {
+                    m.ma = sa / m.n;
+                    m.mb = sb / m.n;
+                    for (size_t k = 0; k < rows; ++k) {
+                        const double ra = row(k)[a], rb = row(k)[b];
+                        if (!std::isfinite(ra) || !std::isfinite(rb)) continue;
+                        const double da = ra - m.ma, db = rb - m.mb;
+                        m.m2a += da * da; m.m2b += db * db; m.cab += da * db;
+                    }
+                }
+                pairs_[static_cast<size_t>(a) * n_ + b] = m;
             }
-            double denom = std::sqrt(va * vb);
-            if (denom > 0.0) { sum_corr += cov / denom; ++pairs; }
         }
+        since_sync_ = 0;
+    }
+
+    int n_;
+    size_t w_;
+    std::vector<double> ring_;     // w rows of N values
+    std::vector<Moments> pairs_;   // N x N, upper triangle used
+    size_t pushed_ = 0;
+    size_t since_sync_ = 0;
+};
+
+// Average pairwise correlation of the return series over a trailing window,
+// one column for the whole history (0 before the window fills)
+static std::vector<double> rolling_avg_pairwise_corr(
+    const std::vector<std::vector<double>>& ret_series, int window)
+{
+    const int nser = static_cast<int>(ret_series.size());
+    const size_t len = ret_series.empty() ? 0 : ret_series[0].size();
+    std::vector<double> out(len, 0.0);
+    if (nser < 2) return out;
+
+    RollingCrossMoments rcm(nser, window);
+    std::vector<double> row(nser);
+    for (size_t i = 0; i < len; ++i) {
+        for (int a = 0; a < nser; ++a) row[a] = ret_series[a][i];
+        rcm.push(row.data());
+        if (rcm.full()) out[i] = rcm.avg_offdiag_corr();
     }
-    return (pairs > 0) ? sum_corr / pairs : 0.0;
+    return out;
 }
 
 // ============================================================
@@ -271,6 +911,45 @@ static const char* regime_str(Regime r) {
     }
 }
 
+// ============================================================
+// Instrument registry - dense ids for the traded futures
+// ============================================================
+namespace Inst {
+enum Id : int { HG, GC, CL, SI, ZN, UB, JY, MES, MNQ, COUNT };
+
+static constexpr Id ALL[COUNT] = {HG, GC, CL, SI, ZN, UB, JY, MES, MNQ};
+static constexpr const char* SYMBOLS[COUNT] = {
+    "HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"
+};
+
+static const char* symbol(Id id) { return SYMBOLS[id]; }
+
+// Point values ($ per 1.0 price move)
+static constexpr double POINT_VALUE[COUNT] = {
+    250.0,    // HG: 1 cent = $250
+    100.0,    // GC: $1 = $100
+    1000.0,   // CL: $1 = $1000
+    5000.0,   // SI: $1 = $5000
+    1000.0,   // ZN: 1 point = $1000
+    1000.0,   // UB: 1 point = $1000
+    12.50,    // 6J: 1 pip = $12.50
+    5.0,      // MES: 1 point = $5
+    2.0       // MNQ: 1 point = $2
+};
+}
+using InstrumentId = Inst::Id;
+
+// Per-instrument state indexed by InstrumentId (positions, prices, attribution)
+template <typename T>
+using PerInstrument = std::array<T, Inst::COUNT>;
+
+static bool all_positions_zero(const PerInstrument<double>& positions) {
+    for (double qty : positions) {
+        if (qty != 0.0) return false;
+    }
+    return true;
+}
+
 // ============================================================
 // Contract specifications - EXACT from document
 // ============================================================
@@ -287,29 +966,26 @@ struct Spec {
 
 // REVISED costs: commission = broker ($0.85/side IBKR) + exchange + clearing ($0.05) + NFA ($0.02), RT
 // Spread/slippage from 2025 fee research (see docs/proposals/transaction-costs.md Section 2)
-static const std::unordered_map<std::string, Spec> specs = {
-//  sym     margin     notional   tick_size   tick_val  comm_rt  spread_t  slip_t
-    {"HG",  {6000.0,  127000.0,  0.0005,     12.50,    5.14,    1.0,      0.5}},
-    {"GC",  {11000.0, 420000.0,  0.10,       10.00,    5.14,    1.0,      0.5}},
-    {"CL",  {7000.0,   60000.0,  0.01,       10.00,    4.90,    1.0,      0.5}},
-    {"MES", {1500.0,   34000.0,  0.25,        1.25,    1.30,    1.0,      0.5}},
-    {"MNQ", {2000.0,   51000.0,  0.25,        0.50,    1.30,    1.0,      0.5}},
-    {"ZN",  {2500.0,  113000.0,  0.015625,   15.625,   4.50,    0.5,      0.5}},
-    {"UB",  {9000.0,  122000.0,  0.03125,    31.25,    4.70,    1.0,      1.0}},
-    {"6J",  {4000.0,   81000.0,  0.000001,   12.50,    5.10,    1.0,      0.5}},
-    {"SI",  {10000.0, 265000.0,  0.005,      25.00,    5.14,    1.0,      1.0}},
+// Rows in InstrumentId order
+static constexpr Spec specs[Inst::COUNT] = {
+//   margin     notional   tick_size   tick_val  comm_rt  spread_t  slip_t
+    {6000.0,  127000.0,  0.0005,     12.50,    5.14,    1.0,      0.5},  // HG
+    {11000.0, 420000.0,  0.10,       10.00,    5.14,    1.0,      0.5},  // GC
+    {7000.0,   60000.0,  0.01,       10.00,    4.90,    1.0,      0.5},  // CL
+    {10000.0, 265000.0,  0.005,      25.00,    5.14,    1.0,      1.0},  // SI
+    {2500.0,  113000.0,  0.015625,   15.625,   4.50,    0.5,      0.5},  // ZN
+    {9000.0,  122000.0,  0.03125,    31.25,    4.70,    1.0,      1.0},  // UB
+    {4000.0,   81000.0,  0.000001,   12.50,    5.10,    1.0,      0.5},  // 6J
+    {1500.0,   34000.0,  0.25,        1.25,    1.30,    1.0,      0.5},  // MES
+    {2000.0,   51000.0,  0.25,        0.50,    1.30,    1.0,      0.5},  // MNQ
 };
 
-static Spec get(const std::string& sym) {
-    auto it = specs.find(sym);
-    if (it != specs.end()) return it->second;
-    return {5000.0, 100000.0, 0.01, 10.0, 2.50, 1.0, 0.5};
-}
+static const Spec& get(InstrumentId id) { return specs[id]; }
 
 // doc Phase 6 line 749: "spread + slippage + commission per contract"
 // round-trip cost = commission + spread (paid once on entry) + 2 * slippage (entry + exit)
-static double total_cost_rt(const std::string& sym) {
-    const Spec s = get(sym);
+static double total_cost_rt(InstrumentId id) {
+    const Spec& s = get(id);
     return s.commission_rt
          + (s.spread_ticks * s.tick_value)
          + (2.0 * s.slippage_ticks * s.tick_value);
@@ -317,28 +993,36 @@ static double total_cost_rt(const std::string& sym) {
 }
 
 // doc: "Base Notional Allocation — allocation weights by asset class"
-static const std::unordered_map<std::string, double> ASSET_WEIGHTS = {
-    {"equity_index", 0.30},  // MES, MNQ
-    {"commodities",  0.35},  // CL, HG, GC, SI
-    {"fixed_income", 0.25},  // ZN, UB
-    {"fx",           0.10},  // 6J
+enum class AssetClass : int { EQUITY_INDEX, COMMODITIES, FIXED_INCOME, FX };
+
+static constexpr double ASSET_WEIGHTS[] = {
+    0.30,  // equity_index: MES, MNQ
+    0.35,  // commodities:  CL, HG, GC, SI
+    0.25,  // fixed_income: ZN, UB
+    0.10,  // fx:           6J
 };
 
-static std::string asset_class(const std::string& sym) {
-    if (sym == "MES" || sym == "MNQ") return "equity_index";
-    if (sym == "CL" || sym == "HG" || sym == "GC" || sym == "SI") return "commodities";
-    if (sym == "ZN" || sym == "UB") return "fixed_income";
-    if (sym == "6J") return "fx";
-    return "commodities";
+static AssetClass asset_class(InstrumentId id) {
+    switch (id) {
+        case Inst::MES: case Inst::MNQ: return AssetClass::EQUITY_INDEX;
+        case Inst::ZN:  case Inst::UB:  return AssetClass::FIXED_INCOME;
+        case Inst::JY:                  return AssetClass::FX;
+        default:                        return AssetClass::COMMODITIES;
+    }
+}
+
+static double asset_weight(InstrumentId id) {
+    return ASSET_WEIGHTS[static_cast<int>(asset_class(id))];
 }
 
 // doc: "Position Limits" table (line 615-618)
 // Only equity index and commodity have per-instrument limits
-// Fixed income (ZN, UB) and FX (6J) have no per-instrument caps in document
-static const std::unordered_map<std::string, double> SINGLE_NOTIONAL_LIMIT = {
-    {"MES", 0.20}, {"MNQ", 0.20},
-    {"HG",  0.15}, {"GC",  0.15}, {"CL",  0.15}, {"SI",  0.15}
-    // ZN, UB, 6J intentionally omitted - no per-instrument limits in doc
+// Fixed income (ZN, UB) and FX (6J) have no per-instrument caps in document (NaN)
+static constexpr double NO_LIMIT = std::numeric_limits<double>::quiet_NaN();
+static constexpr double SINGLE_NOTIONAL_LIMIT[Inst::COUNT] = {
+    0.15, 0.15, 0.15, 0.15,      // HG, GC, CL, SI
+    NO_LIMIT, NO_LIMIT, NO_LIMIT, // ZN, UB, 6J - no per-instrument limits in doc
+    0.20, 0.20                   // MES, MNQ
 };
 static constexpr double MAX_TOTAL_EQUITY_NOTIONAL    = 0.35;
 static constexpr double MAX_TOTAL_COMMODITY_NOTIONAL = 0.40;
@@ -366,7 +1050,8 @@ struct DailySignal {
     bool corr_spike_active = false;
 
     double size_multiplier = 1.0;
-    std::unordered_map<std::string, double> target_contracts;
+    PerInstrument<double> target_contracts{};
+    PerInstrument<bool> dropped{};       // legs cleared without a trade (fixed mode, NEUTRAL)
     double portfolio_equity = 0.0;
     double margin_utilization = 0.0;
     bool drawdown_warning = false;
@@ -444,13 +1129,13 @@ public:
     double total_transaction_costs = 0.0;  // accumulated across entire backtest
 
     // Per-instrument P&L attribution (populated by run())
-    std::unordered_map<std::string, double> inst_pnl_total;       // cumulative gross P&L
-    std::unordered_map<std::string, double> inst_costs_total;     // cumulative costs
-    std::unordered_map<std::string, int>    inst_trades_total;    // round-trip count
-    std::unordered_map<std::string, int>    inst_wins_total;      // winning round-trips
-    std::unordered_map<std::string, int>    inst_losses_total;    // losing round-trips
-    std::unordered_map<std::string, double> inst_gross_win_total; // sum of winning trade P&L
-    std::unordered_map<std::string, double> inst_gross_loss_total;// sum of losing trade P&L
+    PerInstrument<double> inst_pnl_total{};       // cumulative gross P&L
+    PerInstrument<double> inst_costs_total{};     // cumulative costs
+    PerInstrument<int>    inst_trades_total{};    // round-trip count
+    PerInstrument<int>    inst_wins_total{};      // winning round-trips
+    PerInstrument<int>    inst_losses_total{};    // losing round-trips
+    PerInstrument<double> inst_gross_win_total{}; // sum of winning trade P&L
+    PerInstrument<double> inst_gross_loss_total{};// sum of losing trade P&L
 
     CopperGoldStrategy(const std::string& data_dir, const StrategyParams& p)
         : data_dir_(data_dir), p_(p) {}
@@ -463,35 +1148,72 @@ public:
             return data_dir_ + "/macro/" + name + ".csv";
         };
 
+        // Every file is parsed on the shared pool. Each job writes only its own
+        // destination and buffers its own warnings; both are merged back in the
+        // fixed order below, so members and log output match a sequential load.
+        struct LoadJob {
+            std::string path;
+            FuturesSeries* fut = nullptr;  // exactly one of fut / ts is set
+            TimeSeries* ts = nullptr;
+            std::ostringstream warn;
+        };
+        const std::vector<std::string> fut_syms = {"HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"};
+        // 2nd-month futures for term structure (Layer 4)
+        const std::vector<std::string> fut_2nd_syms = {"GC", "HG", "SI", "CL", "ZN", "ZB"};
+        const std::vector<std::pair<std::string, TimeSeries*>> macro_files = {
+            {"dxy", &dxy_ts_},
+            {"vix", &vix_ts_},
+            {"high_yield_spread", &hy_ts_},
+            {"breakeven_10y", &breakeven_ts_},
+            {"treasury_10y", &treasury_ts_},
+            {"spx", &spx_ts_},
+            {"fed_balance_sheet", &fed_bs_ts_},
+            {"china_leading_indicator", &china_cli_ts_},
+        };
+
+        std::vector<LoadJob> jobs(fut_syms.size() + fut_2nd_syms.size() + macro_files.size());
+        size_t k = 0;
+        for (const auto& sym : fut_syms) {
+            jobs[k].path = fut_path(sym);
+            jobs[k++].fut = &fut_[sym];
+        }
+        for (const auto& sym : fut_2nd_syms) {
+            jobs[k].path = fut_path(sym + "_2nd");
+            jobs[k++].fut = &fut_2nd_[sym];
+        }
+        for (const auto& [name, dst] : macro_files) {
+            jobs[k].path = mac_path(name);
+            jobs[k++].ts = dst;
+        }
+
         std::cout << "[INFO] Loading futures data...\n";
-        for (const auto& sym : {"HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"}) {
-            fut_[sym] = load_futures(fut_path(sym));
+        shared_pool().parallel_for(jobs.size(), [&](size_t j) {
+            LoadJob& job = jobs[j];
+            if (job.fut) *job.fut = load_futures(job.path, job.warn);
+            else         *job.ts = load_macro(job.path, job.warn);
+        });
+
+        k = 0;
+        for (const auto& sym : fut_syms) {
+            std::cerr << jobs[k++].warn.str();
             if (fut_[sym].empty())
                 std::cerr << "[WARN] No data for " << sym << "\n";
             else
                 std::cout << "[INFO] Loaded " << fut_[sym].size() << " bars for " << sym << "\n";
         }
 
-        // Load 2nd-month futures for term structure (Layer 4)
         std::cout << "[INFO] Loading 2nd-month futures for term structure...\n";
-        for (const auto& sym : {"GC", "HG", "SI", "CL", "ZN", "ZB"}) {
-            std::string sym2 = std::string(sym) + "_2nd";
-            fut_2nd_[sym] = load_futures(data_dir_ + "/futures/" + sym2 + ".csv");
+        for (const auto& sym : fut_2nd_syms) {
+            std::cerr << jobs[k++].warn.str();
             if (fut_2nd_[sym].empty())
                 std::cerr << "[WARN] No 2nd-month data for " << sym << "\n";
             else
-                std::cout << "[INFO] Loaded " << fut_2nd_[sym].size() << " bars for " << sym2 << "\n";
+                std::cout << "[INFO] Loaded " << fut_2nd_[sym].size() << " bars for " << sym << "_2nd\n";
         }
 
         std::cout << "[INFO] Loading macro data...\n";
-        dxy_ts_ = load_macro(mac_path("dxy"));
-        vix_ts_ = load_macro(mac_path("vix"));
-        hy_ts_ = load_macro(mac_path("high_yield_spread"));
-        breakeven_ts_ = load_macro(mac_path("breakeven_10y"));
-        treasury_ts_ = load_macro(mac_path("treasury_10y"));
-        spx_ts_ = load_macro(mac_path("spx"));
-        fed_bs_ts_ = load_macro(mac_path("fed_balance_sheet"));
-        china_cli_ts_ = load_macro(mac_path("china_leading_indicator"));
+        for (; k < jobs.size(); ++k)
+            std::cerr << jobs[k].warn.str();
 
         std::cout << "[INFO] DXY records: " << dxy_ts_.size() << "\n";
         std::cout << "[INFO] VIX records: " << vix_ts_.size() << "\n";
@@ -527,6 +1249,8 @@ public:
 
         int n = dates.size();
         std::cout << "[INFO] Total trading days: " << n << "\n";
+        const std::vector<std::string> date_strs = format_dates(dates);
+        const TradingCalendar calendar(dates);
 
         // Extract price series
         auto extract_close = [&](const std::string& sym) {
@@ -600,12 +1324,12 @@ public:
                 double pct_change = std::abs(curr - prev) / prev;
                 if (pct_change > 0.5) {  // 50% move in one day
                     std::cout << "[ERROR] Unrealistic " << sym << " price move: "
-                              << date_from_int(dates[i-1]) << " " << prev
-                              << " -> " << date_from_int(dates[i]) << " " << curr
+                              << date_strs[i-1] << " " << prev
+                              << " -> " << date_strs[i] << " " << curr
                               << " (" << (pct_change*100) << "%)\n";
 
                     // Forward-fill previous day's price for the affected instrument
-                    std::cout << "[DATA-REJECT] " << date_from_int(dates[i])
+                    std::cout << "[DATA-REJECT] " << date_strs[i]
                               << " " << sym << " price " << prev << "->" << curr
                               << " (" << std::fixed << std::setprecision(1)
                               << (pct_change*100) << "% move)"
@@ -688,13 +1412,16 @@ public:
 
         // Z-scores for liquidity
         auto vix_z60 = rolling_zscore(vix, p_.liq_zscore_window);
+        auto vix_pct60 = rolling_percentile_rank(vix, 60);
+        auto vix_q90 = rolling_quantile(vix, 60, 0.90);
         auto hy_z60 = rolling_zscore(hy, p_.liq_zscore_window);
 
         // Fed balance sheet YoY growth
         std::vector<double> fed_bs_yoy(n, std::numeric_limits<double>::quiet_NaN());
-        for (int i = 252; i < n; ++i) {
-            if (!std::isnan(fed_bs[i]) && !std::isnan(fed_bs[i - 252]) && fed_bs[i - 252] > 0.0)
-                fed_bs_yoy[i] = (fed_bs[i] / fed_bs[i - 252]) - 1.0;
+        constexpr int yoy = TradingCalendar::TRADING_YEAR;
+        for (int i = yoy; i < n; ++i) {
+            if (!std::isnan(fed_bs[i]) && !std::isnan(fed_bs[i - yoy]) && fed_bs[i - yoy] > 0.0)
+                fed_bs_yoy[i] = (fed_bs[i] / fed_bs[i - yoy]) - 1.0;
         }
 
         // Z-score the fed balance sheet YoY growth for normalization
@@ -726,6 +1453,7 @@ public:
             make_ret(zn), make_ret(ub), make_ret(jy),
             make_ret(mes), make_ret(mnq)
         };
+        const std::vector<double> avg_corr = rolling_avg_pairwise_corr(all_rets, p_.corr_window);
 
         // ================================================================
         // MAIN LOOP
@@ -742,52 +1470,35 @@ public:
         int pending_count = 0;
 
         // Track positions and entry prices
-        std::unordered_map<std::string, double> positions;
-        std::unordered_map<std::string, double> entry_prices;
-        for (const char* s : {"HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"}) {
-            positions[s] = 0.0;
-            entry_prices[s] = std::numeric_limits<double>::quiet_NaN();
-        }
+        PerInstrument<double> positions{};
+        PerInstrument<double> entry_prices;
+        entry_prices.fill(std::numeric_limits<double>::quiet_NaN());
 
         // Per-instrument P&L attribution accumulators
-        std::unordered_map<std::string, double> instrument_pnl;       // cumulative P&L
-        std::unordered_map<std::string, double> instrument_costs;     // cumulative transaction costs
-        std::unordered_map<std::string, int>    instrument_trades;    // completed round-trip count
-        std::unordered_map<std::string, int>    instrument_wins;      // profitable round-trips
-        std::unordered_map<std::string, int>    instrument_losses;    // losing round-trips
-        std::unordered_map<std::string, double> instrument_gross_win; // sum of winning trade P&L
-        std::unordered_map<std::string, double> instrument_gross_loss;// sum of losing trade P&L (stored positive)
-        std::unordered_map<std::string, double> instrument_open_pnl;  // P&L accumulated since position entry
-        for (const char* s : {"HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"}) {
-            instrument_pnl[s] = 0.0;
-            instrument_costs[s] = 0.0;
-            instrument_trades[s] = 0;
-            instrument_wins[s] = 0;
-            instrument_losses[s] = 0;
-            instrument_gross_win[s] = 0.0;
-            instrument_gross_loss[s] = 0.0;
-            instrument_open_pnl[s] = 0.0;
-        }
-
-        // Point values
-        const std::unordered_map<std::string, double> POINT_VALUE = {
-            {"HG", 250.0},    // 1 cent = $250
-            {"GC", 100.0},    // $1 = $100
-            {"CL", 1000.0},   // $1 = $1000
-            {"SI", 5000.0},   // $1 = $5000
-            {"ZN", 1000.0},   // 1 point = $1000
-            {"UB", 1000.0},   // 1 point = $1000
-            {"6J", 12.50},    // 1 pip = $12.50
-            {"MES", 5.0},     // 1 point = $5
-            {"MNQ", 2.0}      // 1 point = $2
-        };
+        PerInstrument<double> instrument_pnl{};       // cumulative P&L
+        PerInstrument<double> instrument_costs{};     // cumulative transaction costs
+        PerInstrument<int>    instrument_trades{};    // completed round-trip count
+        PerInstrument<int>    instrument_wins{};      // profitable round-trips
+        PerInstrument<int>    instrument_losses{};    // losing round-trips
+        PerInstrument<double> instrument_gross_win{}; // sum of winning trade P&L
+        PerInstrument<double> instrument_gross_loss{};// sum of losing trade P&L (stored positive)
+        PerInstrument<double> instrument_open_pnl{};  // P&L accumulated since position entry
 
         // Price vectors for easy access
-        std::unordered_map<std::string, const std::vector<double>*> px_map = {
-            {"HG", &hg}, {"GC", &gc}, {"CL", &cl}, {"SI", &si},
-            {"ZN", &zn}, {"UB", &ub}, {"6J", &jy}, {"MES", &mes}, {"MNQ", &mnq}
+        const PerInstrument<const std::vector<double>*> px_map = {
+            &hg, &gc, &cl, &si, &zn, &ub, &jy, &mes, &mnq
         };
 
+        // ATR(20) for the position-level stop: mean of the true ranges the
+        // instrument actually printed over the last 20 calendar days
+        PerInstrument<std::vector<double>> stop_atr;
+        for (InstrumentId id : Inst::ALL) {
+            auto it = fut_.find(Inst::symbol(id));
+            stop_atr[id] = (it != fut_.end())
+                ? rolling_nanmean(true_range(dates, it->second), 20)
+                : std::vector<double>(n, std::numeric_limits<double>::quiet_NaN());
+        }
+
         // State variables that persist across iterations (weekly rebalance, regime tracking)
         Regime     prev_regime_state     = Regime::NEUTRAL;
         DXYFilter  prev_dxy_filter_state = DXYFilter::NEUTRAL;
@@ -819,7 +1530,7 @@ public:
             // ============================================================
             if (skip_bars.count(i)) {
                 DailySignal sig;
-                sig.date = date_from_int(dates[i]);
+                sig.date = date_strs[i];
                 sig.cu_gold_ratio = ratio[i];
                 sig.macro_tilt = prev_tilt;
                 sig.regime = prev_regime_state;
@@ -892,8 +1603,8 @@ public:
             // Signal Stability Check (doc line 125, 357, 587, 607)
             // "signal should not flip more than 8-12x per year"
             // ============================================================
-            // Track flips in trailing 252-day window (1 trading year)
-            // We record flip dates in a deque and count those within 252 days
+            // Track flips in the trailing trading year (TRADING_YEAR rows)
+            // We record flip rows in a deque and count those still in the window
             auto& flip_dates = flip_dates_deque;
             // Capture tilt_just_changed BEFORE any mutation, so it can be reused
             // for rebalance detection later in the same iteration (outline lines 361, 587)
@@ -901,7 +1612,8 @@ public:
             if (tilt_just_changed) {
                 flip_dates.push_back(i);
             }
-            while (!flip_dates.empty() && (i - flip_dates.front()) > 252)
+            while (!flip_dates.empty() &&
+                   static_cast<size_t>(flip_dates.front()) < TradingCalendar::trailing_year_begin(i))
                 flip_dates.pop_front();
             int flips_trailing_year = static_cast<int>(flip_dates.size());
 
@@ -920,19 +1632,7 @@ public:
 
             // Calculate VIX percentile (60-day)
             double vix_percentile = 0.0;
-            if (i >= 60) {
-                std::vector<double> vix_window;
-                for (int k = i - 59; k <= i; ++k) {
-                    if (!std::isnan(vix[k])) vix_window.push_back(vix[k]);
-                }
-                if (!vix_window.empty()) {
-                    std::sort(vix_window.begin(), vix_window.end());
-                    double current_vix = vix[i];
-                    auto it = std::lower_bound(vix_window.begin(), vix_window.end(), current_vix);
-                    int rank = std::distance(vix_window.begin(), it);
-                    vix_percentile = static_cast<double>(rank) / vix_window.size();
-                }
-            }
+            if (i >= 60 && !std::isnan(vix_pct60[i])) vix_percentile = vix_pct60[i];
 
             // High yield spread z-score (already computed as hy_z60)
             double hy_zscore = std::isnan(hy_z60[i]) ? 0.0 : hy_z60[i];
@@ -1011,18 +1711,7 @@ public:
             // Safe-haven override
             bool skip_gold_short = false;
             if (i > 0 && !std::isnan(vix[i]) && !std::isnan(gc[i]) && !std::isnan(gc[i-1]) && !std::isnan(spx[i]) && !std::isnan(spx[i-1])) {
-                double vix90 = std::numeric_limits<double>::quiet_NaN();
-                if (i >= 59) {
-                    std::vector<double> vix_window;
-                    for (int k = i - 59; k <= i; ++k)
-                        if (!std::isnan(vix[k])) vix_window.push_back(vix[k]);
-                    if (!vix_window.empty()) {
-                        std::sort(vix_window.begin(), vix_window.end());
-                        int idx = (int)(0.90 * vix_window.size());
-                        if (idx >= (int)vix_window.size()) idx = (int)vix_window.size() - 1;
-                        vix90 = vix_window[idx];
-                    }
-                }
+                double vix90 = vix_q90[i];
                 double gold_ret = (gc[i] / gc[i-1]) - 1.0;
                 double eq_ret = (spx[i] / spx[i-1]) - 1.0;
                 if (!std::isnan(vix90) && vix[i] > vix90 && gold_ret > 0.015 && eq_ret < -0.015)
@@ -1045,7 +1734,7 @@ public:
 
             // Correlation spike
             bool corr_spike = false;
-            if (avg_pairwise_corr(all_rets, i, p_.corr_window) > p_.corr_thresh)
+            if (avg_corr[i] > p_.corr_thresh)
                 corr_spike = true;
 
             // ============================================================
@@ -1105,14 +1794,14 @@ public:
             // with 2nd-month data: GC, HG, SI, CL, ZN, ZB
             // roll_yield = (front/back - 1) * (365/days_between)
             // positive = backwardation, negative = contango
-            std::unordered_map<std::string, CurveState> curve_state;
-            std::unordered_map<std::string, double> ts_mult;  // per-commodity term structure multiplier
+            PerInstrument<CurveState> curve_state;
+            PerInstrument<double> ts_mult;  // per-commodity term structure multiplier
+            curve_state.fill(CurveState::FLAT);
+            ts_mult.fill(1.0);
 
-            auto calc_curve = [&](const std::string& sym,
+            auto calc_curve = [&](InstrumentId sym,
                                   const std::vector<double>& front,
                                   const std::vector<double>& back) {
-                curve_state[sym] = CurveState::FLAT;
-                ts_mult[sym] = 1.0;
 
                 if (std::isnan(front[i]) || std::isnan(back[i]) || back[i] <= 0.0)
                     return;
@@ -1127,11 +1816,11 @@ public:
                     curve_state[sym] = CurveState::FLAT;
             };
 
-            calc_curve("GC", gc, gc_2nd);
-            calc_curve("HG", hg, hg_2nd);
-            calc_curve("SI", si, si_2nd);
-            calc_curve("CL", cl, cl_2nd);
-            calc_curve("ZN", zn, zn_2nd);
+            calc_curve(Inst::GC, gc, gc_2nd);
+            calc_curve(Inst::HG, hg, hg_2nd);
+            calc_curve(Inst::SI, si, si_2nd);
+            calc_curve(Inst::CL, cl, cl_2nd);
+            calc_curve(Inst::ZN, zn, zn_2nd);
 
             // ZB: no front-month ZB in our data; use ZN front vs ZB_2nd for
             // yield curve spread analysis (steepening/flattening proxy)
@@ -1150,131 +1839,116 @@ public:
             // ── Apply trade expression matrix from design doc ──
             // Crude Oil (CL) — doc lines 269-278
             if (macro_tilt == MacroTilt::RISK_ON) {
-                if (curve_state["CL"] == CurveState::BACKWARDATION)
-                    ts_mult["CL"] = 1.0;   // trend + carry aligned
-                else if (curve_state["CL"] == CurveState::CONTANGO)
-                    ts_mult["CL"] = 0.25;   // "Skip or minimal outright long"
+                if (curve_state[Inst::CL] == CurveState::BACKWARDATION)
+                    ts_mult[Inst::CL] = 1.0;   // trend + carry aligned
+                else if (curve_state[Inst::CL] == CurveState::CONTANGO)
+                    ts_mult[Inst::CL] = 0.25;   // "Skip or minimal outright long"
                 else
-                    ts_mult["CL"] = 0.5;    // flat: "Small outright long"
+                    ts_mult[Inst::CL] = 0.5;    // flat: "Small outright long"
             } else if (macro_tilt == MacroTilt::RISK_OFF) {
-                if (curve_state["CL"] == CurveState::CONTANGO)
-                    ts_mult["CL"] = 1.0;   // short outright
-                else if (curve_state["CL"] == CurveState::BACKWARDATION)
-                    ts_mult["CL"] = 0.0;   // "Skip — tight markets squeeze shorts"
+                if (curve_state[Inst::CL] == CurveState::CONTANGO)
+                    ts_mult[Inst::CL] = 1.0;   // short outright
+                else if (curve_state[Inst::CL] == CurveState::BACKWARDATION)
+                    ts_mult[Inst::CL] = 0.0;   // "Skip — tight markets squeeze shorts"
                 else
-                    ts_mult["CL"] = 0.5;    // flat: "Small outright short"
+                    ts_mult[Inst::CL] = 0.5;    // flat: "Small outright short"
             }
 
             // Copper (HG) — doc lines 280-288
             if (macro_tilt == MacroTilt::RISK_ON) {
-                if (curve_state["HG"] == CurveState::BACKWARDATION)
-                    ts_mult["HG"] = 1.0;   // "Outright long (trend + carry aligned)"
-                else if (curve_state["HG"] == CurveState::CONTANGO)
-                    ts_mult["HG"] = 0.5;   // "Outright long, reduced size"
+                if (curve_state[Inst::HG] == CurveState::BACKWARDATION)
+                    ts_mult[Inst::HG] = 1.0;   // "Outright long (trend + carry aligned)"
+                else if (curve_state[Inst::HG] == CurveState::CONTANGO)
+                    ts_mult[Inst::HG] = 0.5;   // "Outright long, reduced size"
                 else
-                    ts_mult["HG"] = 0.75;   // flat: interpolate
+                    ts_mult[Inst::HG] = 0.75;   // flat: interpolate
             } else if (macro_tilt == MacroTilt::RISK_OFF) {
-                if (curve_state["HG"] == CurveState::CONTANGO)
-                    ts_mult["HG"] = 1.0;   // "Outright short"
-                else if (curve_state["HG"] == CurveState::BACKWARDATION)
-                    ts_mult["HG"] = 0.0;   // "Skip — don't short tight copper"
+                if (curve_state[Inst::HG] == CurveState::CONTANGO)
+                    ts_mult[Inst::HG] = 1.0;   // "Outright short"
+                else if (curve_state[Inst::HG] == CurveState::BACKWARDATION)
+                    ts_mult[Inst::HG] = 0.0;   // "Skip — don't short tight copper"
                 else
-                    ts_mult["HG"] = 0.5;    // flat: interpolate
+                    ts_mult[Inst::HG] = 0.5;    // flat: interpolate
             }
 
             // Gold (GC) — doc lines 289-295
             // "Any" term structure — gold typically in contango, less relevant
-            ts_mult["GC"] = 1.0;
+            ts_mult[Inst::GC] = 1.0;
 
             // Silver (SI) — follow copper pattern (industrial + precious hybrid)
             if (macro_tilt == MacroTilt::RISK_ON) {
-                if (curve_state["SI"] == CurveState::BACKWARDATION)
-                    ts_mult["SI"] = 1.0;
-                else if (curve_state["SI"] == CurveState::CONTANGO)
-                    ts_mult["SI"] = 0.5;
+                if (curve_state[Inst::SI] == CurveState::BACKWARDATION)
+                    ts_mult[Inst::SI] = 1.0;
+                else if (curve_state[Inst::SI] == CurveState::CONTANGO)
+                    ts_mult[Inst::SI] = 0.5;
                 else
-                    ts_mult["SI"] = 0.75;
+                    ts_mult[Inst::SI] = 0.75;
             } else if (macro_tilt == MacroTilt::RISK_OFF) {
                 // SI is long in risk-off (precious metal bid) — contango less harmful
-                ts_mult["SI"] = 1.0;
+                ts_mult[Inst::SI] = 1.0;
             }
 
             // Treasuries (ZN, UB) — doc lines 296-304
             // Use yield curve state for sizing
             if (macro_tilt == MacroTilt::RISK_ON) {
                 if (yield_curve_state == CurveState::BACKWARDATION)   // steepening
-                    ts_mult["ZN"] = 1.0;   // "Short ZN (belly), or steepener spread"
+                    ts_mult[Inst::ZN] = 1.0;   // "Short ZN (belly), or steepener spread"
                 else if (yield_curve_state == CurveState::CONTANGO)   // flattening
-                    ts_mult["ZN"] = 0.5;   // "Short ZN outright, reduced size"
+                    ts_mult[Inst::ZN] = 0.5;   // "Short ZN outright, reduced size"
                 else
-                    ts_mult["ZN"] = 0.75;
+                    ts_mult[Inst::ZN] = 0.75;
             } else if (macro_tilt == MacroTilt::RISK_OFF) {
                 if (yield_curve_state == CurveState::BACKWARDATION)   // steepening
-                    ts_mult["ZN"] = 1.0;   // "Long UB (long end), or steepener"
+                    ts_mult[Inst::ZN] = 1.0;   // "Long UB (long end), or steepener"
                 else if (yield_curve_state == CurveState::CONTANGO)   // flattening
-                    ts_mult["ZN"] = 1.0;   // "Long ZN outright"
+                    ts_mult[Inst::ZN] = 1.0;   // "Long ZN outright"
                 else
-                    ts_mult["ZN"] = 0.75;
+                    ts_mult[Inst::ZN] = 0.75;
             }
             // UB follows same yield curve logic as ZN
-            ts_mult["UB"] = ts_mult.count("ZN") ? ts_mult["ZN"] : 1.0;
+            ts_mult[Inst::UB] = ts_mult[Inst::ZN];
 
-            std::unordered_set<std::string> stopped_out_today;
+            PerInstrument<bool> stopped_out_today{};
 
             // ============================================================
             // P&L Calculation
             // ============================================================
             if (i > 0) {
                 double daily_pnl = 0.0;
-                for (const auto& [sym, qty] : positions) {
+                for (InstrumentId id : Inst::ALL) {
+                    double qty = positions[id];
                     if (qty == 0.0) continue;
-                    const auto* px = px_map[sym];
-                    if (!px || std::isnan((*px)[i]) || std::isnan((*px)[i-1])) continue;
-                    double pv = POINT_VALUE.count(sym) ? POINT_VALUE.at(sym) : 0.0;
+                    const auto* px = px_map[id];
+                    if (std::isnan((*px)[i]) || std::isnan((*px)[i-1])) continue;
+                    double pv = Inst::POINT_VALUE[id];
                     double price_change = (*px)[i] - (*px)[i-1];
                     double inst_daily = qty * price_change * pv;
                     daily_pnl += inst_daily;
-                    instrument_pnl[sym] += inst_daily;
-                    instrument_open_pnl[sym] += inst_daily;
+                    instrument_pnl[id] += inst_daily;
+                    instrument_open_pnl[id] += inst_daily;
                 }
 
                 // Position-level stop: exit if position loss > 2 * ATR(20)
                 // ATR is available for GC and SI; for others use a 20-day price std proxy
-                for (auto& [sym, qty] : positions) {
+                for (InstrumentId id : Inst::ALL) {
+                    double& qty = positions[id];
                     if (qty == 0.0) continue;
-                    const auto* px = px_map[sym];
-                    if (!px || std::isnan((*px)[i])) continue;
-                    double pv = POINT_VALUE.count(sym) ? POINT_VALUE.at(sym) : 0.0;
-
-                    // Compute 20-day ATR for this symbol from price series
-                    double atr20 = std::numeric_limits<double>::quiet_NaN();
-                    if (i >= 20) {
-                        double tr_sum = 0.0;
-                        int tr_count = 0;
-                        for (int k = i - 19; k <= i; ++k) {
-                            auto it = fut_[sym].find(dates[k]);
-                            if (it == fut_[sym].end()) continue;
-                            auto it_prev = fut_[sym].lower_bound(dates[k]);
-                            if (it_prev == fut_[sym].begin()) continue;
-                            --it_prev;
-                            double pc = it_prev->second.close;
-                            double hi = it->second.high;
-                            double lo = it->second.low;
-                            tr_sum += std::max({hi - lo, std::abs(hi - pc), std::abs(lo - pc)});
-                            tr_count++;
-                        }
-                        if (tr_count > 0) atr20 = tr_sum / tr_count;
-                    }
+                    const auto* px = px_map[id];
+                    if (std::isnan((*px)[i])) continue;
+                    double pv = Inst::POINT_VALUE[id];
+
+                    double atr20 = (i >= 20) ? stop_atr[id][i]
+                                             : std::numeric_limits<double>::quiet_NaN();
 
                     if (!std::isnan(atr20) && atr20 > 0.0) {
-                        double entry_px = entry_prices.count(sym) ? entry_prices.at(sym) : std::numeric_limits<double>::quiet_NaN();
+                        double entry_px = entry_prices[id];
                         if (!std::isnan(entry_px)) {
                             double dollar_atr = atr20 * std::abs(qty) * pv;
                             double position_dollar_loss = -(qty * ((*px)[i] - entry_px) * pv);
                             if (position_dollar_loss > 2.0 * dollar_atr) {
                                 qty = 0.0;
-                                entry_prices[sym] = std::numeric_limits<double>::quiet_NaN();
-                                stopped_out_today.insert(sym);
+                                entry_prices[id] = std::numeric_limits<double>::quiet_NaN();
+                                stopped_out_today[id] = true;
                             }
                         }
                     }
@@ -1310,7 +1984,7 @@ public:
                         dd_stop = false;
                         peak_equity = equity;
                         dd_stable_bars = 0;
-                        std::cout << "[DRAWDOWN-RESUME] " << date_from_int(dates[i])
+                        std::cout << "[DRAWDOWN-RESUME] " << date_strs[i]
                                   << " Cooldown complete. Equity: $" << std::fixed
                                   << std::setprecision(2) << equity << "\n";
                         // Recalculate size_mult from scratch (it was zeroed above)
@@ -1363,29 +2037,30 @@ public:
                 dd_stable_equity = equity;
 
                 // IMMEDIATELY flatten all positions -- zero out actual holdings
-                for (auto& [sym, qty] : positions) {
+                for (InstrumentId id : Inst::ALL) {
+                    double& qty = positions[id];
                     if (qty != 0.0) {
                         // Deduct transaction costs for liquidation
-                        double cost = ContractSpec::total_cost_rt(sym) * std::abs(qty);
+                        double cost = ContractSpec::total_cost_rt(id) * std::abs(qty);
                         equity -= cost;
                         total_costs_deducted += cost;
-                        instrument_costs[sym] += cost;
+                        instrument_costs[id] += cost;
                         // Record completed round-trip
-                        instrument_trades[sym]++;
-                        if (instrument_open_pnl[sym] > 0.0) {
-                            instrument_wins[sym]++;
-                            instrument_gross_win[sym] += instrument_open_pnl[sym];
-                        } else if (instrument_open_pnl[sym] < 0.0) {
-                            instrument_losses[sym]++;
-                            instrument_gross_loss[sym] += std::abs(instrument_open_pnl[sym]);
+                        instrument_trades[id]++;
+                        if (instrument_open_pnl[id] > 0.0) {
+                            instrument_wins[id]++;
+                            instrument_gross_win[id] += instrument_open_pnl[id];
+                        } else if (instrument_open_pnl[id] < 0.0) {
+                            instrument_losses[id]++;
+                            instrument_gross_loss[id] += std::abs(instrument_open_pnl[id]);
                         }
-                        instrument_open_pnl[sym] = 0.0;
+                        instrument_open_pnl[id] = 0.0;
                         qty = 0.0;
-                        entry_prices[sym] = std::numeric_limits<double>::quiet_NaN();
+                        entry_prices[id] = std::numeric_limits<double>::quiet_NaN();
                     }
                 }
 
-                std::cout << "[DRAWDOWN-STOP] " << date_from_int(dates[i])
+                std::cout << "[DRAWDOWN-STOP] " << date_strs[i]
                           << " Liquidating all positions."
                           << " Equity: $" << std::fixed << std::setprecision(2) << equity
                           << ", Drawdown: " << std::setprecision(2) << drawdown * 100.0 << "%"
@@ -1409,13 +2084,13 @@ public:
             // ============================================================
             if (equity <= 0.0) {
                 size_mult = 0.0;
-                std::cout << "[EQUITY-ZERO] " << date_from_int(dates[i])
+                std::cout << "[EQUITY-ZERO] " << date_strs[i]
                           << " Equity depleted ($" << std::fixed << std::setprecision(2)
                           << equity << "). All positions zeroed.\n";
             } else if (equity < p_.initial_capital * 0.10) {
                 double ruin_guard = 0.50;
                 size_mult *= ruin_guard;
-                std::cout << "[EQUITY-LOW] " << date_from_int(dates[i])
+                std::cout << "[EQUITY-LOW] " << date_strs[i]
                           << " Equity $" << std::fixed << std::setprecision(2) << equity
                           << " < 10% of initial ($" << std::setprecision(2)
                           << p_.initial_capital * 0.10 << "). Size reduced 50%.\n";
@@ -1432,12 +2107,7 @@ public:
             //   5. Stop-loss triggered (drawdown or ATR stop)
             // ============================================================
             // Determine if today is a rebalance day
-            bool is_friday = false;
-            {
-                time_t ts = static_cast<time_t>(dates[i]) * 86400;
-                std::tm* t = std::gmtime(&ts);
-                is_friday = (t->tm_wday == 5); // 0=Sun,1=Mon,...,5=Fri
-            }
+            bool is_friday = calendar.is_friday(i);
             // Track previous regime for change detection
             Regime&    prev_regime     = prev_regime_state;
             DXYFilter& prev_dxy_filter = prev_dxy_filter_state;
@@ -1469,19 +2139,24 @@ public:
             prev_regime     = regime;
             prev_dxy_filter = dxy_filter;
 
-            std::unordered_map<std::string, double> new_positions;
+            PerInstrument<double> new_positions{};
+            // Legs that were given a target this rebalance. Fixed test mode
+            // sets none on a NEUTRAL tilt; those legs are dropped without
+            // costs or round-trip stats, as with the string-keyed map.
+            PerInstrument<bool> targeted;
+            targeted.fill(true);
             // If not a rebalance day, carry existing positions forward
             if (!do_rebalance) {
                 new_positions = positions;
                 // Still apply stop-loss checks below (ATR stop runs regardless)
                 // Recalculate margin_util with current positions
                 double margin_util = 0.0;
-                for (const auto& [sym, qty] : positions)
-                    margin_util += std::abs(qty) * ContractSpec::get(sym).margin;
+                for (InstrumentId id : Inst::ALL)
+                    margin_util += std::abs(positions[id]) * ContractSpec::get(id).margin;
                 margin_util = (equity > 0.0) ? margin_util / equity : 0.0;
                 // Save signal and continue
                 DailySignal sig;
-                sig.date = date_from_int(dates[i]);
+                sig.date = date_strs[i];
                 sig.cu_gold_ratio = ratio[i];
                 sig.roc_10 = std::isnan(roc10) ? 0.0 : roc10;
                 sig.roc_20 = std::isnan(roc20) ? 0.0 : roc20;
@@ -1523,16 +2198,15 @@ public:
                 // FULL POSITION SIZING MODE
 
                 // Helper lambda for calculating contract sizes
-                auto contracts_for = [&](const std::string& sym,
+                auto contracts_for = [&](InstrumentId id,
                                          double direction,
                                          double vol_adj = 1.0) -> double {
                     if (std::abs(direction) < 1e-9 || std::abs(size_mult) < 1e-9)
                         return 0.0;
 
-                    const auto cls = asset_class(sym);
-                    double w = ASSET_WEIGHTS.count(cls) ? ASSET_WEIGHTS.at(cls) : 0.1;
+                    double w = asset_weight(id);
                     double notional_alloc = std::max(0.0, equity * p_.leverage_target * w);
-                    const auto spec = ContractSpec::get(sym);
+                    const auto& spec = ContractSpec::get(id);
                     double raw = (notional_alloc / spec.notional) * size_mult * vol_adj;
                     return std::floor(raw * direction + 0.5);
                 };
@@ -1552,58 +2226,56 @@ public:
                 // HG price data still used for Cu/Au ratio signal.
                 if (macro_tilt == MacroTilt::RISK_ON) {
                     if (regime == Regime::INFLATION_SHOCK) {
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = 0.0;
-                        new_positions["HG"]  = 0.0;
-                        new_positions["CL"]  = contracts_for("CL", 1.0);
-                        new_positions["SI"]  = std::isnan(si_adj) ? 0.0 : contracts_for("SI", 1.0, si_adj);
-                        new_positions["GC"]  = skip_gold_short ? 0.0 : contracts_for("GC", -1.0);
-                        new_positions["ZN"]  = contracts_for("ZN", -1.0);
-                        new_positions["UB"]  = contracts_for("UB", -1.0);
-                        new_positions["6J"]  = 0.0;
+                        new_positions[Inst::MES] = 0.0;
+                        new_positions[Inst::MNQ] = 0.0;
+                        new_positions[Inst::HG]  = 0.0;
+                        new_positions[Inst::CL]  = contracts_for(Inst::CL, 1.0);
+                        new_positions[Inst::SI]  = std::isnan(si_adj) ? 0.0 : contracts_for(Inst::SI, 1.0, si_adj);
+                        new_positions[Inst::GC]  = skip_gold_short ? 0.0 : contracts_for(Inst::GC, -1.0);
+                        new_positions[Inst::ZN]  = contracts_for(Inst::ZN, -1.0);
+                        new_positions[Inst::UB]  = contracts_for(Inst::UB, -1.0);
+                        new_positions[Inst::JY]  = 0.0;
                     } else {
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = contracts_for("MNQ", 1.0);
-                        new_positions["HG"]  = 0.0;
-                        new_positions["CL"]  = contracts_for("CL",  1.0);
-                        new_positions["GC"]  = skip_gold_short ? 0.0 : contracts_for("GC", -1.0);
-                        new_positions["SI"]  = std::isnan(si_adj) ? 0.0 : contracts_for("SI",  1.0, si_adj);
-                        new_positions["ZN"]  = contracts_for("ZN", -1.0);
-                        new_positions["UB"]  = contracts_for("UB", -1.0);
-                        new_positions["6J"]  = 0.0;
+                        new_positions[Inst::MES] = 0.0;
+                        new_positions[Inst::MNQ] = contracts_for(Inst::MNQ, 1.0);
+                        new_positions[Inst::HG]  = 0.0;
+                        new_positions[Inst::CL]  = contracts_for(Inst::CL,  1.0);
+                        new_positions[Inst::GC]  = skip_gold_short ? 0.0 : contracts_for(Inst::GC, -1.0);
+                        new_positions[Inst::SI]  = std::isnan(si_adj) ? 0.0 : contracts_for(Inst::SI,  1.0, si_adj);
+                        new_positions[Inst::ZN]  = contracts_for(Inst::ZN, -1.0);
+                        new_positions[Inst::UB]  = contracts_for(Inst::UB, -1.0);
+                        new_positions[Inst::JY]  = 0.0;
                     }
                 } else if (macro_tilt == MacroTilt::RISK_OFF) {
                     if (regime == Regime::INFLATION_SHOCK) {
-                        new_positions["GC"]  = contracts_for("GC",  1.0);
-                        new_positions["ZN"]  = contracts_for("ZN", -1.0);
-                        new_positions["UB"]  = contracts_for("UB", -1.0);
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = 0.0;
-                        new_positions["HG"]  = 0.0;
-                        new_positions["CL"]  = 0.0;
-                        new_positions["SI"]  = std::isnan(si_adj) ? 0.0 : contracts_for("SI",  1.0, si_adj);
-                        new_positions["6J"]  = 0.0;
+                        new_positions[Inst::GC]  = contracts_for(Inst::GC,  1.0);
+                        new_positions[Inst::ZN]  = contracts_for(Inst::ZN, -1.0);
+                        new_positions[Inst::UB]  = contracts_for(Inst::UB, -1.0);
+                        new_positions[Inst::MES] = 0.0;
+                        new_positions[Inst::MNQ] = 0.0;
+                        new_positions[Inst::HG]  = 0.0;
+                        new_positions[Inst::CL]  = 0.0;
+                        new_positions[Inst::SI]  = std::isnan(si_adj) ? 0.0 : contracts_for(Inst::SI,  1.0, si_adj);
+                        new_positions[Inst::JY]  = 0.0;
                     } else {
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = 0.0;
-                        new_positions["HG"]  = 0.0;
-                        new_positions["CL"]  = contracts_for("CL",  -1.0);
-                        new_positions["GC"]  = contracts_for("GC",   1.0);
-                        new_positions["SI"]  = std::isnan(si_adj) ? 0.0 : contracts_for("SI",   1.0, si_adj);
-                        new_positions["ZN"]  = contracts_for("ZN",   1.0);
-                        new_positions["UB"]  = contracts_for("UB",   1.0);
-                        new_positions["6J"]  = 0.0;
+                        new_positions[Inst::MES] = 0.0;
+                        new_positions[Inst::MNQ] = 0.0;
+                        new_positions[Inst::HG]  = 0.0;
+                        new_positions[Inst::CL]  = contracts_for(Inst::CL,  -1.0);
+                        new_positions[Inst::GC]  = contracts_for(Inst::GC,   1.0);
+                        new_positions[Inst::SI]  = std::isnan(si_adj) ? 0.0 : contracts_for(Inst::SI,   1.0, si_adj);
+                        new_positions[Inst::ZN]  = contracts_for(Inst::ZN,   1.0);
+                        new_positions[Inst::UB]  = contracts_for(Inst::UB,   1.0);
+                        new_positions[Inst::JY]  = 0.0;
                     }
-                } else {
-                    for (const char* s : {"HG","GC","CL","SI","MES","MNQ","ZN","UB","6J"})
-                        new_positions[s] = 0.0;
                 }
+                // NEUTRAL: new_positions stays flat
 
                 // Apply Layer 4 term structure multipliers (per commodity)
-                for (const auto& sym : {"HG", "GC", "CL", "SI", "ZN", "UB"}) {
-                    if (ts_mult.count(sym) && ts_mult[sym] < 1.0 - 1e-9) {
-                        double old_qty = new_positions[sym];
-                        new_positions[sym] = std::floor(old_qty * ts_mult[sym] + 0.5);
+                for (InstrumentId id : {Inst::HG, Inst::GC, Inst::CL, Inst::SI, Inst::ZN, Inst::UB}) {
+                    if (ts_mult[id] < 1.0 - 1e-9) {
+                        double old_qty = new_positions[id];
+                        new_positions[id] = std::floor(old_qty * ts_mult[id] + 0.5);
                     }
                 }
 
@@ -1611,10 +2283,10 @@ public:
                 // POSITION LIMITS - EXACT from doc
                 // ============================================================
                 // Per-instrument notional cap
-                for (auto& [sym, qty] : new_positions) {
-                    auto lit = SINGLE_NOTIONAL_LIMIT.find(sym);
-                    if (lit == SINGLE_NOTIONAL_LIMIT.end()) continue;
-                    double max_q = std::floor(std::max(0.0, equity * lit->second) / ContractSpec::get(sym).notional);
+                for (InstrumentId id : Inst::ALL) {
+                    double& qty = new_positions[id];
+                    if (std::isnan(SINGLE_NOTIONAL_LIMIT[id])) continue;
+                    double max_q = std::floor(std::max(0.0, equity * SINGLE_NOTIONAL_LIMIT[id]) / ContractSpec::get(id).notional);
                     // Guarantee at least 1 contract when target is non-zero, so
                     // high-notional instruments (e.g. GC) aren't clamped to 0.
                     if (max_q < 1.0 && std::abs(qty) > 1e-9)
@@ -1626,23 +2298,17 @@ public:
                 // Total directional equity cap
                 {
                     double eq_not = 0.0;
-                    for (const auto& s : {"MES", "MNQ"}) {
-                        auto it = new_positions.find(s);
-                        if (it != new_positions.end())
-                            eq_not += std::abs(it->second) * ContractSpec::get(s).notional;
-                    }
+                    for (InstrumentId id : {Inst::MES, Inst::MNQ})
+                        eq_not += std::abs(new_positions[id]) * ContractSpec::get(id).notional;
                     double max_eq = std::max(0.0, equity * MAX_TOTAL_EQUITY_NOTIONAL);
                     if (eq_not > max_eq && eq_not > 0.0) {
                         double scale = max_eq / eq_not;
-                        for (const auto& s : {"MES", "MNQ"}) {
-                            auto it = new_positions.find(s);
-                            if (it != new_positions.end()) {
-                                double old_val = it->second;
-                                double scaled = std::floor(std::abs(old_val) * scale + 0.5);
-                                if (scaled < 1.0 && std::abs(old_val) > 1e-9)
-                                    scaled = 1.0;
-                                it->second = std::copysign(scaled, old_val);
-                            }
+                        for (InstrumentId id : {Inst::MES, Inst::MNQ}) {
+                            double old_val = new_positions[id];
+                            double scaled = std::floor(std::abs(old_val) * scale + 0.5);
+                            if (scaled < 1.0 && std::abs(old_val) > 1e-9)
+                                scaled = 1.0;
+                            new_positions[id] = std::copysign(scaled, old_val);
                         }
                     }
                 }
@@ -1650,37 +2316,31 @@ public:
                 // Total directional commodity cap
                 {
                     double com_not = 0.0;
-                    for (const auto& s : {"HG", "GC", "CL", "SI"}) {
-                        auto it = new_positions.find(s);
-                        if (it != new_positions.end())
-                            com_not += std::abs(it->second) * ContractSpec::get(s).notional;
-                    }
+                    for (InstrumentId id : {Inst::HG, Inst::GC, Inst::CL, Inst::SI})
+                        com_not += std::abs(new_positions[id]) * ContractSpec::get(id).notional;
                     double max_com = std::max(0.0, equity * MAX_TOTAL_COMMODITY_NOTIONAL);
                     if (com_not > max_com && com_not > 0.0) {
                         double scale = max_com / com_not;
-                        for (const auto& s : {"HG", "GC", "CL", "SI"}) {
-                            auto it = new_positions.find(s);
-                            if (it != new_positions.end()) {
-                                double old_val = it->second;
-                                // Round via abs+copysign to avoid negative rounding bias.
-                                // Guarantee at least 1 contract in original direction.
-                                double scaled = std::floor(std::abs(old_val) * scale + 0.5);
-                                if (scaled < 1.0 && std::abs(old_val) > 1e-9)
-                                    scaled = 1.0;
-                                it->second = std::copysign(scaled, old_val);
-                            }
+                        for (InstrumentId id : {Inst::HG, Inst::GC, Inst::CL, Inst::SI}) {
+                            double old_val = new_positions[id];
+                            // Round via abs+copysign to avoid negative rounding bias.
+                            // Guarantee at least 1 contract in original direction.
+                            double scaled = std::floor(std::abs(old_val) * scale + 0.5);
+                            if (scaled < 1.0 && std::abs(old_val) > 1e-9)
+                                scaled = 1.0;
+                            new_positions[id] = std::copysign(scaled, old_val);
                         }
                     }
                 }
 
                 // Margin utilization
                 double total_margin = 0.0;
-                for (const auto& [sym, qty] : new_positions)
-                    total_margin += std::abs(qty) * ContractSpec::get(sym).margin;
+                for (InstrumentId id : Inst::ALL)
+                    total_margin += std::abs(new_positions[id]) * ContractSpec::get(id).margin;
                 margin_util = (equity > 0.0) ? total_margin / equity : 0.0;
                 if (margin_util > p_.max_margin_util && margin_util > 0.0) {
                     double scale = p_.max_margin_util / margin_util;
-                    for (auto& [sym, qty] : new_positions) {
+                    for (double& qty : new_positions) {
                         double old_val = qty;
                         double scaled = std::floor(std::abs(old_val) * scale + 0.5);
                         if (scaled < 1.0 && std::abs(old_val) > 1e-9)
@@ -1697,66 +2357,73 @@ public:
                 if (macro_tilt == MacroTilt::RISK_ON) {
                     // (same V5 drops as full-sizing mode above)
                     if (regime == Regime::INFLATION_SHOCK) {
-                        new_positions["HG"] = 0.0;
-                        new_positions["CL"] = pos_size;
-                        new_positions["SI"] = pos_size;
-                        new_positions["GC"] = skip_gold_short ? 0.0 : -pos_size;
-                        new_positions["ZN"] = -pos_size;
-                        new_positions["UB"] = -pos_size;
-                        new_positions["6J"] = 0.0;
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = 0.0;
+                        new_positions[Inst::HG] = 0.0;
+                        new_positions[Inst::CL] = pos_size;
+                        new_positions[Inst::SI] = pos_size;
+                        new_positions[Inst::GC] = skip_gold_short ? 0.0 : -pos_size;
+                        new_positions[Inst::ZN] = -pos_size;
+                        new_positions[Inst::UB] = -pos_size;
+                        new_positions[Inst::JY] = 0.0;
+                        new_positions[Inst::MES] = 0.0;
+                        new_positions[Inst::MNQ] = 0.0;
                     } else {
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = pos_size;
-                        new_positions["HG"] = 0.0;
-                        new_positions["CL"] = pos_size;
-                        new_positions["SI"] = pos_size;
-                        new_positions["GC"] = skip_gold_short ? 0.0 : -pos_size;
-                        new_positions["ZN"] = -pos_size;
-                        new_positions["UB"] = -pos_size;
-                        new_positions["6J"] = 0.0;
+                        new_positions[Inst::MES] = 0.0;
+                        new_positions[Inst::MNQ] = pos_size;
+                        new_positions[Inst::HG] = 0.0;
+                        new_positions[Inst::CL] = pos_size;
+                        new_positions[Inst::SI] = pos_size;
+                        new_positions[Inst::GC] = skip_gold_short ? 0.0 : -pos_size;
+                        new_positions[Inst::ZN] = -pos_size;
+                        new_positions[Inst::UB] = -pos_size;
+                        new_positions[Inst::JY] = 0.0;
                     }
                 } else if (macro_tilt == MacroTilt::RISK_OFF) {
                     if (regime == Regime::INFLATION_SHOCK) {
-                        new_positions["GC"] = pos_size;
-                        new_positions["ZN"] = -pos_size;
-                        new_positions["UB"] = -pos_size;
-                        new_positions["SI"] = pos_size;
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = 0.0;
-                        new_positions["HG"] = 0.0;
-                        new_positions["CL"] = 0.0;
-                        new_positions["6J"] = 0.0;
+                        new_positions[Inst::GC] = pos_size;
+                        new_positions[Inst::ZN] = -pos_size;
+                        new_positions[Inst::UB] = -pos_size;
+                        new_positions[Inst::SI] = pos_size;
+                        new_positions[Inst::MES] = 0.0;
+                        new_positions[Inst::MNQ] = 0.0;
+                        new_positions[Inst::HG] = 0.0;
+                        new_positions[Inst::CL] = 0.0;
+                        new_positions[Inst::JY] = 0.0;
                     } else {
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = 0.0;
-                        new_positions["HG"] = 0.0;
-                        new_positions["CL"] = -pos_size;
-                        new_positions["GC"] = pos_size;
-                        new_positions["SI"] = pos_size;
-                        new_positions["ZN"] = pos_size;
-                        new_positions["UB"] = pos_size;
-                        new_positions["6J"] = 0.0;
+                        new_positions[Inst::MES] = 0.0;
+                        new_positions[Inst::MNQ] = 0.0;
+                        new_positions[Inst::HG] = 0.0;
+                        new_positions[Inst::CL] = -pos_size;
+                        new_positions[Inst::GC] = pos_size;
+                        new_positions[Inst::SI] = pos_size;
+                        new_positions[Inst::ZN] = pos_size;
+                        new_positions[Inst::UB] = pos_size;
+                        new_positions[Inst::JY] = 0.0;
                     }
+                } else {
+                    targeted.fill(false);
                 }
 
                 // Apply Layer 4 term structure multipliers (per commodity)
-                for (const auto& sym : {"HG", "GC", "CL", "SI", "ZN", "UB"}) {
-                    if (ts_mult.count(sym) && ts_mult[sym] < 1.0 - 1e-9) {
-                        double old_qty = new_positions[sym];
-                        new_positions[sym] = std::floor(old_qty * ts_mult[sym] + 0.5);
+                for (InstrumentId id : {Inst::HG, Inst::GC, Inst::CL, Inst::SI, Inst::ZN, Inst::UB}) {
+                    if (ts_mult[id] < 1.0 - 1e-9) {
+                        double old_qty = new_positions[id];
+                        new_positions[id] = std::floor(old_qty * ts_mult[id] + 0.5);
+                        targeted[id] = true;
                     }
                 }
             }
             // Respect ATR stops - don't re-enter stopped positions on same day
-            for (const auto& sym : stopped_out_today) {
-                new_positions[sym] = 0.0;
+            for (InstrumentId id : Inst::ALL) {
+                if (stopped_out_today[id]) {
+                    new_positions[id] = 0.0;
+                    targeted[id] = true;
+                }
             }
 
             // REBALANCE BANDS: suppress noise trades (same-direction resizing below threshold)
-            for (auto& [sym, new_qty] : new_positions) {
-                double old_qty = positions.count(sym) ? positions.at(sym) : 0.0;
+            for (InstrumentId id : Inst::ALL) {
+                double& new_qty = new_positions[id];
+                double old_qty = positions[id];
                 double delta = std::abs(new_qty - old_qty);
                 double current_abs = std::max(std::abs(old_qty), 1.0);
 
@@ -1769,8 +2436,9 @@ public:
                     // Suppress same-direction resizing below threshold:
                     // Must exceed BOTH absolute band AND relative band
                     // UB/ZN use wider bands (4 contracts / 50%) to reduce bond turnover
-                    double abs_band = (sym == "UB" || sym == "ZN") ? 4.0 : 3.0;
-                    double rel_band = (sym == "UB" || sym == "ZN") ? 0.50 : 0.40;
+                    bool bond = (id == Inst::UB || id == Inst::ZN);
+                    double abs_band = bond ? 4.0 : 3.0;
+                    double rel_band = bond ? 0.50 : 0.40;
                     double relative_change = delta / current_abs;
                     if (delta < abs_band || relative_change < rel_band) {
                         new_qty = old_qty;  // keep current position
@@ -1780,14 +2448,16 @@ public:
 
             // Update positions for next day — deduct full transaction costs on changes
             // doc Phase 6 line 749: "spread + slippage + commission per contract"
-            for (const auto& [sym, new_qty] : new_positions) {
-                double old_qty = positions.count(sym) ? positions.at(sym) : 0.0;
+            for (InstrumentId id : Inst::ALL) {
+                if (!targeted[id]) continue;
+                double new_qty = new_positions[id];
+                double old_qty = positions[id];
                 double qty_change = std::abs(new_qty - old_qty);
                 if (qty_change > 0.0) {
-                    double total_cost = ContractSpec::total_cost_rt(sym) * qty_change;
+                    double total_cost = ContractSpec::total_cost_rt(id) * qty_change;
                     equity -= total_cost;
                     total_costs_deducted += total_cost;
-                    instrument_costs[sym] += total_cost;
+                    instrument_costs[id] += total_cost;
                 }
                 // Detect completed round-trips: position exits to flat or flips sign
                 bool was_flat = (std::abs(old_qty) < 1e-9);
@@ -1795,22 +2465,22 @@ public:
                 bool sign_flip = (!was_flat && !now_flat && (old_qty * new_qty < 0.0));
                 if (!was_flat && (now_flat || sign_flip)) {
                     // Round-trip completed — record win/loss
-                    instrument_trades[sym]++;
-                    if (instrument_open_pnl[sym] > 0.0) {
-                        instrument_wins[sym]++;
-                        instrument_gross_win[sym] += instrument_open_pnl[sym];
-                    } else if (instrument_open_pnl[sym] < 0.0) {
-                        instrument_losses[sym]++;
-                        instrument_gross_loss[sym] += std::abs(instrument_open_pnl[sym]);
+                    instrument_trades[id]++;
+                    if (instrument_open_pnl[id] > 0.0) {
+                        instrument_wins[id]++;
+                        instrument_gross_win[id] += instrument_open_pnl[id];
+                    } else if (instrument_open_pnl[id] < 0.0) {
+                        instrument_losses[id]++;
+                        instrument_gross_loss[id] += std::abs(instrument_open_pnl[id]);
                     }
-                    instrument_open_pnl[sym] = 0.0;
+                    instrument_open_pnl[id] = 0.0;
                 }
                 // Record entry price when position opens from flat
                 if (old_qty == 0.0 && new_qty != 0.0) {
-                    const auto* px = px_map.count(sym) ? px_map.at(sym) : nullptr;
-                    entry_prices[sym] = (px && !std::isnan((*px)[i])) ? (*px)[i] : std::numeric_limits<double>::quiet_NaN();
+                    const auto* px = px_map[id];
+                    entry_prices[id] = !std::isnan((*px)[i]) ? (*px)[i] : std::numeric_limits<double>::quiet_NaN();
                 } else if (new_qty == 0.0) {
-                    entry_prices[sym] = std::numeric_limits<double>::quiet_NaN();
+                    entry_prices[id] = std::numeric_limits<double>::quiet_NaN();
                 }
             }
             positions = new_positions;
@@ -1819,7 +2489,7 @@ public:
             // Save signal
             // ============================================================
             DailySignal sig;
-            sig.date = date_from_int(dates[i]);
+            sig.date = date_strs[i];
             sig.cu_gold_ratio = ratio[i];
             sig.roc_10 = std::isnan(roc10) ? 0.0 : roc10;
             sig.roc_20 = std::isnan(roc20) ? 0.0 : roc20;
@@ -1848,6 +2518,7 @@ public:
 
             sig.size_multiplier = size_mult;
             sig.target_contracts = positions;
+            for (InstrumentId id : Inst::ALL) sig.dropped[id] = !targeted[id];
             sig.portfolio_equity = equity;
             sig.margin_utilization = margin_util;
             sig.drawdown_warning = dd_warn;
@@ -1946,7 +2617,7 @@ public:
                 for (const auto& s : signals) {
                     if (s.macro_tilt != prev_t2) { ++total_flips; prev_t2 = s.macro_tilt; }
                 }
-                double yrs = n_signals / 252.0;
+                double yrs = n_signals / static_cast<double>(TradingCalendar::TRADING_YEAR);
                 double fpy = (yrs > 0) ? total_flips / yrs : 0;
                 std::cout << "  Total flips: " << total_flips
                           << "  Years: " << std::setprecision(1) << yrs
@@ -1959,11 +2630,11 @@ public:
                 double max_abs_gc = 0, max_abs_hg = 0;
                 for (const auto& s : signals) {
                     bool any = false;
-                    for (const auto& [sym, qty] : s.target_contracts) {
+                    for (double qty : s.target_contracts) {
                         if (qty != 0) { any = true; }
-                        if (sym == "GC") max_abs_gc = std::max(max_abs_gc, std::abs(qty));
-                        if (sym == "HG") max_abs_hg = std::max(max_abs_hg, std::abs(qty));
                     }
+                    max_abs_gc = std::max(max_abs_gc, std::abs(s.target_contracts[Inst::GC]));
+                    max_abs_hg = std::max(max_abs_hg, std::abs(s.target_contracts[Inst::HG]));
                     if (any) ++days_with_positions;
                 }
                 double pct_invested = (n_signals > 0) ? 100.0 * days_with_positions / n_signals : 0;
@@ -2033,7 +2704,7 @@ public:
         inst_gross_loss_total = instrument_gross_loss;
 
         // Close any still-open positions as uncompleted trades
-        for (const char* s : {"HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"}) {
+        for (InstrumentId s : Inst::ALL) {
             if (std::abs(positions[s]) > 1e-9 && std::abs(instrument_open_pnl[s]) > 1e-9) {
                 inst_trades_total[s]++;
                 if (instrument_open_pnl[s] > 0.0) {
@@ -2107,9 +2778,10 @@ int main(int argc, char* argv[]) {
             std::cout << "Final Margin Util: " << std::setprecision(1)
                       << (last.margin_utilization * 100.0) << "%\n";
             std::cout << "\nFinal Positions:\n";
-            for (const auto& [sym, qty] : last.target_contracts) {
+            for (InstrumentId id : Inst::ALL) {
+                double qty = last.target_contracts[id];
                 if (qty != 0.0)
-                    std::cout << "  " << sym << ": " << qty << " contracts\n";
+                    std::cout << "  " << Inst::symbol(id) << ": " << qty << " contracts\n";
             }
         }
 
@@ -2132,9 +2804,10 @@ int main(int argc, char* argv[]) {
         for (int i = 0; i < N; ++i)
             daily_returns[i] = (daily_equity[i+1] - daily_equity[i]) / daily_equity[i];
 
+        const double year = TradingCalendar::TRADING_YEAR;   // annualisation basis
         double total_days = N;
         double total_return = (daily_equity.back() / daily_equity.front()) - 1.0;
-        double ann_return = std::pow(1.0 + total_return, 252.0 / total_days) - 1.0;
+        double ann_return = std::pow(1.0 + total_return, year / total_days) - 1.0;
 
         double mean_ret = 0.0;
         for (double r : daily_returns) mean_ret += r;
@@ -2143,7 +2816,7 @@ int main(int argc, char* argv[]) {
         double var = 0.0;
         for (double r : daily_returns) var += (r - mean_ret) * (r - mean_ret);
         var /= N;
-        double ann_std = std::sqrt(var) * std::sqrt(252.0);
+        double ann_std = std::sqrt(var) * std::sqrt(year);
 
         double sharpe = (ann_std > 0.0) ? ann_return / ann_std : 0.0;
 
@@ -2153,7 +2826,7 @@ int main(int argc, char* argv[]) {
             if (r < 0.0) { downside_var += r * r; downside_count++; }
         }
         double downside_std = (downside_count > 0)
-            ? std::sqrt(downside_var / downside_count) * std::sqrt(252.0) : 0.0;
+            ? std::sqrt(downside_var / downside_count) * std::sqrt(year) : 0.0;
         double sortino = (downside_std > 0.0) ? ann_return / downside_std : 0.0;
 
         double peak = initial_capital, max_dd = 0.0;
@@ -2175,17 +2848,17 @@ int main(int argc, char* argv[]) {
 
         double total_notional_traded = 0.0;
         for (int i = 1; i < (int)signals.size(); ++i) {
-            for (const auto& [sym, qty] : signals[i].target_contracts) {
-                double prev_qty = 0.0;
-                auto it = signals[i-1].target_contracts.find(sym);
-                if (it != signals[i-1].target_contracts.end()) prev_qty = it->second;
-                total_notional_traded += std::abs(qty - prev_qty) * ContractSpec::get(sym).notional;
+            for (InstrumentId id : Inst::ALL) {
+                if (signals[i].dropped[id]) continue;
+                double qty = signals[i].target_contracts[id];
+                double prev_qty = signals[i-1].target_contracts[id];
+                total_notional_traded += std::abs(qty - prev_qty) * ContractSpec::get(id).notional;
             }
         }
         double avg_equity = 0.0;
         for (const auto& sig : signals) avg_equity += sig.portfolio_equity;
         avg_equity /= (double)signals.size();
-        double years = total_days / 252.0;
+        double years = total_days / year;
         double annual_turnover = (avg_equity > 0.0 && years > 0.0)
             ? (total_notional_traded / years) / avg_equity : 0.0;
 
@@ -2257,19 +2930,18 @@ int main(int argc, char* argv[]) {
         std::cout << hdr << "\n";
         std::cout << std::string(80, '-') << "\n";
 
-        const std::vector<std::string> inst_order = {"HG","GC","CL","SI","ZN","UB","6J","MES","MNQ"};
         double sum_pnl = 0.0, sum_costs = 0.0, sum_net = 0.0;
         int sum_trades = 0, sum_wins = 0, sum_losses = 0;
         double sum_gross_win = 0.0, sum_gross_loss = 0.0;
 
-        for (const auto& sym : inst_order) {
-            double gpnl  = strategy.inst_pnl_total.count(sym) ? strategy.inst_pnl_total.at(sym) : 0.0;
-            double costs = strategy.inst_costs_total.count(sym) ? strategy.inst_costs_total.at(sym) : 0.0;
-            int trades   = strategy.inst_trades_total.count(sym) ? strategy.inst_trades_total.at(sym) : 0;
-            int wins     = strategy.inst_wins_total.count(sym) ? strategy.inst_wins_total.at(sym) : 0;
-            int losses   = strategy.inst_losses_total.count(sym) ? strategy.inst_losses_total.at(sym) : 0;
-            double gwin  = strategy.inst_gross_win_total.count(sym) ? strategy.inst_gross_win_total.at(sym) : 0.0;
-            double gloss = strategy.inst_gross_loss_total.count(sym) ? strategy.inst_gross_loss_total.at(sym) : 0.0;
+        for (InstrumentId id : Inst::ALL) {
+            double gpnl  = strategy.inst_pnl_total[id];
+            double costs = strategy.inst_costs_total[id];
+            int trades   = strategy.inst_trades_total[id];
+            int wins     = strategy.inst_wins_total[id];
+            int losses   = strategy.inst_losses_total[id];
+            double gwin  = strategy.inst_gross_win_total[id];
+            double gloss = strategy.inst_gross_loss_total[id];
             double net   = gpnl - costs;
             double winpct = (trades > 0) ? (100.0 * wins / trades) : 0.0;
             double avg_win  = (wins > 0) ? gwin / wins : 0.0;
@@ -2278,7 +2950,7 @@ int main(int argc, char* argv[]) {
             char row[256];
             snprintf(row, sizeof(row),
                 "%-6s %12.2f %6d %5.1f%% %10.2f %10.2f %10.2f %12.2f",
-                sym.c_str(), gpnl, trades, winpct, avg_win, avg_loss, costs, net);
+                Inst::symbol(id), gpnl, trades, winpct, avg_win, avg_loss, costs, net);
             std::cout << row << "\n";
 
             sum_pnl += gpnl;
@@ -6,243 +6,2504 @@
 // No synthetic data. No lookahead bias. All signals use only data[0..i].
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <cmath>
-#include <ctime>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <unordered_set>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <deque>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 // ============================================================
 // Date utilities
 // ============================================================
-static std::string trim(const std::string& s) {
+static std::string_view trim(std::string_view s) {
     size_t b = s.find_first_not_of(" \t\r\n");
-    if (b == std::string::npos) return "";
+    if (b == std::string_view::npos) return {};
     size_t e = s.find_last_not_of(" \t\r\n");
     return s.substr(b, e - b + 1);
 }
 
-static int parse_date(const std::string& d) {
-    std::tm t = {};
-    std::istringstream ss(d);
-    ss >> std::get_time(&t, "%Y-%m-%d");
-    if (ss.fail()) return -1;
-    t.tm_isdst = -1;
-    time_t ts = std::mktime(&t);
-    return static_cast<int>(ts / 86400);
+// Day keys are days since 1970-01-01 in the proleptic Gregorian calendar.
+// The codec below is pure integer arithmetic (H. Hinnant's days_from_civil /
+// civil_from_days), so keys never depend on libc time calls or the host TZ.
+struct CivilDate {
+    int y, m, d;
+};
+
+static constexpr int days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;                                  // [0, 399]
+    const int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;  // [0, 365]
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;          // [0, 146096]
+    return era * 146097 + doe - 719468;
+}
+
+static constexpr CivilDate civil_from_days(int z) {
+    z += 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const int doe = z - era * 146097;                                      // [0, 146096]
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;  // [0, 399]
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                // [0, 365]
+    const int mp = (5 * doy + 2) / 153;                                     // [0, 11]
+    const int d = doy - (153 * mp + 2) / 5 + 1;
+    const int m = mp < 10 ? mp + 3 : mp - 9;
+    return {era * 400 + yoe + (m <= 2), m, d};
+}
+
+// Parses YYYY-MM-DD (1-2 digit month/day accepted); -1 on malformed input.
+// constexpr so literals fold at compile time: parse_date("2014-11-01").
+static constexpr int parse_date(std::string_view s) {
+    int field[3] = {0, 0, 0};
+    size_t pos = 0;
+    for (int f = 0; f < 3; ++f) {
+        if (f > 0) {
+            if (pos >= s.size() || s[pos] != '-') return -1;
+            ++pos;
+        }
+        size_t start = pos;
+        while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9' && pos - start < 4)
+            field[f] = field[f] * 10 + (s[pos++] - '0');
+        if (pos == start) return -1;
+    }
+    if (field[1] < 1 || field[1] > 12 || field[2] < 1 || field[2] > 31) return -1;
+    return days_from_civil(field[0], field[1], field[2]);
+}
+
+static_assert(parse_date("1970-01-01") == 0, "epoch");
+static_assert(parse_date("2014-11-01") == 16375, "codec");
+static_assert(civil_from_days(16375).y == 2014 && civil_from_days(16375).m == 11 &&
+              civil_from_days(16375).d == 1, "codec round trip");
+
+// Writes YYYY-MM-DD into out[0..9] (not NUL-terminated)
+static void format_date(int day_key, char* out) {
+    const CivilDate c = civil_from_days(day_key);
+    int y = c.y;
+    for (int k = 3; k >= 0; --k) { out[k] = static_cast<char>('0' + y % 10); y /= 10; }
+    out[4] = '-';
+    out[5] = static_cast<char>('0' + c.m / 10);
+    out[6] = static_cast<char>('0' + c.m % 10);
+    out[7] = '-';
+    out[8] = static_cast<char>('0' + c.d / 10);
+    out[9] = static_cast<char>('0' + c.d % 10);
+}
+
+static std::string date_from_int(int day_key) {
+    char buf[10];
+    format_date(day_key, buf);
+    return std::string(buf, sizeof(buf));
+}
+
+// 0 = Sunday .. 6 = Saturday (1970-01-01 was a Thursday)
+static constexpr int weekday(int day_key) {
+    return ((day_key % 7) + 11) % 7;
+}
+static_assert(weekday(0) == 4 && weekday(16375) == 6, "weekday");
+
+// Batch formatter: one string per key, computed once up front
+static std::vector<std::string> format_dates(const std::vector<int>& day_keys) {
+    std::vector<std::string> out(day_keys.size(), std::string(10, '0'));
+    for (size_t k = 0; k < day_keys.size(); ++k)
+        format_date(day_keys[k], out[k].data());
+    return out;
+}
+
+// ISO-8601 week as yyyyww: weeks start on Monday and belong to the year
+// holding their Thursday
+static constexpr int iso_week(int day_key) {
+    const int thursday = day_key - (weekday(day_key) + 6) % 7 + 3;
+    const int y = civil_from_days(thursday).y;
+    return y * 100 + (thursday - days_from_civil(y, 1, 1)) / 7 + 1;
+}
+static_assert(iso_week(parse_date("2014-11-01")) == 201444, "iso week");
+static_assert(iso_week(parse_date("2021-01-01")) == 202053, "iso week year");
+
+// ============================================================
+// Trading calendar
+// ============================================================
+// Built once from the panel's day keys: weekday per row, a start-of-period
+// bitset and the row offsets of every period per boundary, so schedules
+// and rolling-year counters are lookups rather than date arithmetic in
+// the daily loops. A period ends on the row before the next one starts;
+// the last row of the calendar closes nothing until another is appended.
+class TradingCalendar {
+public:
+    enum Boundary { WEEK, MONTH, QUARTER, YEAR, BOUNDARY_COUNT };
+
+    // Index steps the signal loops and metrics treat as one year
+    static constexpr int TRADING_YEAR = 252;
+
+    TradingCalendar() = default;
+    explicit TradingCalendar(const std::vector<int>& days) {
+        days_.reserve(days.size());
+        weekday_.reserve(days.size());
+        for (int d : days) append(d);
+    }
+
+    // Day keys must be ascending
+    void append(int day) {
+        const size_t i = days_.size();
+        if (i % 64 == 0)
+            for (auto& bits : starts_) bits.push_back(0);
+        for (int b = 0; b < BOUNDARY_COUNT; ++b) {
+            const int key = period_key(static_cast<Boundary>(b), day);
+            if (i == 0 || key != last_key_[b]) {
+                starts_[b][i / 64] |= uint64_t(1) << (i % 64);
+                offsets_[b].push_back(static_cast<uint32_t>(i));
+                last_key_[b] = key;
+            }
+            period_[b].push_back(static_cast<uint32_t>(offsets_[b].size() - 1));
+        }
+        days_.push_back(day);
+        weekday_.push_back(static_cast<uint8_t>(::weekday(day)));
+        // First row less than 365 calendar days back
+        size_t lo = i == 0 ? 0 : year_back_.back();
+        while (days_[lo] <= day - 365) ++lo;
+        year_back_.push_back(static_cast<uint32_t>(lo));
+    }
+
+    size_t size() const { return days_.size(); }
+    int day(size_t i) const { return days_[i]; }
+    int weekday(size_t i) const { return weekday_[i]; }
+    bool is_friday(size_t i) const { return weekday_[i] == 5; }
+    int iso_week(size_t i) const { return ::iso_week(days_[i]); }
+
+    bool starts(Boundary b, size_t i) const { return (starts_[b][i / 64] >> (i % 64)) & 1; }
+    bool ends(Boundary b, size_t i) const { return i + 1 < size() && starts(b, i + 1); }
+
+    // Periods of a boundary and their first rows, ascending
+    size_t periods(Boundary b) const { return offsets_[b].size(); }
+    size_t period_start(Boundary b, size_t k) const { return offsets_[b][k]; }
+    // First row of the period holding row i
+    size_t period_begin(Boundary b, size_t i) const { return offsets_[b][period_[b][i]]; }
+
+    // 1-based business day of row i within its period; nth(MONTH, i) == 1
+    // flags the first trading day of each month
+    int nth(Boundary b, size_t i) const { return static_cast<int>(i - period_begin(b, i)) + 1; }
+
+    // First row of the TRADING_YEAR-step window ending at row i
+    static constexpr size_t trailing_year_begin(size_t i) {
+        return i > static_cast<size_t>(TRADING_YEAR) ? i - TRADING_YEAR : 0;
+    }
+    // First row of the 365-calendar-day window ending at row i
+    size_t trailing_calendar_year_begin(size_t i) const { return year_back_[i]; }
+
+private:
+    static int period_key(Boundary b, int day) {
+        if (b == WEEK) return (day + 3 - (day + 3 < 0 ? 6 : 0)) / 7;   // Monday-based week
+        const CivilDate c = civil_from_days(day);
+        switch (b) {
+            case MONTH:   return c.y * 12 + c.m - 1;
+            case QUARTER: return c.y * 4 + (c.m - 1) / 3;
+            default:      return c.y;
+        }
+    }
+
+    std::vector<int> days_;
+    std::vector<uint8_t> weekday_;
+    std::vector<uint64_t> starts_[BOUNDARY_COUNT];
+    std::vector<uint32_t> offsets_[BOUNDARY_COUNT];
+    std::vector<uint32_t> period_[BOUNDARY_COUNT];
+    std::vector<uint32_t> year_back_;
+    int last_key_[BOUNDARY_COUNT] = {};
+};
+
+// ============================================================
+// Data types
+// ============================================================
+struct OHLCVBar {
+    double open = 0.0, high = 0.0, low = 0.0, close = 0.0, volume = 0.0;
+};
+
+// Flat series: sorted day keys plus parallel value columns, one contiguous
+// array per field instead of one tree node per bar. Lookups return row
+// indices; npos means "no such row".
+struct DateIndex {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    std::vector<int> keys;  // strictly increasing
+
+    size_t size() const { return keys.size(); }
+    bool empty() const { return keys.empty(); }
+    int first_date() const { return keys.front(); }
+    int last_date() const { return keys.back(); }
+
+    // First row with key >= dk / key > dk
+    size_t lower_bound(int dk) const {
+        return std::lower_bound(keys.begin(), keys.end(), dk) - keys.begin();
+    }
+    size_t upper_bound(int dk) const {
+        return std::upper_bound(keys.begin(), keys.end(), dk) - keys.begin();
+    }
+    // Row dated exactly dk
+    size_t find(int dk) const {
+        size_t r = lower_bound(dk);
+        return (r < keys.size() && keys[r] == dk) ? r : npos;
+    }
+    // As-of: last row with key <= dk
+    size_t asof(int dk) const {
+        size_t r = upper_bound(dk);
+        return r ? r - 1 : npos;
+    }
+
+protected:
+    // Restores strict key order after out-of-order appends. On a duplicate
+    // date the row read last wins, as with the old map insert_or_assign.
+    template <class... Cols>
+    void normalize(Cols&... cols) {
+        if (std::is_sorted(keys.begin(), keys.end(), std::less_equal<int>())) return;
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(),
+                         [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+        std::vector<size_t> keep;
+        keep.reserve(order.size());
+        for (size_t j = 0; j < order.size(); ++j)
+            if (j + 1 == order.size() || keys[order[j + 1]] != keys[order[j]])
+                keep.push_back(order[j]);
+        auto gather = [&](auto& col) {
+            std::remove_reference_t<decltype(col)> out;
+            out.reserve(keep.size());
+            for (size_t r : keep) out.push_back(col[r]);
+            col.swap(out);
+        };
+        gather(keys);
+        (gather(cols), ...);
+    }
+};
+
+// Forward-only as-of cursor for monotone date queries (amortized O(1) per
+// step instead of a binary search)
+class AsofCursor {
+public:
+    explicit AsofCursor(const DateIndex& idx) : keys_(&idx.keys) {}
+
+    // Last row with key <= dk; dk must not decrease between calls
+    size_t seek(int dk) {
+        while (pos_ < keys_->size() && (*keys_)[pos_] <= dk) ++pos_;
+        return pos_ ? pos_ - 1 : DateIndex::npos;
+    }
+
+private:
+    const std::vector<int>* keys_;
+    size_t pos_ = 0;
+};
+
+struct TimeSeries : DateIndex {
+    std::vector<double> value;
+
+    void push(int dk, double v) {
+        keys.push_back(dk);
+        value.push_back(v);
+    }
+    void finish() { normalize(value); }
+};
+
+struct FuturesSeries : DateIndex {
+    std::vector<double> open, high, low, close, volume;
+
+    void push(int dk, const OHLCVBar& bar) {
+        keys.push_back(dk);
+        open.push_back(bar.open);
+        high.push_back(bar.high);
+        low.push_back(bar.low);
+        close.push_back(bar.close);
+        volume.push_back(bar.volume);
+    }
+    void finish() { normalize(open, high, low, close, volume); }
+};
+
+// ============================================================
+// Thread pool
+// ============================================================
+// Fixed set of workers, each with its own task deque. A worker pops its
+// own deque from the back (newest first) and, when that is empty, steals
+// from the front of the others (oldest first); a thread outside the pool
+// deals its tasks round-robin over the deques. parallel_for() fans a loop
+// out across the workers, runs its share on the calling thread and returns
+// once every index is done (rethrowing the first exception, if any).
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = default_threads()) {
+        for (unsigned t = 0; t < threads; ++t)
+            queues_.push_back(std::make_unique<Queue>());
+        for (unsigned t = 0; t < threads; ++t)
+            workers_.emplace_back([this, t] { worker_loop(t); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(sleep_mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static unsigned default_threads() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn) {
+        if (count == 0) return;
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_mu;
+        auto drain = [&] {
+            for (size_t k = next++; k < count; k = next++) {
+                try {
+                    fn(k);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lk(error_mu);
+                    if (!error) error = std::current_exception();
+                }
+            }
+        };
+
+        const size_t helpers = std::min(count - 1, workers_.size());
+        std::atomic<size_t> active{helpers};
+        for (size_t h = 0; h < helpers; ++h)
+            push([&] {
+                drain();
+                active.fetch_sub(1);
+                wake();
+            });
+        drain();
+
+        // Run queued or stolen tasks while waiting instead of blocking, so
+        // a parallel_for issued from inside a worker cannot deadlock the pool
+        while (active.load() > 0) {
+            Task task;
+            if (take(self_index(), task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(sleep_mu_);
+            cv_.wait(lk, [&] { return active.load() == 0 || pending_.load() > 0; });
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    using Task = std::function<void()>;
+
+    struct Queue {
+        std::mutex mu;
+        std::deque<Task> tasks;
+    };
+
+    // Index of the calling thread's own deque, or npos outside this pool
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    size_t self_index() const { return tls_pool_ == this ? tls_index_ : npos; }
+
+    void push(Task task) {
+        size_t q = self_index();
+        if (q == npos) q = next_queue_++ % queues_.size();
+        {
+            std::lock_guard<std::mutex> lk(queues_[q]->mu);
+            queues_[q]->tasks.push_back(std::move(task));
+        }
+        pending_.fetch_add(1);
+        wake();
+    }
+
+    // Own deque from the back, then the others from the front
+    bool take(size_t self, Task& out) {
+        const size_t n = queues_.size();
+        if (self != npos && pop(*queues_[self], out, true)) return true;
+        const size_t start = (self != npos) ? self + 1 : 0;
+        for (size_t k = 0; k < n; ++k) {
+            const size_t q = (start + k) % n;
+            if (q != self && pop(*queues_[q], out, false)) return true;
+        }
+        return false;
+    }
+
+    bool pop(Queue& q, Task& out, bool back) {
+        std::lock_guard<std::mutex> lk(q.mu);
+        if (q.tasks.empty()) return false;
+        if (back) {
+            out = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        } else {
+            out = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        pending_.fetch_sub(1);
+        return true;
+    }
+
+    // Taking the lock orders the caller's state change before any
+    // sleeper's predicate check, so no wakeup is lost
+    void wake() {
+        { std::lock_guard<std::mutex> lk(sleep_mu_); }
+        cv_.notify_all();
+    }
+
+    void worker_loop(size_t index) {
+        tls_pool_ = this;
+        tls_index_ = index;
+        for (;;) {
+            Task task;
+            if (take(index, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(sleep_mu_);
+            cv_.wait(lk, [this] { return stop_ || pending_.load() > 0; });
+            if (stop_ && pending_.load() == 0) return;  // nothing left to run
+        }
+    }
+
+    static thread_local const ThreadPool* tls_pool_;
+    static thread_local size_t tls_index_;
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> pending_{0};      // tasks sitting in any deque
+    std::atomic<size_t> next_queue_{0};   // round-robin cursor for outside pushes
+    std::mutex sleep_mu_;
+    std::condition_variable cv_;
+    bool stop_ = false;                   // guarded by sleep_mu_
+};
+
+thread_local const ThreadPool* ThreadPool::tls_pool_ = nullptr;
+thread_local size_t ThreadPool::tls_index_ = 0;
+
+// Process-wide pool shared by the loaders
+static ThreadPool& shared_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// ============================================================
+// Logging
+// ============================================================
+// Leveled, category-filtered log for the per-day diagnostics. A disabled
+// message costs one predictable branch and never formats its arguments;
+// levels above CG_LOG_MAX_LEVEL are removed at compile time. Enabled
+// messages are formatted on the calling thread, pushed onto a lock-free
+// ring and written to stdout by a background drainer, so the strategy
+// never waits on terminal I/O. Text is unchanged from the direct writes.
+//
+// Runtime filters: CG_LOG_LEVEL=error|warn|info|debug and
+// CG_LOG_CATEGORIES=<comma list of category names, or "all">.
+#ifndef CG_LOG_MAX_LEVEL
+#define CG_LOG_MAX_LEVEL 3  // debug; build with -DCG_LOG_MAX_LEVEL=1 to strip info/debug
+#endif
+
+namespace Log {
+enum Level : int { ERROR = 0, WARN = 1, INFO = 2, DEBUG = 3 };
+
+enum Category : uint32_t {
+    GENERAL   = 1u << 0,
+    LIQUIDITY = 1u << 1,  // Nov-2014 liquidity component dump
+    BE_CHECK  = 1u << 2,  // [BE_CHECK] yearly breakeven units check
+    EQUITY    = 1u << 3,  // post-equity prints, unusual equity change
+    DRAWDOWN  = 1u << 4,  // [DD]
+    REBALANCE = 1u << 5,  // [REB]
+    SIZING    = 1u << 6,  // [SIZING]
+    POSITIONS = 1u << 7,  // per-day position dump
+    ALL       = 0xffffffffu
+};
+
+static constexpr const char* LEVEL_NAMES[] = {"error", "warn", "info", "debug"};
+static constexpr std::pair<const char*, Category> CATEGORY_NAMES[] = {
+    {"general", GENERAL}, {"liquidity", LIQUIDITY}, {"be_check", BE_CHECK},
+    {"equity", EQUITY},   {"dd", DRAWDOWN},         {"reb", REBALANCE},
+    {"sizing", SIZING},   {"positions", POSITIONS}, {"all", ALL},
+};
+
+static int read_level() {
+    if (const char* env = std::getenv("CG_LOG_LEVEL"))
+        for (int lv = ERROR; lv <= DEBUG; ++lv)
+            if (std::strcmp(env, LEVEL_NAMES[lv]) == 0) return lv;
+    return DEBUG;
+}
+
+static uint32_t read_categories() {
+    const char* env = std::getenv("CG_LOG_CATEGORIES");
+    if (!env) return ALL;
+    uint32_t mask = 0;
+    std::string_view rest(env);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view name = trim(rest.substr(0, comma));
+        for (const auto& [n, cat] : CATEGORY_NAMES)
+            if (name == n) mask |= cat;
+        rest = (comma == std::string_view::npos) ? std::string_view() : rest.substr(comma + 1);
+    }
+    return mask;
+}
+
+static std::atomic<int>      g_level{read_level()};
+static std::atomic<uint32_t> g_categories{read_categories()};
+
+static inline bool enabled(Level lv, Category cat) {
+    return lv <= CG_LOG_MAX_LEVEL
+        && lv <= g_level.load(std::memory_order_relaxed)
+        && (g_categories.load(std::memory_order_relaxed) & cat) != 0;
+}
+
+// Bounded multi-producer ring (sequence-numbered slots); one consumer
+class Ring {
+public:
+    explicit Ring(size_t capacity) : slots_(capacity), mask_(capacity - 1) {
+        for (size_t k = 0; k < capacity; ++k) slots_[k].seq.store(k, std::memory_order_relaxed);
+    }
+
+    bool try_push(std::string& msg) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& s = slots_[pos & mask_];
+            size_t seq = s.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    s.msg.swap(msg);
+                    s.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(std::string& out) {
+        Slot& s = slots_[head_ & mask_];
+        if (s.seq.load(std::memory_order_acquire) != head_ + 1) return false;
+        out.swap(s.msg);
+        s.msg.clear();
+        s.seq.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    size_t pushed() const { return tail_.load(std::memory_order_acquire); }
+
+    // Consumer only: whether the next slot has been published
+    bool ready() const {
+        return slots_[head_ & mask_].seq.load(std::memory_order_acquire) == head_ + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> seq{0};
+        std::string msg;
+    };
+    std::vector<Slot> slots_;
+    const size_t mask_;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) size_t head_ = 0;  // consumer only
+};
+
+// Background writer draining the ring into stdout
+class AsyncSink {
+public:
+    static AsyncSink& instance() {
+        static AsyncSink sink;
+        return sink;
+    }
+
+    // The drainer sleeps on cv_ once the ring is empty, advertising it in
+    // sleeping_; only the producer that clears the flag takes the lock to
+    // wake it, so a busy drainer costs submit() no syscall.
+    void submit(std::string msg) {
+        while (!ring_.try_push(msg)) flush();  // full: wait for the drainer to catch up
+        if (sleeping_.exchange(false, std::memory_order_acq_rel)) wake();
+    }
+
+    // Blocks until everything submitted so far has reached stdout. Call
+    // before writing to std::cout directly so the two never interleave.
+    void flush() {
+        const size_t target = ring_.pushed();
+        std::unique_lock<std::mutex> lk(mu_);
+        ++flushers_;
+        done_cv_.wait(lk, [&] { return written_.load() >= target; });
+        --flushers_;
+    }
+
+    ~AsyncSink() {
+        flush();
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        drainer_.join();
+    }
+
+private:
+    AsyncSink() : ring_(4096), drainer_([this] { drain_loop(); }) {}
+
+    void wake() {
+        std::lock_guard<std::mutex> lk(mu_);
+        cv_.notify_one();
+    }
+
+    void drain_loop() {
+        std::string msg, batch;
+        for (;;) {
+            size_t n = 0;
+            while (ring_.try_pop(msg)) { batch += msg; ++n; }
+            if (n > 0) {
+                std::cout.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                batch.clear();
+                written_.fetch_add(n);
+                if (flushers_.load() > 0) {
+                    std::lock_guard<std::mutex> lk(mu_);
+                    done_cv_.notify_all();
+                }
+                continue;
+            }
+            // Advertise the sleep before every re-check of the ring. Both
+            // sides exchange sleeping_, so a publish racing with the check
+            // is either ordered before it (and seen) or sees the flag.
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [&] {
+                sleeping_.exchange(true, std::memory_order_acq_rel);
+                return stop_ || ring_.ready();
+            });
+            sleeping_.store(false, std::memory_order_relaxed);
+            if (stop_ && !ring_.ready()) return;
+            // Step aside once so a producer mid-burst can fill a batch;
+            // otherwise every wake writes a single line
+            lk.unlock();
+            std::this_thread::yield();
+        }
+    }
+
+    Ring ring_;
+    std::atomic<size_t> written_{0};
+    std::atomic<bool> sleeping_{false};
+    std::atomic<int> flushers_{0};        // threads blocked in flush()
+    std::mutex mu_;
+    std::condition_variable cv_;          // drainer: ring has data or stop_
+    std::condition_variable done_cv_;     // flush(): written_ advanced
+    bool stop_ = false;
+    std::thread drainer_;
+};
+
+// One message under construction. Formatting starts from std::cout's
+// current flags and precision so numbers print exactly as before.
+class Line {
+public:
+    Line() : os_(stream()) {
+        os_.str(std::string());
+        os_.clear();
+        os_.flags(std::cout.flags());
+        os_.precision(std::cout.precision());
+    }
+    std::ostream& os() { return os_; }
+    void submit() { AsyncSink::instance().submit(os_.str()); }
+
+private:
+    static std::ostringstream& stream() {
+        thread_local std::ostringstream s;
+        return s;
+    }
+    std::ostringstream& os_;
+};
+
+static void flush() {
+    AsyncSink::instance().flush();
+}
+}
+
+// CG_LOG(INFO, REBALANCE, "[REB] " << date << ...): the stream expression is
+// only evaluated when the level/category is enabled
+#define CG_LOG(level, category, expr)                                       \
+    do {                                                                    \
+        if (::Log::enabled(::Log::level, ::Log::category)) {                \
+            ::Log::Line cg_log_line_;                                       \
+            cg_log_line_.os() << expr;                                      \
+            cg_log_line_.submit();                                          \
+        }                                                                   \
+    } while (0)
+
+// ============================================================
+// CSV tokenizer
+// ============================================================
+// Each file is read into one buffer and walked with string_view cursors;
+// numbers are parsed in place with std::from_chars, so a row costs no
+// heap allocation.
+static bool read_file(const std::string& path, std::string& buf) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    buf.clear();
+    if (std::fseek(f, 0, SEEK_END) == 0) {
+        long len = std::ftell(f);
+        if (len > 0) buf.reserve(static_cast<size_t>(len));
+        std::rewind(f);
+    }
+    char chunk[1 << 16];
+    size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.append(chunk, got);
+    std::fclose(f);
+    return true;
+}
+
+// Reads `len` bytes starting at `offset`; false if the file is shorter
+static bool read_range(const std::string& path, uint64_t offset, uint64_t len, std::string& buf) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    buf.assign(static_cast<size_t>(len), '\0');
+    bool ok = std::fseek(f, static_cast<long>(offset), SEEK_SET) == 0 &&
+              std::fread(buf.data(), 1, buf.size(), f) == buf.size();
+    std::fclose(f);
+    return ok;
+}
+
+// Splits the next line (without its '\n') off the front of `rest`
+static bool next_line(std::string_view& rest, std::string_view& line) {
+    if (rest.empty()) return false;
+    size_t nl = rest.find('\n');
+    if (nl == std::string_view::npos) {
+        line = rest;
+        rest = {};
+    } else {
+        line = rest.substr(0, nl);
+        rest.remove_prefix(nl + 1);
+    }
+    return true;
+}
+
+// Splits the next comma-separated field off the front of `line`;
+// empty once the line is used up
+static std::string_view next_field(std::string_view& line) {
+    size_t comma = line.find(',');
+    std::string_view field = line.substr(0, comma);
+    if (comma == std::string_view::npos) line = {};
+    else line.remove_prefix(comma + 1);
+    return field;
+}
+
+// Same acceptance as std::stod on a trimmed field: optional '+', longest
+// numeric prefix, false when nothing converts or the value is out of range
+static bool parse_double(std::string_view s, double& out) {
+    if (!s.empty() && s.front() == '+') {
+        s.remove_prefix(1);
+        if (!s.empty() && (s.front() == '+' || s.front() == '-')) return false;
+    }
+    auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+    return r.ec == std::errc();
+}
+
+// ============================================================
+// CSV loaders
+// ============================================================
+// Row parsers append to `out` without sorting; callers finish() the series.
+// They take the text after the header, so they also serve tail appends.
+static void parse_rows(std::string_view rest, FuturesSeries& out) {
+    std::string_view line;
+    while (next_line(rest, line)) {
+        if (line.empty()) continue;
+        std::string_view date_s = next_field(line);
+        std::string_view o_s = next_field(line);
+        std::string_view h_s = next_field(line);
+        std::string_view l_s = next_field(line);
+        std::string_view c_s = next_field(line);
+        std::string_view v_s = next_field(line);
+
+        int dk = parse_date(trim(date_s));
+        if (dk < 0) continue;
+
+        // HG (Copper) needs no conversion - data is in $/lb and the
+        // notional normalization formula handles the conversion
+        OHLCVBar bar;
+        if (!parse_double(trim(o_s), bar.open) ||
+            !parse_double(trim(h_s), bar.high) ||
+            !parse_double(trim(l_s), bar.low) ||
+            !parse_double(trim(c_s), bar.close))
+            continue;
+        if (v_s.empty()) bar.volume = 0.0;
+        else if (!parse_double(trim(v_s), bar.volume)) continue;
+
+        out.push(dk, bar);
+    }
+}
+
+static void parse_rows(std::string_view rest, TimeSeries& out) {
+    std::string_view line;
+    while (next_line(rest, line)) {
+        if (line.empty()) continue;
+        std::string_view date_s = trim(next_field(line));
+        std::string_view val_s = trim(next_field(line));
+        int dk = parse_date(date_s);
+        if (dk < 0 || val_s.empty() || val_s == "." || val_s == "NA") continue;
+        double v;
+        if (!parse_double(val_s, v)) continue;
+        out.push(dk, v);
+    }
+}
+
+template <class Series>
+static Series parse_csv(const std::string& path, std::ostream& warn) {
+    Series out;
+    std::string buf;
+    if (!read_file(path, buf)) {
+        warn << "[WARN] Cannot open: " << path << "\n";
+        return out;
+    }
+    std::string_view rest(buf), line;
+    next_line(rest, line); // skip header
+    parse_rows(rest, out);
+    out.finish();
+    return out;
+}
+
+static FuturesSeries parse_futures_csv(const std::string& path, std::ostream& warn = std::cerr) {
+    return parse_csv<FuturesSeries>(path, warn);
+}
+static TimeSeries parse_macro_csv(const std::string& path, std::ostream& warn = std::cerr) {
+    return parse_csv<TimeSeries>(path, warn);
+}
+
+// ============================================================
+// Binary column cache
+// ============================================================
+// Written once by `--build-cache` next to each CSV as <name>.csv.bin and
+// mmap'd on later runs instead of re-parsing the text.
+//
+// Layout (native endian, every section 8-byte aligned):
+//   Header
+//   int32_t day_key[rows]        (padded to a multiple of 8 bytes)
+//   double  col[ncols][rows]     futures: open, high, low, close, volume
+//                                macro:   value
+//
+// The header pins the source CSV by size, mtime and FNV-1a hash, i.e. the
+// byte offset up to which the CSV has been ingested and a checksum of that
+// prefix. A size match with a different mtime (e.g. a fresh checkout) is
+// re-validated by hashing the CSV. If the CSV has grown and its first
+// src_size bytes still hash to src_hash, only rows were appended: the loader
+// parses just the tail and rewrites the cache (see load_series). When the
+// cached prefix stopped mid-row, the tail is re-read from the start of that
+// row so the completed row replaces the partial one. Any other change
+// (revised rows, truncation) means a full reload, after which the cache is
+// rebuilt.
+namespace BinCache {
+
+static constexpr char     MAGIC[8] = {'C', 'G', 'B', 'C', 'A', 'C', 'H', 'E'};
+static constexpr uint32_t VERSION  = 1;
+static constexpr uint32_t KIND_FUTURES = 1;
+static constexpr uint32_t KIND_MACRO   = 2;
+
+struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t ncols;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t src_size;
+    int64_t  src_mtime;
+    uint64_t src_hash;
+};
+
+static std::string path_for(const std::string& csv_path) {
+    return csv_path + ".bin";
+}
+
+static size_t keys_bytes(uint64_t rows) {
+    return static_cast<size_t>((rows * sizeof(int32_t) + 7) & ~uint64_t(7));
+}
+
+static size_t file_bytes(uint64_t rows, uint32_t ncols) {
+    return sizeof(Header) + keys_bytes(rows) + static_cast<size_t>(rows * ncols * sizeof(double));
+}
+
+// Snapshot of the source CSV a cache covers
+struct Snapshot {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t hash = 0;
+};
+
+static constexpr uint64_t FNV_BASIS = 1469598103934665603ULL;
+
+// FNV-1a, continuing from `h` so a prefix hash can be extended by a tail
+static uint64_t fnv1a(uint64_t h, const char* p, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        h ^= static_cast<unsigned char>(p[k]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+struct SourceStat {
+    bool ok = false;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+static SourceStat stat_source(const std::string& path) {
+    SourceStat st;
+    struct stat sb;
+    if (::stat(path.c_str(), &sb) != 0) return st;
+    st.ok = true;
+    st.size = static_cast<uint64_t>(sb.st_size);
+    st.mtime = static_cast<int64_t>(sb.st_mtime);
+    return st;
+}
+
+// FNV-1a over the first `limit` bytes of a file; `row_start` receives the
+// offset just past the last '\n' hashed (0 if there is none)
+static bool hash_file(const std::string& path, uint64_t limit, uint64_t& out,
+                      uint64_t* row_start = nullptr) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    uint64_t h = FNV_BASIS;
+    char buf[1 << 16];
+    uint64_t left = limit;
+    if (row_start) *row_start = 0;
+    while (left > 0) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(left, sizeof(buf)));
+        size_t got = std::fread(buf, 1, want, f);
+        if (got == 0) break;
+        h = fnv1a(h, buf, got);
+        if (row_start) {
+            for (size_t k = got; k > 0; --k)
+                if (buf[k - 1] == '\n') { *row_start = limit - left + k; break; }
+        }
+        left -= got;
+    }
+    std::fclose(f);
+    out = h;
+    return left == 0;
+}
+
+static bool snapshot(const std::string& csv_path, Snapshot& snap) {
+    SourceStat src = stat_source(csv_path);
+    if (!src.ok) return false;
+    snap.size = src.size;
+    snap.mtime = src.mtime;
+    return hash_file(csv_path, src.size, snap.hash);
+}
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat sb;
+        if (::fstat(fd, &sb) == 0 && sb.st_size > 0) {
+            void* p = ::mmap(nullptr, static_cast<size_t>(sb.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data_ = static_cast<const char*>(p);
+                size_ = static_cast<size_t>(sb.st_size);
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Returns the mapped header if it is a well-formed cache of the given kind,
+// nullptr if missing or corrupt. Says nothing about freshness.
+static const Header* map_header(const MappedFile& m, uint32_t kind, uint32_t ncols) {
+    if (!m.data() || m.size() < sizeof(Header)) return nullptr;
+    const Header* h = reinterpret_cast<const Header*>(m.data());
+    if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION ||
+        h->kind != kind || h->ncols != ncols || m.size() != file_bytes(h->rows, h->ncols))
+        return nullptr;
+    return h;
+}
+
+// How the CSV relates to the snapshot a cache was built from
+enum class SourceState { Same, Appended, Changed };
+
+// On Appended, `from` is the offset the new tail is parsed from: src_size,
+// or the start of the cached prefix's last row if that row was unterminated
+static SourceState source_state(const Header& h, const std::string& csv_path, SourceStat& src,
+                                uint64_t& from) {
+    src = stat_source(csv_path);
+    if (!src.ok || src.size < h.src_size) return SourceState::Changed;
+    uint64_t hash = 0;
+    if (src.size == h.src_size) {
+        if (src.mtime == h.src_mtime) return SourceState::Same;
+        return (hash_file(csv_path, src.size, hash) && hash == h.src_hash)
+                   ? SourceState::Same : SourceState::Changed;
+    }
+    // Grown: a pure append only if the ingested prefix is byte-identical
+    uint64_t row_start = 0;
+    if (!hash_file(csv_path, h.src_size, hash, &row_start) || hash != h.src_hash)
+        return SourceState::Changed;
+    from = row_start;
+    return SourceState::Appended;
+}
+
+static bool write(const std::string& csv_path, uint32_t kind, const Snapshot& snap,
+                  const std::vector<int32_t>& keys,
+                  std::initializer_list<const std::vector<double>*> cols) {
+    Header h = {};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.kind = kind;
+    h.ncols = static_cast<uint32_t>(cols.size());
+    h.rows = keys.size();
+    h.src_size = snap.size;
+    h.src_mtime = snap.mtime;
+    h.src_hash = snap.hash;
+
+    // Write to a temp file and rename, so a reader never maps a half-written cache
+    const std::string out_path = path_for(csv_path);
+    const std::string tmp_path = out_path + ".tmp";
+    std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!f.is_open()) return false;
+    f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    f.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(int32_t));
+    static const char pad[8] = {};
+    f.write(pad, keys_bytes(h.rows) - keys.size() * sizeof(int32_t));
+    for (const auto* c : cols)
+        f.write(reinterpret_cast<const char*>(c->data()), c->size() * sizeof(double));
+    f.close();
+    if (!f) { std::remove(tmp_path.c_str()); return false; }
+    return std::rename(tmp_path.c_str(), out_path.c_str()) == 0;
+}
+
+// Per-series-type cache I/O, overloaded so load_series can stay generic
+static constexpr uint32_t kind_of(const FuturesSeries*) { return KIND_FUTURES; }
+static constexpr uint32_t kind_of(const TimeSeries*) { return KIND_MACRO; }
+static constexpr uint32_t ncols_of(const FuturesSeries*) { return 5; }
+static constexpr uint32_t ncols_of(const TimeSeries*) { return 1; }
+
+static bool write_series(const std::string& csv_path, const Snapshot& snap, const FuturesSeries& fs) {
+    return write(csv_path, KIND_FUTURES, snap, fs.keys,
+                 {&fs.open, &fs.high, &fs.low, &fs.close, &fs.volume});
+}
+
+static bool write_series(const std::string& csv_path, const Snapshot& snap, const TimeSeries& ts) {
+    return write(csv_path, KIND_MACRO, snap, ts.keys, {&ts.value});
+}
+
+static void read_series(const MappedFile& m, const Header& h, FuturesSeries& out) {
+    const size_t rows = static_cast<size_t>(h.rows);
+    const int32_t* keys = reinterpret_cast<const int32_t*>(m.data() + sizeof(Header));
+    const double* col = reinterpret_cast<const double*>(m.data() + sizeof(Header) + keys_bytes(rows));
+    out.keys.assign(keys, keys + rows);
+    out.open.assign(col, col + rows);
+    out.high.assign(col + rows, col + 2 * rows);
+    out.low.assign(col + 2 * rows, col + 3 * rows);
+    out.close.assign(col + 3 * rows, col + 4 * rows);
+    out.volume.assign(col + 4 * rows, col + 5 * rows);
+}
+
+static void read_series(const MappedFile& m, const Header& h, TimeSeries& out) {
+    const size_t rows = static_cast<size_t>(h.rows);
+    const int32_t* keys = reinterpret_cast<const int32_t*>(m.data() + sizeof(Header));
+    const double* col = reinterpret_cast<const double*>(m.data() + sizeof(Header) + keys_bytes(rows));
+    out.keys.assign(keys, keys + rows);
+    out.value.assign(col, col + rows);
+}
+
+static bool exists(const std::string& csv_path) {
+    struct stat sb;
+    return ::stat(path_for(csv_path).c_str(), &sb) == 0;
+}
+}
+
+// A tail re-read from the start of a partial cached row must complete that
+// row: if the fragment parsed, the finished row has to carry the same date,
+// so it wins the duplicate in finish(). A row that moved to another date or
+// no longer parses needs a full reparse.
+template <class Series>
+static bool completes_partial_row(std::string_view tail, size_t partial) {
+    Series before, after;
+    parse_rows(tail.substr(0, partial), before);
+    if (before.size() == 0) return true;
+    std::string_view rest = tail, line;
+    next_line(rest, line);
+    parse_rows(line, after);
+    return after.size() == 1 && after.keys[0] == before.keys[0];
+}
+
+// Cache-first loader: use <path>.bin when it still matches the CSV; if rows
+// were only appended since, parse just the new tail, append it to the cached
+// series and rewrite the cache; otherwise parse the CSV exactly as before
+// and, if a stale cache was there, rebuild it from the fresh parse.
+template <class Series>
+static Series load_series(const std::string& path, std::ostream& warn) {
+    Series out;
+    {
+        BinCache::MappedFile m(BinCache::path_for(path));
+        const BinCache::Header* h =
+            BinCache::map_header(m, BinCache::kind_of(&out), BinCache::ncols_of(&out));
+        BinCache::SourceStat src;
+        uint64_t from = 0;
+        const BinCache::SourceState state =
+            h ? BinCache::source_state(*h, path, src, from) : BinCache::SourceState::Changed;
+        if (state == BinCache::SourceState::Same) {
+            BinCache::read_series(m, *h, out);
+            // Content re-validated by hash after a touch/checkout: record the
+            // new mtime so later loads skip the hash again
+            if (src.mtime != h->src_mtime) {
+                BinCache::Snapshot snap;
+                snap.size = src.size;
+                snap.mtime = src.mtime;
+                snap.hash = h->src_hash;
+                if (!BinCache::write_series(path, snap, out))
+                    warn << "[WARN] Failed to update cache: " << BinCache::path_for(path) << "\n";
+            }
+            return out;
+        }
+        std::string tail;
+        const size_t partial = static_cast<size_t>(h ? h->src_size - from : 0);
+        if (state == BinCache::SourceState::Appended &&
+            read_range(path, from, src.size - from, tail) &&
+            completes_partial_row<Series>(tail, partial)) {
+            BinCache::read_series(m, *h, out);
+            const size_t cached_rows = out.size();
+            parse_rows(tail, out);
+            out.finish();
+            // Counted after finish(): a completed partial row replaces its cached row
+            const size_t new_rows = out.size() - cached_rows;
+
+            BinCache::Snapshot snap;
+            snap.size = src.size;
+            snap.mtime = src.mtime;
+            snap.hash = BinCache::fnv1a(h->src_hash, tail.data() + partial, tail.size() - partial);
+            if (!BinCache::write_series(path, snap, out))
+                warn << "[WARN] Failed to update cache: " << BinCache::path_for(path) << "\n";
+            warn << "[INFO] Appended " << new_rows << " new rows from " << path << "\n";
+            return out;
+        }
+    }
+    if (!BinCache::exists(path)) return parse_csv<Series>(path, warn);
+
+    // Revised or truncated CSV: reparse it in full and rebuild the cache, so
+    // later loads are back on the cached/tail-append path. Snapshot before
+    // parsing, as build_cache does.
+    warn << "[WARN] Stale cache rebuilt: " << BinCache::path_for(path) << "\n";
+    BinCache::Snapshot snap;
+    const bool have_snap = BinCache::snapshot(path, snap);
+    out = parse_csv<Series>(path, warn);
+    if (!have_snap || !BinCache::write_series(path, snap, out))
+        warn << "[WARN] Failed to update cache: " << BinCache::path_for(path) << "\n";
+    return out;
+}
+
+static FuturesSeries load_futures(const std::string& path, std::ostream& warn = std::cerr) {
+    return load_series<FuturesSeries>(path, warn);
+}
+
+static TimeSeries load_macro(const std::string& path, std::ostream& warn = std::cerr) {
+    return load_series<TimeSeries>(path, warn);
+}
+
+// One-time converter: parse every CSV under <data_dir>/futures and
+// <data_dir>/macro and write its .bin cache alongside it.
+static int build_cache(const std::string& data_dir) {
+    namespace fs = std::filesystem;
+    int written = 0, failed = 0;
+    for (const char* sub : {"futures", "macro"}) {
+        const fs::path dir = fs::path(data_dir) / sub;
+        std::error_code ec;
+        if (!fs::is_directory(dir, ec)) {
+            std::cerr << "[WARN] Not a directory: " << dir.string() << "\n";
+            continue;
+        }
+        std::vector<std::string> files;
+        for (const auto& e : fs::directory_iterator(dir, ec))
+            if (e.is_regular_file() && e.path().extension() == ".csv")
+                files.push_back(e.path().string());
+        std::sort(files.begin(), files.end());
+
+        const bool is_futures = std::string(sub) == "futures";
+        for (const auto& csv : files) {
+            // Snapshot before parsing: if the CSV grows in between, the extra
+            // rows are simply re-read as a tail on the next load
+            BinCache::Snapshot snap;
+            size_t rows = 0;
+            bool ok = BinCache::snapshot(csv, snap);
+            if (ok && is_futures) {
+                auto series = parse_futures_csv(csv);
+                rows = series.size();
+                ok = BinCache::write_series(csv, snap, series);
+            } else if (ok) {
+                auto ts = parse_macro_csv(csv);
+                rows = ts.size();
+                ok = BinCache::write_series(csv, snap, ts);
+            }
+            if (ok) {
+                ++written;
+                std::cout << "[INFO] Cached " << rows << " rows -> " << BinCache::path_for(csv) << "\n";
+            } else {
+                ++failed;
+                std::cerr << "[WARN] Failed to write cache for " << csv << "\n";
+            }
+        }
+    }
+    std::cout << "[INFO] Cache build complete: " << written << " written, " << failed << " failed\n";
+    return failed == 0 ? 0 : 1;
+}
+
+// ============================================================
+// Engine state snapshots
+// ============================================================
+// Binary image of the streaming engine's carried state, so a nightly job
+// can resume from yesterday's snapshot instead of replaying the history.
+//
+// Layout (native endian):
+//   Header
+//   payload[payload_bytes]       the state objects' save() output, in order
+//
+// Doubles are stored as raw bits, so a restored engine continues
+// bit-identically. The header pins the StrategyParams fingerprint the
+// state was built under (window lengths size every ring) and an FNV-1a
+// hash of the payload; a snapshot that fails either check is rejected.
+namespace StateIO {
+
+static constexpr char     MAGIC[8] = {'C', 'G', 'S', 'T', 'A', 'T', 'E', '1'};
+static constexpr uint32_t VERSION  = 2;   // 2: Welford cross moments
+
+struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    int64_t  day;            // day key of the last bar folded into the state
+    uint64_t params_hash;
+    uint64_t payload_bytes;
+    uint64_t payload_hash;
+};
+
+static constexpr size_t ANY = static_cast<size_t>(-1);
+
+class Writer {
+public:
+    template <class T>
+    void put(const T& v) {
+        static_assert(std::is_trivially_copyable_v<T>, "raw bytes only");
+        buf_.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+    template <class T>
+    void put_vec(const std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable_v<T>, "raw bytes only");
+        put<uint64_t>(v.size());
+        buf_.append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+    const std::string& bytes() const { return buf_; }
+
+private:
+    std::string buf_;
+};
+
+// Bounds-checked cursor over a payload. A short read or a length mismatch
+// fails the reader for good, so callers can check ok() once at the end.
+class Reader {
+public:
+    explicit Reader(std::string_view bytes) : rest_(bytes) {}
+
+    template <class T>
+    bool get(T& v) {
+        static_assert(std::is_trivially_copyable_v<T>, "raw bytes only");
+        if (!take(sizeof(T))) return false;
+        std::memcpy(&v, rest_.data() - sizeof(T), sizeof(T));
+        return true;
+    }
+    // `expect` pins the length of a fixed-size ring; ANY accepts any length
+    template <class T>
+    bool get_vec(std::vector<T>& v, size_t expect = ANY) {
+        uint64_t n = 0;
+        if (!get(n)) return false;
+        if ((expect != ANY && n != expect) || n > rest_.size() / sizeof(T)) return fail();
+        v.resize(static_cast<size_t>(n));
+        if (!take(v.size() * sizeof(T))) return false;
+        std::memcpy(v.data(), rest_.data() - v.size() * sizeof(T), v.size() * sizeof(T));
+        return true;
+    }
+    bool fail() { ok_ = false; return false; }
+    bool ok() const { return ok_; }
+    bool done() const { return ok_ && rest_.empty(); }
+
+private:
+    bool take(size_t n) {
+        if (!ok_ || rest_.size() < n) return fail();
+        rest_.remove_prefix(n);
+        return true;
+    }
+
+    std::string_view rest_;
+    bool ok_ = true;
+};
+
+static bool write(const std::string& path, int day, uint64_t params_hash, const std::string& payload) {
+    Header h = {};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.day = day;
+    h.params_hash = params_hash;
+    h.payload_bytes = payload.size();
+    h.payload_hash = BinCache::fnv1a(BinCache::FNV_BASIS, payload.data(), payload.size());
+
+    // Temp file and rename, as for the column cache: a crash mid-write
+    // leaves yesterday's snapshot in place
+    const std::string tmp_path = path + ".tmp";
+    std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!f.is_open()) return false;
+    f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    f.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    f.close();
+    if (!f) { std::remove(tmp_path.c_str()); return false; }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+// Reads and validates a snapshot; on success `payload` views into `buf`
+static bool read(const std::string& path, uint64_t params_hash, std::string& buf,
+                 Header& h, std::string_view& payload) {
+    if (!read_file(path, buf)) {
+        std::cerr << "[ERROR] Cannot open state snapshot: " << path << "\n";
+        return false;
+    }
+    if (buf.size() < sizeof(Header)) {
+        std::cerr << "[ERROR] Truncated state snapshot: " << path << "\n";
+        return false;
+    }
+    std::memcpy(&h, buf.data(), sizeof(Header));
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION) {
+        std::cerr << "[ERROR] Not a v" << VERSION << " state snapshot: " << path << "\n";
+        return false;
+    }
+    if (h.params_hash != params_hash) {
+        std::cerr << "[ERROR] State snapshot was built with different parameters: " << path << "\n";
+        return false;
+    }
+    payload = std::string_view(buf).substr(sizeof(Header));
+    if (payload.size() != h.payload_bytes ||
+        BinCache::fnv1a(BinCache::FNV_BASIS, payload.data(), payload.size()) != h.payload_hash) {
+        std::cerr << "[ERROR] State snapshot checksum mismatch: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+}  // namespace StateIO
+
+// ============================================================
+// Aligned daily panel
+// ============================================================
+// Dense, calendar-aligned view of the input series. Every column holds the
+// as-of (forward-filled) value for each calendar day, NaN before the
+// series' first observation, plus a mask of the days it actually printed.
+struct PanelColumn {
+    std::vector<double> value;
+    std::vector<uint8_t> fresh;  // 1 where the series has an observation on that day
+};
+
+struct Panel {
+    std::vector<int> dates;
+    std::unordered_map<std::string, PanelColumn> fut_close;  // by futures symbol
+    std::unordered_map<std::string, PanelColumn> macro;      // by macro file name
+    std::vector<double> missing;                             // all-NaN, for series that failed to load
+
+    const std::vector<double>& close(const std::string& sym) const {
+        auto it = fut_close.find(sym);
+        return it != fut_close.end() ? it->second.value : missing;
+    }
+};
+
+// Calendar = union of bar dates in [start_dk, end_dk], produced by a k-way
+// merge over the (already sorted) futures series
+static std::vector<int> merge_calendar(const std::vector<const DateIndex*>& srcs,
+                                       int start_dk, int end_dk) {
+    using Cursor = std::pair<const int*, const int*>;  // next key, end of range
+    auto later = [](const Cursor& a, const Cursor& b) { return *a.first > *b.first; };
+    std::vector<Cursor> heap;
+    for (const DateIndex* src : srcs) {
+        const int* first = src->keys.data() + src->lower_bound(start_dk);
+        const int* last = src->keys.data() + src->upper_bound(end_dk);
+        if (first != last) heap.emplace_back(first, last);
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    std::vector<int> dates;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        Cursor& c = heap.back();
+        if (dates.empty() || dates.back() != *c.first) dates.push_back(*c.first);
+        if (++c.first != c.second)
+            std::push_heap(heap.begin(), heap.end(), later);
+        else
+            heap.pop_back();
+    }
+    return dates;
+}
+
+// As-of merge join of one sorted series against the calendar: a single
+// forward cursor, so each column costs one sequential pass
+static PanelColumn asof_join(const std::vector<int>& dates, const DateIndex& series,
+                             const std::vector<double>& values) {
+    const size_t n = dates.size();
+    PanelColumn col;
+    col.value.assign(n, std::numeric_limits<double>::quiet_NaN());
+    col.fresh.assign(n, 0);
+    AsofCursor cur(series);
+    for (size_t i = 0; i < n; ++i) {
+        size_t r = cur.seek(dates[i]);
+        if (r == DateIndex::npos) continue;
+        col.value[i] = values[r];
+        col.fresh[i] = (series.keys[r] == dates[i]);
+    }
+    return col;
+}
+
+// ============================================================
+// Vector kernels
+// ============================================================
+// Element-wise indicator arithmetic with NaN masking, in scalar, SSE2, AVX2
+// and AVX-512 flavours. The widest one the CPU supports is picked once at
+// startup (CG_SIMD=scalar|sse2|avx2|avx512 forces a narrower one). Every
+// variant performs the same IEEE operations in the same order per element
+// and never fuses a multiply-add, so results are bit-identical to scalar.
+// Transcendentals (log) stay scalar for the same reason, and the rolling
+// moments are running recurrences over time, so only their z-score step
+// has a kernel.
+namespace Kernels {
+
+enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+static const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::SSE2:   return "sse2";
+        case Isa::AVX2:   return "avx2";
+        case Isa::AVX512: return "avx512";
+        default:          return "scalar";
+    }
+}
+
+// out = a - b where both are defined, NaN otherwise
+static void sub_scalar(const double* a, const double* b, double* out, size_t n) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (!std::isnan(a[i]) && !std::isnan(b[i])) ? a[i] - b[i] : nan;
+}
+
+// out = (a * sa) / (b * sb) where a is defined and b > 0, NaN otherwise
+static void ratio_scalar(const double* a, double sa, const double* b, double sb,
+                         double* out, size_t n) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (!std::isnan(a[i]) && b[i] > 0.0) ? (a[i] * sa) / (b[i] * sb) : nan;
+}
+
+// out = (a / b - 1) * scale where a is defined and b > 0, NaN otherwise
+static void growth_scalar(const double* a, const double* b, double scale,
+                          double* out, size_t n) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (!std::isnan(a[i]) && b[i] > 0.0) ? ((a[i] / b[i]) - 1.0) * scale : nan;
+}
+
+// out = (v - m) / s where m is defined and s > 0, NaN otherwise
+static void zscore_scalar(const double* v, const double* m, const double* s,
+                          double* out, size_t n) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (!std::isnan(m[i]) && s[i] > 0.0) ? (v[i] - m[i]) / s[i] : nan;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CG_HAVE_X86_KERNELS 1
+
+__attribute__((target("sse2")))
+static void sub_sse2(const double* a, const double* b, double* out, size_t n) {
+    const __m128d nan = _mm_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d va = _mm_loadu_pd(a + i), vb = _mm_loadu_pd(b + i);
+        __m128d ok = _mm_and_pd(_mm_cmpord_pd(va, va), _mm_cmpord_pd(vb, vb));
+        __m128d r = _mm_sub_pd(va, vb);
+        _mm_storeu_pd(out + i, _mm_or_pd(_mm_and_pd(ok, r), _mm_andnot_pd(ok, nan)));
+    }
+    sub_scalar(a + i, b + i, out + i, n - i);
 }
 
-static std::string date_from_int(int day_key) {
-    time_t ts = static_cast<time_t>(day_key) * 86400;
-    std::tm* t = std::gmtime(&ts);
-    char buf[16];
-    std::strftime(buf, sizeof(buf), "%Y-%m-%d", t);
-    return std::string(buf);
+__attribute__((target("sse2")))
+static void ratio_sse2(const double* a, double sa, const double* b, double sb,
+                       double* out, size_t n) {
+    const __m128d nan = _mm_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m128d zero = _mm_setzero_pd(), vsa = _mm_set1_pd(sa), vsb = _mm_set1_pd(sb);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d va = _mm_loadu_pd(a + i), vb = _mm_loadu_pd(b + i);
+        __m128d ok = _mm_and_pd(_mm_cmpord_pd(va, va), _mm_cmpgt_pd(vb, zero));
+        __m128d r = _mm_div_pd(_mm_mul_pd(va, vsa), _mm_mul_pd(vb, vsb));
+        _mm_storeu_pd(out + i, _mm_or_pd(_mm_and_pd(ok, r), _mm_andnot_pd(ok, nan)));
+    }
+    ratio_scalar(a + i, sa, b + i, sb, out + i, n - i);
 }
 
-// ============================================================
-// Data types
-// ============================================================
-struct OHLCVBar {
-    double open = 0.0, high = 0.0, low = 0.0, close = 0.0, volume = 0.0;
-};
+__attribute__((target("sse2")))
+static void growth_sse2(const double* a, const double* b, double scale, double* out, size_t n) {
+    const __m128d nan = _mm_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0), vs = _mm_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d va = _mm_loadu_pd(a + i), vb = _mm_loadu_pd(b + i);
+        __m128d ok = _mm_and_pd(_mm_cmpord_pd(va, va), _mm_cmpgt_pd(vb, zero));
+        __m128d r = _mm_mul_pd(_mm_sub_pd(_mm_div_pd(va, vb), one), vs);
+        _mm_storeu_pd(out + i, _mm_or_pd(_mm_and_pd(ok, r), _mm_andnot_pd(ok, nan)));
+    }
+    growth_scalar(a + i, b + i, scale, out + i, n - i);
+}
 
-using TimeSeries = std::map<int, double>;
-using FuturesSeries = std::map<int, OHLCVBar>;
+__attribute__((target("sse2")))
+static void zscore_sse2(const double* v, const double* m, const double* s, double* out, size_t n) {
+    const __m128d nan = _mm_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m128d zero = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d vv = _mm_loadu_pd(v + i), vm = _mm_loadu_pd(m + i), vs = _mm_loadu_pd(s + i);
+        __m128d ok = _mm_and_pd(_mm_cmpord_pd(vm, vm), _mm_cmpgt_pd(vs, zero));
+        __m128d r = _mm_div_pd(_mm_sub_pd(vv, vm), vs);
+        _mm_storeu_pd(out + i, _mm_or_pd(_mm_and_pd(ok, r), _mm_andnot_pd(ok, nan)));
+    }
+    zscore_scalar(v + i, m + i, s + i, out + i, n - i);
+}
 
-// ============================================================
-// CSV loaders
-// ============================================================
-static FuturesSeries load_futures(const std::string& path) {
-    FuturesSeries out;
-    std::ifstream f(path);
-    if (!f.is_open()) {
-        std::cerr << "[WARN] Cannot open: " << path << "\n";
-        return out;
+__attribute__((target("avx2")))
+static void sub_avx2(const double* a, const double* b, double* out, size_t n) {
+    const __m256d nan = _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d va = _mm256_loadu_pd(a + i), vb = _mm256_loadu_pd(b + i);
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(va, va, _CMP_ORD_Q), _mm256_cmp_pd(vb, vb, _CMP_ORD_Q));
+        _mm256_storeu_pd(out + i, _mm256_blendv_pd(nan, _mm256_sub_pd(va, vb), ok));
     }
-    std::string line;
-    std::getline(f, line); // skip header
-    while (std::getline(f, line)) {
-        if (line.empty()) continue;
-        std::istringstream ss(line);
-        std::string date_s, o_s, h_s, l_s, c_s, v_s;
-        std::getline(ss, date_s, ',');
-        std::getline(ss, o_s, ',');
-        std::getline(ss, h_s, ',');
-        std::getline(ss, l_s, ',');
-        std::getline(ss, c_s, ',');
-        std::getline(ss, v_s, ',');
+    sub_scalar(a + i, b + i, out + i, n - i);
+}
 
-        int dk = parse_date(trim(date_s));
-        if (dk < 0) continue;
+__attribute__((target("avx2")))
+static void ratio_avx2(const double* a, double sa, const double* b, double sb,
+                       double* out, size_t n) {
+    const __m256d nan = _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m256d zero = _mm256_setzero_pd(), vsa = _mm256_set1_pd(sa), vsb = _mm256_set1_pd(sb);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d va = _mm256_loadu_pd(a + i), vb = _mm256_loadu_pd(b + i);
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(va, va, _CMP_ORD_Q), _mm256_cmp_pd(vb, zero, _CMP_GT_OQ));
+        __m256d r = _mm256_div_pd(_mm256_mul_pd(va, vsa), _mm256_mul_pd(vb, vsb));
+        _mm256_storeu_pd(out + i, _mm256_blendv_pd(nan, r, ok));
+    }
+    ratio_scalar(a + i, sa, b + i, sb, out + i, n - i);
+}
 
-        OHLCVBar bar;
-        try {
-            double raw_open = std::stod(trim(o_s));
-            double raw_high = std::stod(trim(h_s));
-            double raw_low = std::stod(trim(l_s));
-            double raw_close = std::stod(trim(c_s));
-
-            // Check if this is HG (Copper) - no conversion needed, data is in $/lb
-            // The notional normalization formula handles the conversion
-            bar.open = raw_open;
-            bar.high = raw_high;
-            bar.low = raw_low;
-            bar.close = raw_close;
-
-            bar.volume = v_s.empty() ? 0.0 : std::stod(trim(v_s));
-        } catch (...) { continue; }
-        out[dk] = bar;
+__attribute__((target("avx2")))
+static void growth_avx2(const double* a, const double* b, double scale, double* out, size_t n) {
+    const __m256d nan = _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0), vs = _mm256_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d va = _mm256_loadu_pd(a + i), vb = _mm256_loadu_pd(b + i);
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(va, va, _CMP_ORD_Q), _mm256_cmp_pd(vb, zero, _CMP_GT_OQ));
+        __m256d r = _mm256_mul_pd(_mm256_sub_pd(_mm256_div_pd(va, vb), one), vs);
+        _mm256_storeu_pd(out + i, _mm256_blendv_pd(nan, r, ok));
     }
-    return out;
+    growth_scalar(a + i, b + i, scale, out + i, n - i);
 }
-// Helper function to check if all positions are zero
-static bool all_positions_zero(const std::unordered_map<std::string, double>& positions) {
-    for (const auto& [sym, qty] : positions) {
-        if (qty != 0.0) return false;
+
+__attribute__((target("avx2")))
+static void zscore_avx2(const double* v, const double* m, const double* s, double* out, size_t n) {
+    const __m256d nan = _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d vv = _mm256_loadu_pd(v + i), vm = _mm256_loadu_pd(m + i), vs = _mm256_loadu_pd(s + i);
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(vm, vm, _CMP_ORD_Q), _mm256_cmp_pd(vs, zero, _CMP_GT_OQ));
+        __m256d r = _mm256_div_pd(_mm256_sub_pd(vv, vm), vs);
+        _mm256_storeu_pd(out + i, _mm256_blendv_pd(nan, r, ok));
     }
-    return true;
+    zscore_scalar(v + i, m + i, s + i, out + i, n - i);
 }
 
-static TimeSeries load_macro(const std::string& path) {
-    TimeSeries out;
-    std::ifstream f(path);
-    if (!f.is_open()) {
-        std::cerr << "[WARN] Cannot open: " << path << "\n";
-        return out;
+__attribute__((target("avx512f")))
+static void sub_avx512(const double* a, const double* b, double* out, size_t n) {
+    const __m512d nan = _mm512_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d va = _mm512_loadu_pd(a + i), vb = _mm512_loadu_pd(b + i);
+        __mmask8 ok = _mm512_cmp_pd_mask(va, va, _CMP_ORD_Q) & _mm512_cmp_pd_mask(vb, vb, _CMP_ORD_Q);
+        _mm512_storeu_pd(out + i, _mm512_mask_sub_pd(nan, ok, va, vb));
     }
-    std::string line;
-    std::getline(f, line); // skip header
-    while (std::getline(f, line)) {
-        if (line.empty()) continue;
-        std::istringstream ss(line);
-        std::string date_s, val_s;
-        std::getline(ss, date_s, ',');
-        std::getline(ss, val_s, ',');
-        date_s = trim(date_s);
-        val_s = trim(val_s);
-        int dk = parse_date(date_s);
-        if (dk < 0 || val_s.empty() || val_s == "." || val_s == "NA") continue;
-        try { out[dk] = std::stod(val_s); } catch (...) { continue; }
+    sub_scalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void ratio_avx512(const double* a, double sa, const double* b, double sb,
+                         double* out, size_t n) {
+    const __m512d nan = _mm512_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m512d zero = _mm512_setzero_pd(), vsa = _mm512_set1_pd(sa), vsb = _mm512_set1_pd(sb);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d va = _mm512_loadu_pd(a + i), vb = _mm512_loadu_pd(b + i);
+        __mmask8 ok = _mm512_cmp_pd_mask(va, va, _CMP_ORD_Q) & _mm512_cmp_pd_mask(vb, zero, _CMP_GT_OQ);
+        __m512d r = _mm512_div_pd(_mm512_mul_pd(va, vsa), _mm512_mul_pd(vb, vsb));
+        _mm512_storeu_pd(out + i, _mm512_mask_blend_pd(ok, nan, r));
+    }
+    ratio_scalar(a + i, sa, b + i, sb, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void growth_avx512(const double* a, const double* b, double scale, double* out, size_t n) {
+    const __m512d nan = _mm512_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m512d zero = _mm512_setzero_pd(), one = _mm512_set1_pd(1.0), vs = _mm512_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d va = _mm512_loadu_pd(a + i), vb = _mm512_loadu_pd(b + i);
+        __mmask8 ok = _mm512_cmp_pd_mask(va, va, _CMP_ORD_Q) & _mm512_cmp_pd_mask(vb, zero, _CMP_GT_OQ);
+        __m512d r = _mm512_mul_pd(_mm512_sub_pd(_mm512_div_pd(va, vb), one), vs);
+        _mm512_storeu_pd(out + i, _mm512_mask_blend_pd(ok, nan, r));
+    }
+    growth_scalar(a + i, b + i, scale, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void zscore_avx512(const double* v, const double* m, const double* s, double* out, size_t n) {
+    const __m512d nan = _mm512_set1_pd(std::numeric_limits<double>::quiet_NaN());
+    const __m512d zero = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d vv = _mm512_loadu_pd(v + i), vm = _mm512_loadu_pd(m + i), vs = _mm512_loadu_pd(s + i);
+        __mmask8 ok = _mm512_cmp_pd_mask(vm, vm, _CMP_ORD_Q) & _mm512_cmp_pd_mask(vs, zero, _CMP_GT_OQ);
+        __m512d r = _mm512_div_pd(_mm512_sub_pd(vv, vm), vs);
+        _mm512_storeu_pd(out + i, _mm512_mask_blend_pd(ok, nan, r));
     }
+    zscore_scalar(v + i, m + i, s + i, out + i, n - i);
+}
+#endif
+
+struct Table {
+    Isa isa = Isa::Scalar;
+    void (*sub)(const double*, const double*, double*, size_t) = sub_scalar;
+    void (*ratio)(const double*, double, const double*, double, double*, size_t) = ratio_scalar;
+    void (*growth)(const double*, const double*, double, double*, size_t) = growth_scalar;
+    void (*zscore)(const double*, const double*, const double*, double*, size_t) = zscore_scalar;
+};
+
+static Table select() {
+    Table t;
+#ifdef CG_HAVE_X86_KERNELS
+    Isa best = Isa::Scalar;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))    best = Isa::SSE2;
+    if (__builtin_cpu_supports("avx2"))    best = Isa::AVX2;
+    if (__builtin_cpu_supports("avx512f")) best = Isa::AVX512;
+    if (const char* force = std::getenv("CG_SIMD")) {
+        for (Isa isa : {Isa::Scalar, Isa::SSE2, Isa::AVX2, Isa::AVX512})
+            if (std::strcmp(force, isa_name(isa)) == 0 && isa < best) best = isa;
+    }
+    t.isa = best;
+    switch (best) {
+        case Isa::AVX512:
+            t.sub = sub_avx512; t.ratio = ratio_avx512; t.growth = growth_avx512; t.zscore = zscore_avx512;
+            break;
+        case Isa::AVX2:
+            t.sub = sub_avx2; t.ratio = ratio_avx2; t.growth = growth_avx2; t.zscore = zscore_avx2;
+            break;
+        case Isa::SSE2:
+            t.sub = sub_sse2; t.ratio = ratio_sse2; t.growth = growth_sse2; t.zscore = zscore_sse2;
+            break;
+        default: break;
+    }
+#endif
+    return t;
+}
+
+static const Table& table() {
+    static const Table t = select();
+    return t;
+}
+
+// Vector-level entry points
+static std::vector<double> sub(const std::vector<double>& a, const std::vector<double>& b) {
+    std::vector<double> out(a.size());
+    table().sub(a.data(), b.data(), out.data(), a.size());
+    return out;
+}
+
+static std::vector<double> ratio(const std::vector<double>& a, double sa,
+                                 const std::vector<double>& b, double sb) {
+    std::vector<double> out(a.size());
+    table().ratio(a.data(), sa, b.data(), sb, out.data(), a.size());
     return out;
 }
 
+}  // namespace Kernels
+
 // ============================================================
-// Forward-fill
+// Lag operators
 // ============================================================
-static double ffill(const TimeSeries& ts, int dk) {
-    auto it = ts.upper_bound(dk);
-    if (it == ts.begin()) return std::numeric_limits<double>::quiet_NaN();
-    return (--it)->second;
+// Column-at-a-time x[i] op x[i - lag] on calendar-aligned series, built on
+// the vector kernels. Every result has the input's length, NaN in the first
+// `lag` slots and wherever x[i] or x[i - lag] is missing; the ratio-based
+// operators also require x[i - lag] > 0.
+namespace Lag {
+
+using Column = std::vector<double>;
+
+// Runs kernel(x + lag, x, out + lag, n - lag) with the NaN prefix in place
+template <class Kernel>
+static Column lagged(const Column& x, int lag, Kernel kernel) {
+    Column out(x.size(), std::numeric_limits<double>::quiet_NaN());
+    if (lag >= 0 && static_cast<size_t>(lag) < x.size())
+        kernel(x.data() + lag, x.data(), out.data() + lag, x.size() - lag);
+    return out;
+}
+
+// x[i] - x[i - lag]
+static Column diff(const Column& x, int lag) {
+    return lagged(x, lag, [](const double* a, const double* b, double* out, size_t n) {
+        Kernels::table().sub(a, b, out, n);
+    });
+}
+
+// (x[i] / x[i - lag] - 1) * scale
+static Column pct_change(const Column& x, int lag, double scale = 1.0) {
+    return lagged(x, lag, [scale](const double* a, const double* b, double* out, size_t n) {
+        Kernels::table().growth(a, b, scale, out, n);
+    });
+}
+
+// x[i] / x[i - lag]
+static Column ratio(const Column& x, int lag) {
+    return lagged(x, lag, [](const double* a, const double* b, double* out, size_t n) {
+        Kernels::table().ratio(a, 1.0, b, 1.0, out, n);
+    });
+}
+
+// log(x[i] / x[i - lag]). The quotients are formed with the vector kernel,
+// then logged in one batch pass over the column. The log itself stays
+// std::log: vector libm variants are a few ulp off and would change results.
+static Column log_return(const Column& x, int lag = 1) {
+    Column out = ratio(x, lag);
+    for (double& v : out)
+        if (!std::isnan(v)) v = std::log(v);
+    return out;
+}
+
+// Multi-series / multi-lag forms
+static std::vector<Column> log_returns(std::initializer_list<const Column*> xs, int lag = 1) {
+    std::vector<Column> out;
+    out.reserve(xs.size());
+    for (const Column* x : xs) out.push_back(log_return(*x, lag));
+    return out;
 }
 
-static double ffill_fut_close(const FuturesSeries& ts, int dk) {
-    auto it = ts.upper_bound(dk);
-    if (it == ts.begin()) return std::numeric_limits<double>::quiet_NaN();
-    return (--it)->second.close;
+static std::vector<Column> pct_changes(const Column& x, std::initializer_list<int> lags,
+                                       double scale = 1.0) {
+    std::vector<Column> out;
+    out.reserve(lags.size());
+    for (int lag : lags) out.push_back(pct_change(x, lag, scale));
+    return out;
 }
 
+}  // namespace Lag
+
 // ============================================================
 // Rolling statistics
 // ============================================================
+// Neumaier-compensated running sum
+struct CompensatedSum {
+    double sum = 0.0, comp = 0.0;
+
+    void add(double x) {
+        double t = sum + x;
+        if (std::abs(sum) >= std::abs(x)) comp += (sum - t) + x;
+        else                              comp += (x - t) + sum;
+        sum = t;
+    }
+    double value() const { return sum + comp; }
+};
+
+// Fixed-window mean / population std over a stream, O(1) per push. The sum
+// is compensated and the second moment is updated with the sliding Welford
+// recurrence; both are recomputed exactly (same order as the naive loop)
+// every `window` pushes so rounding cannot drift. Non-finite values are
+// counted instead of summed, which reproduces the naive results: NaN (or
+// both infinities) in the window gives a NaN mean, one-signed infinity gives
+// that infinity, and std is NaN while any non-finite value is in the window.
+class RollingWindow {
+public:
+    explicit RollingWindow(int window)
+        : window_(window), ring_(static_cast<size_t>(std::max(window, 1)), 0.0) {}
+
+    void push(double x) {
+        const size_t w = ring_.size();
+        const size_t slot = pushed_ % w;
+        const bool evict = pushed_ >= w;
+        const double y = ring_[slot];
+        ring_[slot] = x;
+        ++pushed_;
+
+        if (evict) drop(y);
+        take(x);
+        if (evict && std::isfinite(x) && std::isfinite(y) && nonfinite() == 0 && !dirty_) {
+            double old_mean = mean_;
+            mean_ = sum_.value() / window_;
+            m2_ += (x - y) * (x - mean_ + y - old_mean);
+        } else {
+            dirty_ = true;
+        }
+        if (full() && (dirty_ || ++since_sync_ >= w) && nonfinite() == 0) resync();
+    }
+
+    bool full() const { return pushed_ >= ring_.size(); }
+
+    double mean() const {
+        if (nan_ > 0 || (pos_inf_ > 0 && neg_inf_ > 0)) return std::numeric_limits<double>::quiet_NaN();
+        if (pos_inf_ > 0) return std::numeric_limits<double>::infinity();
+        if (neg_inf_ > 0) return -std::numeric_limits<double>::infinity();
+        return sum_.value() / window_;
+    }
+
+    double stddev() const {
+        if (nonfinite() > 0) return std::numeric_limits<double>::quiet_NaN();
+        return std::sqrt(std::max(m2_, 0.0) / window_);
+    }
+
+    // Snapshot I/O; load() requires a window of the same length
+    void save(StateIO::Writer& w) const {
+        w.put_vec(ring_);
+        w.put<uint64_t>(pushed_);
+        w.put<uint64_t>(since_sync_);
+        w.put(sum_);
+        w.put(mean_); w.put(m2_); w.put(dirty_);
+        w.put(nan_); w.put(pos_inf_); w.put(neg_inf_);
+    }
+    bool load(StateIO::Reader& r) {
+        uint64_t pushed = 0, since_sync = 0;
+        bool ok = r.get_vec(ring_, ring_.size()) && r.get(pushed) && r.get(since_sync)
+               && r.get(sum_) && r.get(mean_) && r.get(m2_) && r.get(dirty_)
+               && r.get(nan_) && r.get(pos_inf_) && r.get(neg_inf_);
+        pushed_ = static_cast<size_t>(pushed);
+        since_sync_ = static_cast<size_t>(since_sync);
+        return ok;
+    }
+
+private:
+    int nonfinite() const { return nan_ + pos_inf_ + neg_inf_; }
+
+    void take(double x) {
+        if (std::isnan(x)) ++nan_;
+        else if (std::isinf(x)) ++(x > 0 ? pos_inf_ : neg_inf_);
+        else sum_.add(x);
+    }
+    void drop(double y) {
+        if (std::isnan(y)) --nan_;
+        else if (std::isinf(y)) --(y > 0 ? pos_inf_ : neg_inf_);
+        else sum_.add(-y);
+    }
+
+    // Exact two-pass recompute over the window, oldest value first
+    void resync() {
+        const size_t w = ring_.size();
+        double sum = 0.0;
+        for (size_t k = 0; k < w; ++k) sum += ring_[(pushed_ + k) % w];
+        sum_ = CompensatedSum{sum, 0.0};
+        mean_ = sum / window_;
+        double var = 0.0;
+        for (size_t k = 0; k < w; ++k) {
+            double d = ring_[(pushed_ + k) % w] - mean_;
+            var += d * d;
+        }
+        m2_ = var;
+        dirty_ = false;
+        since_sync_ = 0;
+    }
+
+    int window_;
+    std::vector<double> ring_;
+    size_t pushed_ = 0;
+    size_t since_sync_ = 0;
+    CompensatedSum sum_;
+    double mean_ = 0.0, m2_ = 0.0;
+    bool dirty_ = true;
+    int nan_ = 0, pos_inf_ = 0, neg_inf_ = 0;
+};
+
 static std::vector<double> rolling_mean(const std::vector<double>& v, int window) {
     std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
-    for (int i = window - 1; i < (int)v.size(); ++i) {
-        double sum = 0.0;
-        for (int j = i - window + 1; j <= i; ++j) sum += v[j];
-        out[i] = sum / window;
+    RollingWindow rw(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        rw.push(v[i]);
+        if (rw.full()) out[i] = rw.mean();
     }
     return out;
 }
 
 static std::vector<double> rolling_std(const std::vector<double>& v, int window) {
     std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
-    for (int i = window - 1; i < (int)v.size(); ++i) {
-        double mean = 0.0;
-        for (int j = i - window + 1; j <= i; ++j) mean += v[j];
-        mean /= window;
-        double var = 0.0;
-        for (int j = i - window + 1; j <= i; ++j) var += (v[j] - mean) * (v[j] - mean);
-        out[i] = std::sqrt(var / window);
+    RollingWindow rw(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        rw.push(v[i]);
+        if (rw.full()) out[i] = rw.stddev();
     }
     return out;
 }
 
+// One RollingWindow pass for both moments, then the vector z-score kernel
 static std::vector<double> rolling_zscore(const std::vector<double>& v, int window) {
-    auto sma = rolling_mean(v, window);
-    auto std_ = rolling_std(v, window);
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> mean(v.size(), nan), sd(v.size(), nan);
+    RollingWindow rw(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        rw.push(v[i]);
+        if (!rw.full()) continue;
+        mean[i] = rw.mean();
+        sd[i] = rw.stddev();
+    }
+    std::vector<double> out(v.size());
+    Kernels::table().zscore(v.data(), mean.data(), sd.data(), out.data(), v.size());
+    return out;
+}
+
+// Rolling mean and population std of one series for a set of window
+// lengths, indexed by window. Built by rolling_multi.
+struct WindowPanel {
+    std::vector<int> windows;                   // sorted, unique
+    std::vector<std::vector<double>> mean, stddev;  // [window index][day]
+
+    int index_of(int w) const {
+        auto it = std::lower_bound(windows.begin(), windows.end(), w);
+        return (it != windows.end() && *it == w) ? static_cast<int>(it - windows.begin()) : -1;
+    }
+};
+
+// All requested windows of one series in a single pass: each element is
+// read once and pushed into every window's RollingWindow, so the series
+// streams through the cache once however many windows a grid asks for.
+// Each window keeps its own accumulator, so every column is bit-identical
+// to rolling_mean / rolling_std and a sweep config reads exactly the
+// numbers a standalone run() computes.
+static WindowPanel rolling_multi(const std::vector<double>& v, std::vector<int> windows) {
+    windows.erase(std::remove_if(windows.begin(), windows.end(), [](int w) { return w < 1; }),
+                  windows.end());
+    std::sort(windows.begin(), windows.end());
+    windows.erase(std::unique(windows.begin(), windows.end()), windows.end());
+
+    const size_t n = v.size();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    WindowPanel out;
+    out.windows = windows;
+    out.mean.assign(windows.size(), std::vector<double>(n, nan));
+    out.stddev.assign(windows.size(), std::vector<double>(n, nan));
+    std::vector<RollingWindow> rws;
+    rws.reserve(windows.size());
+    for (int w : windows) rws.emplace_back(w);
+    for (size_t i = 0; i < n; ++i) {
+        const double x = v[i];
+        for (size_t k = 0; k < rws.size(); ++k) {
+            RollingWindow& rw = rws[k];
+            rw.push(x);
+            if (!rw.full()) continue;
+            out.mean[k][i] = rw.mean();
+            out.stddev[k][i] = rw.stddev();
+        }
+    }
+    return out;
+}
+
+// z = (v - mean) / std where both moments exist and std > 0
+static std::vector<double> zscore_from(const std::vector<double>& v, const std::vector<double>& mean,
+                                       const std::vector<double>& sd) {
+    std::vector<double> out(v.size());
+    Kernels::table().zscore(v.data(), mean.data(), sd.data(), out.data(), v.size());
+    return out;
+}
+
+// Window panels for every series whose rolling stats a sweep varies, keyed
+// by series name. Built once and shared read-only by all sweep workers.
+struct WindowPanelSet {
+    std::unordered_map<std::string, WindowPanel> series;
+
+    const std::vector<double>* mean(const std::string& key, int w) const {
+        return lookup(key, w, &WindowPanel::mean);
+    }
+    const std::vector<double>* stddev(const std::string& key, int w) const {
+        return lookup(key, w, &WindowPanel::stddev);
+    }
+
+private:
+    const std::vector<double>* lookup(const std::string& key, int w,
+                                      std::vector<std::vector<double>> WindowPanel::*col) const {
+        auto it = series.find(key);
+        if (it == series.end()) return nullptr;
+        int k = it->second.index_of(w);
+        return k < 0 ? nullptr : &(it->second.*col)[k];
+    }
+};
+
+// Sliding window of the last w values with O(log w) rank and quantile
+// queries. The raw ring remembers arrival order for eviction; the non-NaN
+// values also sit in an order-statistic treap whose nodes are indexed by
+// ring slot, so a push is one erase and one insert, and nothing is
+// allocated after construction. Equal values are ordered by slot.
+class SlidingRank {
+public:
+    explicit SlidingRank(int window)
+        : ring_(static_cast<size_t>(std::max(window, 1))), nodes_(ring_.size()) {}
+
+    // NaN occupies a slot in the window but is never ranked
+    void push(double x) {
+        const size_t w = ring_.size();
+        const int slot = static_cast<int>(pushed_ % w);
+        if (pushed_ >= w && !std::isnan(ring_[slot])) root_ = erase(root_, slot);
+        ring_[slot] = x;
+        if (!std::isnan(x)) add(slot, pushed_);
+        ++pushed_;
+    }
+
+    bool full() const { return pushed_ >= ring_.size(); }
+    size_t count() const { return size(root_); }
+
+    // Number of ranked values strictly below x (0 for NaN)
+    size_t rank(double x) const {
+        size_t r = 0;
+        for (int t = root_; t != NIL;) {
+            if (nodes_[t].key < x) {
+                r += size(nodes_[t].left) + 1;
+                t = nodes_[t].right;
+            } else {
+                t = nodes_[t].left;
+            }
+        }
+        return r;
+    }
+
+    // floor(q * count)-th order statistic, clamped to the largest value
+    double quantile(double q) const {
+        const size_t n = count();
+        if (n == 0) return std::numeric_limits<double>::quiet_NaN();
+        size_t k = std::min(static_cast<size_t>(q * n), n - 1);
+        int t = root_;
+        for (;;) {
+            const size_t left = size(nodes_[t].left);
+            if (k < left) {
+                t = nodes_[t].left;
+            } else if (k == left) {
+                return nodes_[t].key;
+            } else {
+                k -= left + 1;
+                t = nodes_[t].right;
+            }
+        }
+    }
+
+    // The ranked values are written in order, as the sorted-array form of
+    // this window did, so the snapshot layout is unchanged; load() rebuilds
+    // the tree from the ring and checks it against them
+    void save(StateIO::Writer& w) const {
+        std::vector<double> sorted;
+        sorted.reserve(count());
+        in_order(root_, sorted);
+        w.put_vec(ring_);
+        w.put_vec(sorted);
+        w.put<uint64_t>(pushed_);
+    }
+    bool load(StateIO::Reader& r) {
+        uint64_t pushed = 0;
+        std::vector<double> sorted;
+        bool ok = r.get_vec(ring_, ring_.size()) && r.get_vec(sorted) && r.get(pushed);
+        pushed_ = static_cast<size_t>(pushed);
+        root_ = NIL;
+        if (!ok) return false;
+        const size_t filled = std::min(pushed_, ring_.size());
+        for (size_t k = 0; k < filled; ++k)
+            if (!std::isnan(ring_[k])) add(static_cast<int>(k), k);
+        std::vector<double> rebuilt;
+        rebuilt.reserve(count());
+        in_order(root_, rebuilt);
+        if (rebuilt.size() != sorted.size() ||
+            !std::equal(rebuilt.begin(), rebuilt.end(), sorted.begin()))
+            return r.fail();
+        return true;
+    }
+
+private:
+    static constexpr int NIL = -1;
+
+    struct Node {
+        double key = 0.0;
+        uint64_t prio = 0;
+        int left = NIL, right = NIL;
+        uint32_t size = 0;
+    };
+
+    uint32_t size(int t) const { return t == NIL ? 0 : nodes_[t].size; }
+    void update(int t) { nodes_[t].size = size(nodes_[t].left) + size(nodes_[t].right) + 1; }
+
+    // Strict order on nodes: by value, ties by slot
+    bool before(int a, int b) const {
+        return nodes_[a].key < nodes_[b].key || (nodes_[a].key == nodes_[b].key && a < b);
+    }
+
+    void add(int slot, size_t seq) {
+        // splitmix64 of the push count: a fixed, well-spread heap priority
+        uint64_t z = static_cast<uint64_t>(seq) + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        Node& n = nodes_[slot];
+        n.key = ring_[slot];
+        n.prio = z ^ (z >> 31);
+        n.left = n.right = NIL;
+        n.size = 1;
+        root_ = insert(root_, slot);
+    }
+
+    // Splits `t` into the nodes before `n` and the rest
+    void split(int t, int n, int& l, int& r) {
+        if (t == NIL) { l = r = NIL; return; }
+        if (before(t, n)) {
+            split(nodes_[t].right, n, nodes_[t].right, r);
+            l = t;
+        } else {
+            split(nodes_[t].left, n, l, nodes_[t].left);
+            r = t;
+        }
+        update(t);
+    }
+
+    int merge(int l, int r) {
+        if (l == NIL) return r;
+        if (r == NIL) return l;
+        if (nodes_[l].prio > nodes_[r].prio) {
+            nodes_[l].right = merge(nodes_[l].right, r);
+            update(l);
+            return l;
+        }
+        nodes_[r].left = merge(l, nodes_[r].left);
+        update(r);
+        return r;
+    }
+
+    int insert(int t, int n) {
+        if (t == NIL) return n;
+        if (nodes_[n].prio > nodes_[t].prio) {
+            split(t, n, nodes_[n].left, nodes_[n].right);
+            update(n);
+            return n;
+        }
+        if (before(n, t)) nodes_[t].left = insert(nodes_[t].left, n);
+        else              nodes_[t].right = insert(nodes_[t].right, n);
+        update(t);
+        return t;
+    }
+
+    int erase(int t, int n) {
+        if (t == n) return merge(nodes_[t].left, nodes_[t].right);
+        if (before(n, t)) nodes_[t].left = erase(nodes_[t].left, n);
+        else              nodes_[t].right = erase(nodes_[t].right, n);
+        update(t);
+        return t;
+    }
+
+    void in_order(int t, std::vector<double>& out) const {
+        if (t == NIL) return;
+        in_order(nodes_[t].left, out);
+        out.push_back(nodes_[t].key);
+        in_order(nodes_[t].right, out);
+    }
+
+    std::vector<double> ring_;
+    std::vector<Node> nodes_;   // one per ring slot
+    int root_ = NIL;
+    size_t pushed_ = 0;
+};
+
+// Percentile rank of each value within its trailing window (NaNs skipped);
+// NaN until the window is full or while it holds no values
+static std::vector<double> rolling_percentile_rank(const std::vector<double>& v, int window) {
     std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
-    for (int i = 0; i < (int)v.size(); ++i) {
-        if (!std::isnan(sma[i]) && !std::isnan(std_[i]) && std_[i] > 0.0)
-            out[i] = (v[i] - sma[i]) / std_[i];
+    SlidingRank sr(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        sr.push(v[i]);
+        if (sr.full() && sr.count() > 0)
+            out[i] = static_cast<double>(sr.rank(v[i])) / sr.count();
     }
     return out;
 }
 
-// ATR calculation
-static std::vector<double> compute_atr(const std::vector<int>& dates,
-                                       const FuturesSeries& fut, int window = 20) {
+// Trailing-window q-quantile (NaNs skipped), NaN until the window is full
+static std::vector<double> rolling_quantile(const std::vector<double>& v, int window, double q) {
+    std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
+    SlidingRank sr(window);
+    for (size_t i = 0; i < v.size(); ++i) {
+        sr.push(v[i]);
+        if (sr.full()) out[i] = sr.quantile(q);
+    }
+    return out;
+}
+
+// True range per calendar day; NaN where the instrument has no bar that day
+// or no earlier bar to take the previous close from
+static std::vector<double> true_range(const std::vector<int>& dates, const FuturesSeries& fut) {
     std::vector<double> tr(dates.size(), std::numeric_limits<double>::quiet_NaN());
+    AsofCursor cur(fut);
     for (int i = 1; i < (int)dates.size(); ++i) {
-        auto it = fut.find(dates[i]);
-        if (it == fut.end()) continue;
-        auto it_prev = fut.lower_bound(dates[i]);
-        if (it_prev == fut.begin()) continue;
-        --it_prev;
-        double prev_close = it_prev->second.close;
-        double hi = it->second.high;
-        double lo = it->second.low;
+        size_t r = cur.seek(dates[i]);
+        if (r == DateIndex::npos || fut.keys[r] != dates[i] || r == 0) continue;
+        double prev_close = fut.close[r - 1];
+        double hi = fut.high[r];
+        double lo = fut.low[r];
         tr[i] = std::max({hi - lo,
                           std::abs(hi - prev_close),
                           std::abs(lo - prev_close)});
     }
-    return rolling_mean(tr, window);
+    return tr;
 }
 
-// Average pairwise correlation
-static double avg_pairwise_corr(
-    const std::vector<std::vector<double>>& ret_series,
-    int i, int window)
-{
-    int n = static_cast<int>(ret_series.size());
-    if (n < 2 || i < window - 1) return 0.0;
-
-    double sum_corr = 0.0;
-    int pairs = 0;
-    for (int a = 0; a < n; ++a) {
-        for (int b = a + 1; b < n; ++b) {
-            double ma = 0.0, mb = 0.0;
-            int valid = 0;
-            for (int k = i - window + 1; k <= i; ++k) {
-                double ra = ret_series[a][k], rb = ret_series[b][k];
-                if (!std::isnan(ra) && !std::isnan(rb)) {
-                    ma += ra; mb += rb; ++valid;
+// ATR calculation
+static std::vector<double> compute_atr(const std::vector<int>& dates,
+                                       const FuturesSeries& fut, int window = 20) {
+    return rolling_mean(true_range(dates, fut), window);
+}
+
+// Mean of the defined values in each trailing window, NaN if there are none.
+// Summed in window order so it matches a per-day loop bit for bit; meant for
+// short windows like the ATR stop's.
+static std::vector<double> rolling_nanmean(const std::vector<double>& v, int window) {
+    std::vector<double> out(v.size(), std::numeric_limits<double>::quiet_NaN());
+    for (int i = window - 1; i < (int)v.size(); ++i) {
+        double sum = 0.0;
+        int count = 0;
+        for (int k = i - window + 1; k <= i; ++k) {
+            if (std::isnan(v[k])) continue;
+            sum += v[k];
+            ++count;
+        }
+        if (count > 0) out[i] = sum / count;
+    }
+    return out;
+}
+
+// Rolling cross-moments of N series over a fixed window with pairwise NaN
+// masking: pair (a, b) only accumulates the days on which both are present,
+// as the per-day correlation loop did. Each push adds the new day and evicts
+// the oldest in O(N^2) with the sliding Welford / co-moment recurrence; the
+// moments are rebuilt two-pass from the ring every `window` pushes so
+// add/evict rounding cannot accumulate. Infinite values are counted instead
+// of accumulated, as RollingWindow does: a pair is undefined (NaN) while one
+// is in its window, which is what the naive loop's inf - inf gave.
+class RollingCrossMoments {
+public:
+    RollingCrossMoments(int nseries, int window)
+        : n_(nseries), w_(static_cast<size_t>(std::max(window, 1))),
+          ring_(w_ * nseries), pairs_(static_cast<size_t>(nseries) * nseries) {}
+
+    // One day's values, row[0..N); NaN marks a missing observation
+    void push(const double* row) {
+        const size_t slot = pushed_ % w_;
+        double* dst = &ring_[slot * n_];
+        if (pushed_ >= w_) accumulate(dst, false);
+        std::copy(row, row + n_, dst);
+        accumulate(dst, true);
+        ++pushed_;
+        if (++since_sync_ >= w_) resync();
+    }
+
+    bool full() const { return pushed_ >= w_; }
+
+    // Pairwise correlation over jointly present days; NaN with fewer than
+    // two such days, an infinite value in the window or zero variance on
+    // either side
+    double correlation(int a, int b) const {
+        const Moments& m = pairs_[index(a, b)];
+        if (m.n < 2 || m.inf > 0) return std::numeric_limits<double>::quiet_NaN();
+        const double denom = std::sqrt(std::max(m.m2a, 0.0) * std::max(m.m2b, 0.0));
+        return denom > 0.0 ? m.cab / denom : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // Full N x N correlation matrix, row-major
+    std::vector<double> correlation_matrix() const {
+        std::vector<double> out(static_cast<size_t>(n_) * n_);
+        for (int a = 0; a < n_; ++a)
+            for (int b = 0; b < n_; ++b)
+                out[static_cast<size_t>(a) * n_ + b] = correlation(a, b);
+        return out;
+    }
+
+    // Mean of the defined off-diagonal correlations, 0 if there are none
+    double avg_offdiag_corr() const {
+        double sum = 0.0;
+        int pairs = 0;
+        for (int a = 0; a < n_; ++a)
+            for (int b = a + 1; b < n_; ++b) {
+                double c = correlation(a, b);
+                if (!std::isnan(c)) { sum += c; ++pairs; }
+            }
+        return pairs > 0 ? sum / pairs : 0.0;
+    }
+
+    void save(StateIO::Writer& w) const {
+        w.put_vec(ring_);
+        w.put_vec(pairs_);
+        w.put<uint64_t>(pushed_);
+        w.put<uint64_t>(since_sync_);
+    }
+    bool load(StateIO::Reader& r) {
+        uint64_t pushed = 0, since_sync = 0;
+        bool ok = r.get_vec(ring_, ring_.size()) && r.get_vec(pairs_, pairs_.size())
+               && r.get(pushed) && r.get(since_sync);
+        pushed_ = static_cast<size_t>(pushed);
+        since_sync_ = static_cast<size_t>(since_sync);
+        return ok;
+    }
+
+private:
+    // Moments of the jointly present finite days of pair (a, b), a <= b:
+    // means, centred second moments and co-moment; `inf` counts the days
+    // held back because either value is infinite
+    struct Moments {
+        int n = 0, inf = 0;
+        double ma = 0.0, mb = 0.0, m2a = 0.0, m2b = 0.0, cab = 0.0;
+    };
+
+    // Upper triangle only (a <= b)
+    size_t index(int a, int b) const {
+        if (a > b) std::swap(a, b);
+        return static_cast<size_t>(a) * n_ + b;
+    }
+
+    // Adds (or evicts) one day
+    void accumulate(const double* row, bool add) {
+        for (int a = 0; a < n_; ++a) {
+            const double ra = row[a];
+            if (std::isnan(ra)) continue;
+            for (int b = a; b < n_; ++b) {
+                const double rb = row[b];
+                if (std::isnan(rb)) continue;
+                Moments& m = pairs_[static_cast<size_t>(a) * n_ + b];
+                if (std::isinf(ra) || std::isinf(rb)) {
+                    m.inf += add ? 1 : -1;
+                    continue;
                 }
+                // Deviations from the old means, updated means, then the
+                // moments against the new means (add and evict are mirrors)
+                if (!add && m.n == 1) {
+                    m = Moments{0, m.inf};
+                    continue;
+                }
+                const double da = ra - m.ma, db = rb - m.mb;
+                const int sign = add ? 1 : -1;
+                m.n += sign;
+                m.ma += sign * da / m.n;
+                m.mb += sign * db / m.n;
+                m.m2a += sign * da * (ra - m.ma);
+                m.m2b += sign * db * (rb - m.mb);
+                m.cab += sign * da * (rb - m.mb);
             }
-            if (valid < 2) continue;
-            ma /= valid; mb /= valid;
-            double cov = 0.0, va = 0.0, vb = 0.0;
-            for (int k = i - window + 1; k <= i; ++k) {
-                double ra = ret_series[a][k], rb = ret_series[b][k];
-                if (!std::isnan(ra) && !std::isnan(rb)) {
-                    double da = ra - ma, db = rb - mb;
-                    cov += da * db; va += da * da; vb += db * db;
+        }
+    }
+
+    // Exact two-pass rebuild over the window, oldest day first
+    void resync() {
+        const size_t rows = std::min(pushed_, w_);
+        const size_t first = pushed_ >= w_ ? pushed_ % w_ : 0;
+        auto row = [&](size_t k) { return &ring_[((first + k) % w_) * n_]; };
+        for (int a = 0; a < n_; ++a) {
+            for (int b = a; b < n_; ++b) {
+                Moments m;
+                double sa = 0.0, sb = 0.0;
+                for (size_t k = 0; k < rows; ++k) {
+                    const double ra = row(k)[a], rb = row(k)[b];
+                    if (std::isnan(ra) || std::isnan(rb)) continue;
+                    if (std::isinf(ra) || std::isinf(rb)) { ++m.inf; continue; }
+                    sa += ra; sb += rb; ++m.n;
                 }
+                if (m.n > 0) {
+                    m.ma = sa / m.n;
+                    m.mb = sb / m.n;
+                    for (size_t k = 0; k < rows; ++k) {
+                        const double ra = row(k)[a], rb = row(k)[b];
+                        if (!std::isfinite(ra) || !std::isfinite(rb)) continue;
+                        const double da = ra - m.ma, db = rb - m.mb;
+                        m.m2a += da * da; m.m2b += db * db; m.cab += da * db;
+                    }
+                }
+                pairs_[static_cast<size_t>(a) * n_ + b] = m;
             }
-            double denom = std::sqrt(va * vb);
-            if (denom > 0.0) { sum_corr += cov / denom; ++pairs; }
         }
+        since_sync_ = 0;
+    }
+
+    int n_;
+    size_t w_;
+    std::vector<double> ring_;     // w rows of N values
+    std::vector<Moments> pairs_;   // N x N, upper triangle used
+    size_t pushed_ = 0;
+    size_t since_sync_ = 0;
+};
+
+// Average pairwise correlation of the return series over a trailing window,
+// one column for the whole history (0 before the window fills)
+static std::vector<double> rolling_avg_pairwise_corr(
+    const std::vector<std::vector<double>>& ret_series, int window)
+{
+    const int nser = static_cast<int>(ret_series.size());
+    const size_t len = ret_series.empty() ? 0 : ret_series[0].size();
+    std::vector<double> out(len, 0.0);
+    if (nser < 2) return out;
+
+    RollingCrossMoments rcm(nser, window);
+    std::vector<double> row(nser);
+    for (size_t i = 0; i < len; ++i) {
+        for (int a = 0; a < nser; ++a) row[a] = ret_series[a][i];
+        rcm.push(row.data());
+        if (rcm.full()) out[i] = rcm.avg_offdiag_corr();
     }
-    return (pairs > 0) ? sum_corr / pairs : 0.0;
+    return out;
 }
 
 // ============================================================
@@ -271,6 +2532,45 @@ static const char* regime_str(Regime r) {
     }
 }
 
+// ============================================================
+// Instrument registry - dense ids for the traded futures
+// ============================================================
+namespace Inst {
+enum Id : int { HG, GC, CL, SI, ZN, UB, JY, MES, MNQ, COUNT };
+
+static constexpr Id ALL[COUNT] = {HG, GC, CL, SI, ZN, UB, JY, MES, MNQ};
+static constexpr const char* SYMBOLS[COUNT] = {
+    "HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"
+};
+
+static const char* symbol(Id id) { return SYMBOLS[id]; }
+
+// Point values ($ per 1.0 price move)
+static constexpr double POINT_VALUE[COUNT] = {
+    250.0,    // HG: 1 cent = $250
+    100.0,    // GC: $1 = $100
+    1000.0,   // CL: $1 = $1000
+    5000.0,   // SI: $1 = $5000
+    1000.0,   // ZN: 1 point = $1000
+    1000.0,   // UB: 1 point = $1000
+    12.50,    // 6J: 1 pip = $12.50
+    5.0,      // MES: 1 point = $5
+    2.0       // MNQ: 1 point = $2
+};
+}
+using InstrumentId = Inst::Id;
+
+// Per-instrument state indexed by InstrumentId (positions, prices, targets)
+template <typename T>
+using PerInstrument = std::array<T, Inst::COUNT>;
+
+static bool all_positions_zero(const PerInstrument<double>& positions) {
+    for (double qty : positions) {
+        if (qty != 0.0) return false;
+    }
+    return true;
+}
+
 // ============================================================
 // Contract specifications - EXACT from document
 // ============================================================
@@ -285,30 +2585,26 @@ struct Spec {
     double slippage_ticks; // estimated slippage in ticks (one way) — doc lines 449-458
 };
 
-// Exact values from doc lines 449-458
+// Exact values from doc lines 449-458, in InstrumentId order
 // UB not listed in doc cost table — spread/slippage set to 0
-static const std::unordered_map<std::string, Spec> specs = {
-    {"HG",  {6000.0,  110000.0, 0.0005,   12.50,  2.50,  0.5, 0.5}},
-    {"GC",  {11000.0, 200000.0, 0.10,     10.00,  2.50,  1.0, 0.5}},
-    {"CL",  {7000.0,   75000.0, 0.01,     10.00,  2.50,  1.0, 1.0}},
-    {"MES", {1500.0,   25000.0, 0.25,      1.25,  0.50,  1.0, 0.5}},
-    {"MNQ", {2000.0,   40000.0, 0.25,      0.50,  0.50,  1.0, 0.5}},
-    {"ZN",  {2500.0,  110000.0, 0.015625, 15.625, 1.50,  0.5, 0.5}},
-    {"UB",  {9000.0,  130000.0, 0.03125,  31.25,  2.50,  0.0, 0.0}}, // not in doc cost table
-    {"6J",  {4000.0,   80000.0, 0.000001, 12.50,  2.50,  1.0, 0.5}},
-    {"SI",  {10000.0, 150000.0, 0.005,    25.00,  2.50,  1.0, 1.0}},
+static constexpr Spec specs[Inst::COUNT] = {
+    {6000.0,  110000.0, 0.0005,   12.50,  2.50,  0.5, 0.5},  // HG
+    {11000.0, 200000.0, 0.10,     10.00,  2.50,  1.0, 0.5},  // GC
+    {7000.0,   75000.0, 0.01,     10.00,  2.50,  1.0, 1.0},  // CL
+    {10000.0, 150000.0, 0.005,    25.00,  2.50,  1.0, 1.0},  // SI
+    {2500.0,  110000.0, 0.015625, 15.625, 1.50,  0.5, 0.5},  // ZN
+    {9000.0,  130000.0, 0.03125,  31.25,  2.50,  0.0, 0.0},  // UB (not in doc cost table)
+    {4000.0,   80000.0, 0.000001, 12.50,  2.50,  1.0, 0.5},  // 6J
+    {1500.0,   25000.0, 0.25,      1.25,  0.50,  1.0, 0.5},  // MES
+    {2000.0,   40000.0, 0.25,      0.50,  0.50,  1.0, 0.5},  // MNQ
 };
 
-static Spec get(const std::string& sym) {
-    auto it = specs.find(sym);
-    if (it != specs.end()) return it->second;
-    return {5000.0, 100000.0, 0.01, 10.0, 2.50, 1.0, 0.5};
-}
+static const Spec& get(InstrumentId id) { return specs[id]; }
 
 // doc Phase 6 line 749: "spread + slippage + commission per contract"
 // round-trip cost = commission + spread (paid once on entry) + 2 * slippage (entry + exit)
-static double total_cost_rt(const std::string& sym) {
-    const Spec s = get(sym);
+static double total_cost_rt(InstrumentId id) {
+    const Spec& s = get(id);
     return s.commission_rt
          + (s.spread_ticks * s.tick_value)
          + (2.0 * s.slippage_ticks * s.tick_value);
@@ -316,37 +2612,53 @@ static double total_cost_rt(const std::string& sym) {
 }
 
 // doc: "Base Notional Allocation — allocation weights by asset class"
-static const std::unordered_map<std::string, double> ASSET_WEIGHTS = {
-    {"equity_index", 0.30},  // MES, MNQ
-    {"commodities",  0.35},  // CL, HG, GC, SI
-    {"fixed_income", 0.25},  // ZN, UB
-    {"fx",           0.10},  // 6J
+enum class AssetClass : int { EQUITY_INDEX, COMMODITIES, FIXED_INCOME, FX };
+
+static constexpr double ASSET_WEIGHTS[] = {
+    0.30,  // equity_index: MES, MNQ
+    0.35,  // commodities:  CL, HG, GC, SI
+    0.25,  // fixed_income: ZN, UB
+    0.10,  // fx:           6J
 };
 
-static std::string asset_class(const std::string& sym) {
-    if (sym == "MES" || sym == "MNQ") return "equity_index";
-    if (sym == "CL" || sym == "HG" || sym == "GC" || sym == "SI") return "commodities";
-    if (sym == "ZN" || sym == "UB") return "fixed_income";
-    if (sym == "6J") return "fx";
-    return "commodities";
+static AssetClass asset_class(InstrumentId id) {
+    switch (id) {
+        case Inst::MES: case Inst::MNQ: return AssetClass::EQUITY_INDEX;
+        case Inst::ZN:  case Inst::UB:  return AssetClass::FIXED_INCOME;
+        case Inst::JY:                  return AssetClass::FX;
+        default:                        return AssetClass::COMMODITIES;
+    }
+}
+
+static double asset_weight(InstrumentId id) {
+    return ASSET_WEIGHTS[static_cast<int>(asset_class(id))];
 }
 
 // doc: "Position Limits" table (line 615-618)
 // Only equity index and commodity have per-instrument limits
-// Fixed income (ZN, UB) and FX (6J) have no per-instrument caps in document
-static const std::unordered_map<std::string, double> SINGLE_NOTIONAL_LIMIT = {
-    {"MES", 0.20}, {"MNQ", 0.20},
-    {"HG",  0.15}, {"GC",  0.15}, {"CL",  0.15}, {"SI",  0.15}
-    // ZN, UB, 6J intentionally omitted - no per-instrument limits in doc
+// Fixed income (ZN, UB) and FX (6J) have no per-instrument caps in document (NaN)
+static constexpr double NO_LIMIT = std::numeric_limits<double>::quiet_NaN();
+static constexpr double SINGLE_NOTIONAL_LIMIT[Inst::COUNT] = {
+    0.15, 0.15, 0.15, 0.15,      // HG, GC, CL, SI
+    NO_LIMIT, NO_LIMIT, NO_LIMIT, // ZN, UB, 6J - no per-instrument limits in doc
+    0.20, 0.20                   // MES, MNQ
 };
 static constexpr double MAX_TOTAL_EQUITY_NOTIONAL    = 0.35;
 static constexpr double MAX_TOTAL_COMMODITY_NOTIONAL = 0.40;
 
+// Initial margin tied up by a book, in Inst order
+static double margin_held(const PerInstrument<double>& positions) {
+    double total = 0.0;
+    for (InstrumentId id : Inst::ALL)
+        total += std::abs(positions[id]) * ContractSpec::get(id).margin;
+    return total;
+}
+
 // ============================================================
 // Per-day output
 // ============================================================
 struct DailySignal {
-    std::string date;
+    int day = 0;                         // day key (days since 1970-01-01)
     double cu_gold_ratio = 0.0;
     double roc_10 = 0.0, roc_20 = 0.0, roc_60 = 0.0;
     double signal_ma = 0.0, ratio_zscore = 0.0, signal_z = 0.0, composite = 0.0;
@@ -365,7 +2677,8 @@ struct DailySignal {
     bool corr_spike_active = false;
 
     double size_multiplier = 1.0;
-    std::unordered_map<std::string, double> target_contracts;
+    PerInstrument<double> target_contracts{};
+    PerInstrument<bool> dropped{};       // legs cleared without a trade (fixed mode, NEUTRAL)
     double portfolio_equity = 0.0;
     double margin_utilization = 0.0;
     bool drawdown_warning = false;
@@ -374,6 +2687,177 @@ struct DailySignal {
     double spx_price = 0.0;              // doc line 603: needed for SPX correlation metric
 };
 
+// ============================================================
+// Columnar signal store
+// ============================================================
+// Struct-of-arrays backing for the per-day output: one column per scalar
+// DailySignal field, a days x instruments contract matrix (row-major) and
+// the enums plus boolean flags packed into one 16-bit word per day.
+class SignalTable {
+public:
+    // state_ layout: tilt [0,2) regime [2,5) dxy_trend [5,7) dxy_filter [7,9) flags [9,14)
+    enum Flag : uint16_t {
+        SKIP_GOLD_SHORT  = 1u << 9,
+        BOJ_INTERVENTION = 1u << 10,
+        CORR_SPIKE       = 1u << 11,
+        DD_WARNING       = 1u << 12,
+        DD_STOP          = 1u << 13,
+    };
+
+    // Read-only view of one day; cheap to copy, valid while the table is
+    class Row {
+    public:
+        Row(const SignalTable& t, size_t r) : t_(&t), r_(r) {}
+
+        int         day() const  { return t_->day_[r_]; }
+        std::string date() const { return date_from_int(day()); }
+
+        double cu_gold_ratio() const     { return t_->cu_gold_ratio_[r_]; }
+        double roc_10() const            { return t_->roc_10_[r_]; }
+        double roc_20() const            { return t_->roc_20_[r_]; }
+        double roc_60() const            { return t_->roc_60_[r_]; }
+        double signal_ma() const         { return t_->signal_ma_[r_]; }
+        double ratio_zscore() const      { return t_->ratio_zscore_[r_]; }
+        double signal_z() const          { return t_->signal_z_[r_]; }
+        double composite() const         { return t_->composite_[r_]; }
+        double growth_signal() const     { return t_->growth_signal_[r_]; }
+        double inflation_signal() const  { return t_->inflation_signal_[r_]; }
+        double liquidity_score() const   { return t_->liquidity_score_[r_]; }
+        double real_rate_10y() const     { return t_->real_rate_10y_[r_]; }
+        double real_rate_chg_20d() const { return t_->real_rate_chg_20d_[r_]; }
+        double real_rate_zscore() const  { return t_->real_rate_zscore_[r_]; }
+        double dxy_momentum() const      { return t_->dxy_momentum_[r_]; }
+        double china_adjustment() const  { return t_->china_adjustment_[r_]; }
+        double size_multiplier() const   { return t_->size_multiplier_[r_]; }
+        double portfolio_equity() const  { return t_->portfolio_equity_[r_]; }
+        double margin_utilization() const { return t_->margin_utilization_[r_]; }
+        double spx_price() const         { return t_->spx_price_[r_]; }
+        int signal_flips_trailing_year() const { return t_->signal_flips_[r_]; }
+
+        MacroTilt macro_tilt() const  { return t_->macro_tilt(r_); }
+        Regime    regime() const      { return t_->regime(r_); }
+        DXYTrend  dxy_trend() const   { return static_cast<DXYTrend>((t_->state_[r_] >> 5) & 0x3); }
+        DXYFilter dxy_filter() const  { return static_cast<DXYFilter>((t_->state_[r_] >> 7) & 0x3); }
+        bool skip_gold_short() const   { return t_->state_[r_] & SKIP_GOLD_SHORT; }
+        bool boj_intervention() const  { return t_->state_[r_] & BOJ_INTERVENTION; }
+        bool corr_spike_active() const { return t_->state_[r_] & CORR_SPIKE; }
+        bool drawdown_warning() const  { return t_->state_[r_] & DD_WARNING; }
+        bool drawdown_stop() const     { return t_->state_[r_] & DD_STOP; }
+
+        double target_contracts(InstrumentId id) const { return t_->contracts_row(r_)[id]; }
+        bool dropped(InstrumentId id) const { return t_->dropped_[r_] >> id & 1u; }
+
+    private:
+        const SignalTable* t_;
+        size_t r_;
+    };
+
+    size_t size() const  { return day_.size(); }
+    bool   empty() const { return day_.empty(); }
+    Row operator[](size_t r) const { return Row(*this, r); }
+    Row back() const { return Row(*this, size() - 1); }
+
+    void reserve(size_t n) {
+        for (auto* c : double_columns()) c->reserve(n);
+        day_.reserve(n);
+        signal_flips_.reserve(n);
+        state_.reserve(n);
+        dropped_.reserve(n);
+        contracts_.reserve(n * Inst::COUNT);
+    }
+
+    void append(const DailySignal& s) {
+        append_signal(s);
+        uint16_t dropped = 0;
+        for (InstrumentId id : Inst::ALL)
+            if (s.dropped[id]) dropped |= static_cast<uint16_t>(1u << id);
+        append_book(s.size_multiplier, s.target_contracts, s.portfolio_equity,
+                    s.margin_utilization, s.drawdown_warning, s.drawdown_stop, dropped);
+    }
+
+    // A day whose book was carried: `s`'s signal fields with the given
+    // portfolio fields, without building the DailySignal
+    void append_carry(const DailySignal& s, double size_mult, const PerInstrument<double>& contracts,
+                      double equity, double margin_util, bool dd_warn, bool dd_stop) {
+        append_signal(s);
+        append_book(size_mult, contracts, equity, margin_util, dd_warn, dd_stop, 0);
+    }
+
+    // Column scans
+    const std::vector<int>&    days() const             { return day_; }
+    const std::vector<double>& portfolio_equity() const { return portfolio_equity_; }
+    const std::vector<double>& spx_price() const        { return spx_price_; }
+    const std::vector<double>& liquidity_score() const  { return liquidity_score_; }
+    const double* contracts_row(size_t r) const { return contracts_.data() + r * Inst::COUNT; }
+    uint16_t dropped_mask(size_t r) const { return dropped_[r]; }
+    MacroTilt macro_tilt(size_t r) const { return static_cast<MacroTilt>(state_[r] & 0x3); }
+    Regime    regime(size_t r) const     { return static_cast<Regime>((state_[r] >> 2) & 0x7); }
+
+private:
+    // Signal-phase columns of one day; the portfolio columns follow in append_book()
+    void append_signal(const DailySignal& s) {
+        day_.push_back(s.day);
+        cu_gold_ratio_.push_back(s.cu_gold_ratio);
+        roc_10_.push_back(s.roc_10);
+        roc_20_.push_back(s.roc_20);
+        roc_60_.push_back(s.roc_60);
+        signal_ma_.push_back(s.signal_ma);
+        ratio_zscore_.push_back(s.ratio_zscore);
+        signal_z_.push_back(s.signal_z);
+        composite_.push_back(s.composite);
+        growth_signal_.push_back(s.growth_signal);
+        inflation_signal_.push_back(s.inflation_signal);
+        liquidity_score_.push_back(s.liquidity_score);
+        real_rate_10y_.push_back(s.real_rate_10y);
+        real_rate_chg_20d_.push_back(s.real_rate_chg_20d);
+        real_rate_zscore_.push_back(s.real_rate_zscore);
+        dxy_momentum_.push_back(s.dxy_momentum);
+        china_adjustment_.push_back(s.china_adjustment);
+        spx_price_.push_back(s.spx_price);
+        signal_flips_.push_back(s.signal_flips_trailing_year);
+
+        uint16_t st = static_cast<uint16_t>(static_cast<int>(s.macro_tilt)
+                                          | static_cast<int>(s.regime) << 2
+                                          | static_cast<int>(s.dxy_trend) << 5
+                                          | static_cast<int>(s.dxy_filter) << 7);
+        if (s.skip_gold_short)   st |= SKIP_GOLD_SHORT;
+        if (s.boj_intervention)  st |= BOJ_INTERVENTION;
+        if (s.corr_spike_active) st |= CORR_SPIKE;
+        state_.push_back(st);
+    }
+
+    void append_book(double size_mult, const PerInstrument<double>& contracts, double equity,
+                     double margin_util, bool dd_warn, bool dd_stop, uint16_t dropped) {
+        size_multiplier_.push_back(size_mult);
+        portfolio_equity_.push_back(equity);
+        margin_utilization_.push_back(margin_util);
+        if (dd_warn) state_.back() |= DD_WARNING;
+        if (dd_stop) state_.back() |= DD_STOP;
+        dropped_.push_back(dropped);
+        contracts_.insert(contracts_.end(), contracts.begin(), contracts.end());
+    }
+
+    std::array<std::vector<double>*, 20> double_columns() {
+        return {&cu_gold_ratio_, &roc_10_, &roc_20_, &roc_60_, &signal_ma_, &ratio_zscore_,
+                &signal_z_, &composite_, &growth_signal_, &inflation_signal_, &liquidity_score_,
+                &real_rate_10y_, &real_rate_chg_20d_, &real_rate_zscore_, &dxy_momentum_,
+                &china_adjustment_, &size_multiplier_, &portfolio_equity_, &margin_utilization_,
+                &spx_price_};
+    }
+
+    std::vector<int> day_;
+    std::vector<double> cu_gold_ratio_, roc_10_, roc_20_, roc_60_;
+    std::vector<double> signal_ma_, ratio_zscore_, signal_z_, composite_;
+    std::vector<double> growth_signal_, inflation_signal_, liquidity_score_;
+    std::vector<double> real_rate_10y_, real_rate_chg_20d_, real_rate_zscore_;
+    std::vector<double> dxy_momentum_, china_adjustment_, size_multiplier_;
+    std::vector<double> portfolio_equity_, margin_utilization_, spx_price_;
+    std::vector<int> signal_flips_;
+    std::vector<uint16_t> state_;
+    std::vector<uint16_t> dropped_;  // DailySignal::dropped, bit per InstrumentId
+    std::vector<double> contracts_;  // size() x Inst::COUNT
+};
+
 // ============================================================
 // Strategy parameters - EXACTLY from document
 // ============================================================
@@ -426,15 +2910,476 @@ struct StrategyParams {
     double fixed_position_size = 1.0;
 };
 
+// Hash of every parameter, field by field (struct padding is not hashed).
+// A state snapshot is only valid for the parameters it was built under.
+static uint64_t params_fingerprint(const StrategyParams& p) {
+    StateIO::Writer w;
+    for (int v : {p.roc_10_window, p.roc_20_window, p.roc_60_window, p.ma_fast, p.ma_slow,
+                  p.zscore_window, p.spx_mom_window, p.breakeven_window, p.liq_zscore_window,
+                  p.real_rate_chg_window, p.real_rate_z_window, p.dxy_mom_window,
+                  p.corr_window, p.min_hold_days})
+        w.put(v);
+    for (double v : {p.zscore_thresh, p.composite_thresh, p.w1, p.w2, p.w3, p.liquidity_thresh,
+                     p.dxy_mom_thresh, p.corr_thresh, p.boj_move_thresh, p.leverage_target,
+                     p.max_margin_util, p.drawdown_warn, p.drawdown_stop, p.china_cli_thresh,
+                     p.initial_capital, p.fixed_position_size})
+        w.put(v);
+    for (bool v : {p.use_china_filter, p.use_fixed_positions})
+        w.put(v);
+    return BinCache::fnv1a(BinCache::FNV_BASIS, w.bytes().data(), w.bytes().size());
+}
+
+// Hash of the params build_signals() reads. Configs that agree on it get
+// the same SignalPipeline and differ only in what simulate() does with it.
+static uint64_t signal_fingerprint(StrategyParams p) {
+    const StrategyParams d;
+    p.leverage_target = d.leverage_target;
+    p.max_margin_util = d.max_margin_util;
+    p.drawdown_warn = d.drawdown_warn;
+    p.drawdown_stop = d.drawdown_stop;
+    p.initial_capital = d.initial_capital;
+    p.use_fixed_positions = d.use_fixed_positions;
+    p.fixed_position_size = d.fixed_position_size;
+    return params_fingerprint(p);
+}
+
+// ============================================================
+// Per-run state
+// ============================================================
+// Everything the daily loops carry from one bar to the next, split by
+// phase. Each run owns its state on the stack, so concurrent runs share
+// nothing mutable.
+
+// Signal phase: tilt and regime debounce, DXY filter edge, flip window
+struct SignalState {
+    // Tilt debounce (minimum holding period)
+    MacroTilt prev_tilt    = MacroTilt::NEUTRAL;
+    MacroTilt pending_tilt = MacroTilt::NEUTRAL;
+    int       pending_count = 0;
+
+    Regime     prev_regime     = Regime::NEUTRAL;
+    Regime     pending_regime  = Regime::NEUTRAL;
+    int        pending_regime_count = 0;
+    DXYFilter  prev_dxy_filter = DXYFilter::NEUTRAL;
+    std::deque<int> flip_dates;
+    MacroTilt  last_flip_tilt = MacroTilt::NEUTRAL;
+
+    // Debug bookkeeping
+    Regime last_debug_regime = Regime::NEUTRAL;
+    int    infl_shock_days = 0;
+
+    void save(StateIO::Writer& w) const {
+        w.put(prev_tilt); w.put(pending_tilt); w.put(pending_count);
+        w.put(prev_regime); w.put(pending_regime); w.put(pending_regime_count);
+        w.put(prev_dxy_filter);
+        w.put_vec(std::vector<int>(flip_dates.begin(), flip_dates.end()));
+        w.put(last_flip_tilt);
+        w.put(last_debug_regime); w.put(infl_shock_days);
+    }
+    bool load(StateIO::Reader& r) {
+        std::vector<int> flips;
+        r.get(prev_tilt); r.get(pending_tilt); r.get(pending_count);
+        r.get(prev_regime); r.get(pending_regime); r.get(pending_regime_count);
+        r.get(prev_dxy_filter);
+        r.get_vec(flips);
+        r.get(last_flip_tilt);
+        r.get(last_debug_regime); r.get(infl_shock_days);
+        flip_dates.assign(flips.begin(), flips.end());
+        return r.ok();
+    }
+};
+
+// Simulator phase: equity and the book
+struct RunState {
+    double equity = 0.0;
+    double peak_equity = 0.0;
+
+    PerInstrument<double> positions{};
+    PerInstrument<double> entry_prices;
+    double held_margin = 0.0;   // margin_held(positions), refreshed when the book changes
+
+    // Debug bookkeeping
+    double last_equity_debug = 0.0;
+
+    explicit RunState(double initial_capital)
+        : equity(initial_capital), peak_equity(initial_capital),
+          last_equity_debug(initial_capital) {
+        entry_prices.fill(std::numeric_limits<double>::quiet_NaN());
+    }
+
+    void save(StateIO::Writer& w) const {
+        w.put(equity); w.put(peak_equity);
+        w.put(positions); w.put(entry_prices);
+        w.put(last_equity_debug);
+    }
+    bool load(StateIO::Reader& r) {
+        r.get(equity); r.get(peak_equity);
+        r.get(positions); r.get(entry_prices);
+        r.get(last_equity_debug);
+        held_margin = margin_held(positions);
+        return r.ok();
+    }
+};
+
+// ============================================================
+// Signal pipeline
+// ============================================================
+// Window for the Nov-2014 liquidity debug print (folded at compile time)
+static constexpr int LIQ_DEBUG_FROM = parse_date("2014-11-01");
+static constexpr int LIQ_DEBUG_TO   = parse_date("2014-12-31");
+
+// Indicator values of one calendar day, as the signal step consumes them.
+// Filled from the panel columns in batch mode, from IndicatorStream live.
+struct SignalInputs {
+    static constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+    int row = 0;   // calendar index since the start of the run
+    int day = 0;   // day key
+    bool is_friday = false;
+    double ratio = NaN, roc10 = NaN, roc20 = NaN, roc60 = NaN;
+    double ratio_sma_fast = NaN, ratio_sma_slow = NaN, ratio_sma_z = NaN, ratio_std_z = NaN;
+    double spx_mom = NaN, be_chg = NaN, breakeven = NaN;
+    double real_rate = NaN, rr_chg = NaN, rr_z = NaN;
+    double vix = NaN, vix_pct60 = NaN, vix_q90 = NaN, hy_z = NaN, fed_bs_yoy = NaN;
+    double dxy = NaN, dxy_sma50 = NaN, dxy_sma200 = NaN, dxy_mom = NaN;
+    double china_cli = NaN, china_sma65 = NaN, avg_corr = NaN;
+    double gc_atr = NaN, si_atr = NaN;
+    double gc = NaN, gc_prev = NaN, spx = NaN, spx_prev = NaN, jy = NaN, jy_prev = NaN;
+};
+
+// Prices the simulator marks one day to: as-of settlement today and on the
+// previous calendar day (NaN on the first), and the stop ATR(20)
+struct DayMarks {
+    PerInstrument<double> close, prev_close, stop_atr;
+};
+
+// One valid day of the signal phase
+struct SignalDay {
+    DailySignal sig;         // signal fields; size_multiplier before drawdown scaling
+    int    row = 0;          // index into the pipeline's calendar
+    bool   is_friday = false, regime_changed = false;
+    bool   filter_triggered = false, tilt_changed = false;
+    double si_adj = 0.0;     // GC/SI dollar-ATR ratio, NaN when unavailable
+
+    // Inputs of the signal-side debug lines
+    double breakeven = 0.0;
+    double vix_component = 0.0, hy_component = 0.0, fbs_component = 0.0;
+
+    // Rebalance trigger known before the book is marked
+    bool scheduled() const { return is_friday || regime_changed || filter_triggered || tilt_changed; }
+};
+
+// Output of the signal phase plus the market data the simulator marks to.
+// Immutable once built; share it across simulator runs via shared_ptr.
+struct SignalPipeline {
+    std::vector<int> dates;
+    std::vector<std::string> date_strs;
+    TradingCalendar calendar;                     // over `dates`
+    std::vector<double> ratio;
+    PerInstrument<std::vector<double>> close;     // settlement, Inst order
+    PerInstrument<std::vector<double>> stop_atr;  // ATR(20) for position stops
+    std::vector<SignalDay> days;                  // days with a valid ratio
+    std::vector<uint32_t> events;                 // indices into `days` that are scheduled(), ascending
+    int infl_shock_days = 0;
+};
+
+// ============================================================
+// Streaming indicators
+// ============================================================
+// Latest value of each macro series known on a day, NaN before its first
+// observation: the as-of view the batch panel takes of the macro files
+struct MacroBar {
+    static constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+    double dxy = NaN, vix = NaN, high_yield_spread = NaN;
+    double breakeven_10y = NaN, treasury_10y = NaN, spx = NaN;
+    double fed_balance_sheet = NaN, china_leading_indicator = NaN;
+};
+
+// One calendar day of streaming input. A bar with a NaN close means the
+// instrument did not print that day.
+struct MarketDay {
+    int day = 0;
+    PerInstrument<OHLCVBar> bars;
+    MacroBar macro;
+};
+
+// Last `depth` values of a calendar-aligned series, for x[i - lag] lookups
+class LagRing {
+public:
+    explicit LagRing(int depth = 1)
+        : ring_(static_cast<size_t>(std::max(depth, 1)), std::numeric_limits<double>::quiet_NaN()) {}
+
+    void push(double x) { ring_[pushed_++ % ring_.size()] = x; }
+
+    // Value pushed `lag` days before the latest; NaN if there is none
+    double ago(int lag) const {
+        if (lag < 0 || static_cast<size_t>(lag) >= std::min(pushed_, ring_.size()))
+            return std::numeric_limits<double>::quiet_NaN();
+        return ring_[(pushed_ - 1 - lag) % ring_.size()];
+    }
+
+    void save(StateIO::Writer& w) const {
+        w.put_vec(ring_);
+        w.put<uint64_t>(pushed_);
+    }
+    bool load(StateIO::Reader& r) {
+        uint64_t pushed = 0;
+        bool ok = r.get_vec(ring_, ring_.size()) && r.get(pushed);
+        pushed_ = static_cast<size_t>(pushed);
+        return ok;
+    }
+
+private:
+    std::vector<double> ring_;
+    size_t pushed_ = 0;
+};
+
+// Incremental counterparts of the columns build_signals() derives from the
+// panel, advanced one calendar day per push(). Each rolling statistic is
+// the stream class its batch column is built from (RollingWindow,
+// SlidingRank, RollingCrossMoments) fed the same sequence, and the lag
+// arithmetic goes through the scalar kernels, so every value is
+// bit-identical to the batch column. Sweep window panels are not consulted.
+class IndicatorStream {
+public:
+    explicit IndicatorStream(const StrategyParams& p)
+        : ratio_lag_(std::max({p.roc_10_window, p.roc_20_window, p.roc_60_window}) + 1),
+          spx_lag_(p.spx_mom_window + 1), be_lag_(p.breakeven_window + 1),
+          rr_lag_(p.real_rate_chg_window + 1), dxy_lag_(p.dxy_mom_window + 1),
+          fed_bs_lag_(FED_BS_YOY_LAG + 1),
+          ratio_fast_(p.ma_fast), ratio_slow_(p.ma_slow), ratio_z_(p.zscore_window),
+          rr_z_(p.real_rate_z_window), hy_z_(p.liq_zscore_window), vix_rank_(60),
+          dxy50_(50), dxy200_(200), china65_(65), gc_atr_(20), si_atr_(20),
+          corr_(Inst::COUNT, p.corr_window), p_(p) {
+        close_.fill(std::numeric_limits<double>::quiet_NaN());
+        last_print_.fill(std::numeric_limits<double>::quiet_NaN());
+        tr_.fill(LagRing(STOP_ATR_WINDOW));
+    }
+
+    // Close of each instrument's last raw bar before the first pushed day
+    // (NaN if none). Batch true_range() reads that bar from the raw series
+    // even when it predates the calendar, so a stream whose instrument does
+    // not print on day 0 needs it to match. Call before the first push().
+    void seed_prev_close(const PerInstrument<double>& prior_close) {
+        last_print_ = prior_close;
+    }
+
+    // Advances to the next calendar day and fills its signal inputs and marks
+    void push(int day, const PerInstrument<OHLCVBar>& bars, const MacroBar& mb,
+              SignalInputs& in, DayMarks& m) {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        const int i = row_++;
+        in.row = i;
+        in.day = day;
+        in.is_friday = weekday(day) == 5;
+
+        // Futures: as-of closes, true ranges against the previous print
+        PerInstrument<double> tr;
+        PerInstrument<double> ret;
+        for (InstrumentId id : Inst::ALL) {
+            const OHLCVBar& b = bars[id];
+            const double prev = close_[id];
+            tr[id] = nan;
+            if (!std::isnan(b.close)) {
+                if (i > 0 && !std::isnan(last_print_[id]))
+                    tr[id] = std::max({b.high - b.low,
+                                       std::abs(b.high - last_print_[id]),
+                                       std::abs(b.low - last_print_[id])});
+                close_[id] = b.close;
+                last_print_[id] = b.close;
+            }
+            tr_[id].push(tr[id]);
+            m.close[id] = close_[id];
+            m.prev_close[id] = (i > 0) ? prev : nan;
+            m.stop_atr[id] = nanmean(tr_[id], i);
+            ret[id] = (i > 0) ? ratio(close_[id], 1.0, prev, 1.0) : nan;
+            if (!std::isnan(ret[id])) ret[id] = std::log(ret[id]);
+        }
+        gc_atr_.push(tr[Inst::GC]);
+        si_atr_.push(tr[Inst::SI]);
+        corr_.push(ret.data());
+
+        // Layer 1: ratio, its moving averages and rates of change
+        in.ratio = ratio(close_[Inst::HG], 25000.0, close_[Inst::GC], 100.0);
+        ratio_lag_.push(in.ratio);
+        ratio_fast_.push(in.ratio);
+        ratio_slow_.push(in.ratio);
+        ratio_z_.push(in.ratio);
+        in.roc10 = growth(in.ratio, ratio_lag_.ago(p_.roc_10_window), 1.0);
+        in.roc20 = growth(in.ratio, ratio_lag_.ago(p_.roc_20_window), 1.0);
+        in.roc60 = growth(in.ratio, ratio_lag_.ago(p_.roc_60_window), 1.0);
+        in.ratio_sma_fast = mean(ratio_fast_);
+        in.ratio_sma_slow = mean(ratio_slow_);
+        in.ratio_sma_z = mean(ratio_z_);
+        in.ratio_std_z = ratio_z_.full() ? ratio_z_.stddev() : nan;
+
+        // Layer 2: growth, inflation, real rates, liquidity
+        spx_lag_.push(mb.spx);
+        be_lag_.push(mb.breakeven_10y);
+        in.spx_mom = growth(mb.spx, spx_lag_.ago(p_.spx_mom_window), 100.0);
+        in.be_chg = sub(mb.breakeven_10y, be_lag_.ago(p_.breakeven_window));
+        in.breakeven = mb.breakeven_10y;
+
+        in.real_rate = sub(mb.treasury_10y, mb.breakeven_10y);
+        rr_lag_.push(in.real_rate);
+        rr_z_.push(in.real_rate);
+        in.rr_chg = sub(in.real_rate, rr_lag_.ago(p_.real_rate_chg_window));
+        in.rr_z = zscore(rr_z_, in.real_rate);
+
+        in.vix = mb.vix;
+        vix_rank_.push(mb.vix);
+        if (vix_rank_.full()) {
+            if (vix_rank_.count() > 0)
+                in.vix_pct60 = static_cast<double>(vix_rank_.rank(mb.vix)) / vix_rank_.count();
+            in.vix_q90 = vix_rank_.quantile(0.90);
+        }
+        hy_z_.push(mb.high_yield_spread);
+        in.hy_z = zscore(hy_z_, mb.high_yield_spread);
+        fed_bs_lag_.push(mb.fed_balance_sheet);
+        in.fed_bs_yoy = growth(mb.fed_balance_sheet, fed_bs_lag_.ago(FED_BS_YOY_LAG), 1.0);
+
+        // Layer 3: DXY
+        in.dxy = mb.dxy;
+        dxy_lag_.push(mb.dxy);
+        dxy50_.push(mb.dxy);
+        dxy200_.push(mb.dxy);
+        in.dxy_sma50 = mean(dxy50_);
+        in.dxy_sma200 = mean(dxy200_);
+        in.dxy_mom = growth(mb.dxy, dxy_lag_.ago(p_.dxy_mom_window), 1.0);
+
+        // Layer 4 filters and sizing inputs
+        in.china_cli = mb.china_leading_indicator;
+        china65_.push(mb.china_leading_indicator);
+        in.china_sma65 = mean(china65_);
+        in.avg_corr = corr_.full() ? corr_.avg_offdiag_corr() : 0.0;
+        in.gc_atr = mean(gc_atr_);
+        in.si_atr = mean(si_atr_);
+
+        in.gc = close_[Inst::GC];
+        in.gc_prev = m.prev_close[Inst::GC];
+        in.spx = mb.spx;
+        in.spx_prev = spx_lag_.ago(1);
+        in.jy = close_[Inst::JY];
+        in.jy_prev = m.prev_close[Inst::JY];
+    }
+
+    // Snapshot I/O. Ring sizes come from the params, so a stream restored
+    // into an instance with other window lengths fails to load.
+    void save(StateIO::Writer& w) const {
+        w.put(row_);
+        w.put(close_);
+        w.put(last_print_);
+        for (const LagRing& tr : tr_) tr.save(w);
+        for (const LagRing* lr : {&ratio_lag_, &spx_lag_, &be_lag_, &rr_lag_, &dxy_lag_, &fed_bs_lag_})
+            lr->save(w);
+        for (const RollingWindow* rw : {&ratio_fast_, &ratio_slow_, &ratio_z_, &rr_z_, &hy_z_,
+                                        &dxy50_, &dxy200_, &china65_, &gc_atr_, &si_atr_})
+            rw->save(w);
+        vix_rank_.save(w);
+        corr_.save(w);
+    }
+    bool load(StateIO::Reader& r) {
+        r.get(row_);
+        r.get(close_);
+        r.get(last_print_);
+        for (LagRing& tr : tr_) tr.load(r);
+        for (LagRing* lr : {&ratio_lag_, &spx_lag_, &be_lag_, &rr_lag_, &dxy_lag_, &fed_bs_lag_})
+            lr->load(r);
+        for (RollingWindow* rw : {&ratio_fast_, &ratio_slow_, &ratio_z_, &rr_z_, &hy_z_,
+                                  &dxy50_, &dxy200_, &china65_, &gc_atr_, &si_atr_})
+            rw->load(r);
+        vix_rank_.load(r);
+        corr_.load(r);
+        return r.ok();
+    }
+
+private:
+    static constexpr int FED_BS_YOY_LAG = TradingCalendar::TRADING_YEAR;   // as in rolling_inputs()
+    static constexpr int STOP_ATR_WINDOW = 20;
+
+    static double ratio(double a, double sa, double b, double sb) {
+        double out;
+        Kernels::ratio_scalar(&a, sa, &b, sb, &out, 1);
+        return out;
+    }
+    static double growth(double a, double b, double scale) {
+        double out;
+        Kernels::growth_scalar(&a, &b, scale, &out, 1);
+        return out;
+    }
+    static double sub(double a, double b) {
+        double out;
+        Kernels::sub_scalar(&a, &b, &out, 1);
+        return out;
+    }
+    static double mean(const RollingWindow& rw) {
+        return rw.full() ? rw.mean() : std::numeric_limits<double>::quiet_NaN();
+    }
+    // As rolling_zscore: defined once the window is full and std > 0
+    static double zscore(const RollingWindow& rw, double x) {
+        if (!rw.full()) return std::numeric_limits<double>::quiet_NaN();
+        double sma = rw.mean(), sd = rw.stddev();
+        if (std::isnan(sma) || std::isnan(sd) || sd <= 0.0) return std::numeric_limits<double>::quiet_NaN();
+        return (x - sma) / sd;
+    }
+    // As rolling_nanmean: mean of the defined values, oldest first
+    static double nanmean(const LagRing& tr, int row) {
+        if (row < STOP_ATR_WINDOW - 1) return std::numeric_limits<double>::quiet_NaN();
+        double sum = 0.0;
+        int count = 0;
+        for (int k = STOP_ATR_WINDOW - 1; k >= 0; --k) {
+            double v = tr.ago(k);
+            if (std::isnan(v)) continue;
+            sum += v;
+            ++count;
+        }
+        return count > 0 ? sum / count : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    int row_ = 0;
+    PerInstrument<double> close_;       // as-of settlement
+    PerInstrument<double> last_print_;  // close of the latest bar actually printed
+    PerInstrument<LagRing> tr_;
+
+    LagRing ratio_lag_, spx_lag_, be_lag_, rr_lag_, dxy_lag_, fed_bs_lag_;
+    RollingWindow ratio_fast_, ratio_slow_, ratio_z_, rr_z_, hy_z_;
+    SlidingRank vix_rank_;
+    RollingWindow dxy50_, dxy200_, china65_, gc_atr_, si_atr_;
+    RollingCrossMoments corr_;
+    StrategyParams p_;
+};
+
+// ============================================================
+// Market data
+// ============================================================
+// Everything load_data() reads from disk. Immutable once loaded, so any
+// number of strategy instances (a sweep's configs) can share one copy.
+struct MarketData {
+    std::unordered_map<std::string, FuturesSeries> fut;
+    TimeSeries dxy, vix, hy, breakeven, treasury;
+    TimeSeries tips;       // doc line 682: 10Y TIPS yield
+    TimeSeries spx, fed_bs, china_cli;
+    TimeSeries cny_usd;    // doc line 689: CNY/USD, China FX filter
+};
+
 // ============================================================
 // Main strategy class
 // ============================================================
 class CopperGoldStrategy {
 public:
     CopperGoldStrategy(const std::string& data_dir, const StrategyParams& p)
-        : data_dir_(data_dir), p_(p) {}
+        : data_dir_(data_dir), p_(p), data_(std::make_shared<MarketData>()) {}
+
+    // Runs on already loaded data; load_data() is not needed
+    CopperGoldStrategy(std::shared_ptr<const MarketData> data, const StrategyParams& p)
+        : p_(p), data_(std::move(data)) {}
+
+    const std::shared_ptr<const MarketData>& market_data() const { return data_; }
 
     bool load_data() {
+        auto loaded = std::make_shared<MarketData>();
+        MarketData& md = *loaded;
         auto fut_path = [&](const std::string& sym) {
             return data_dir_ + "/futures/" + sym + ".csv";
         };
@@ -442,198 +3387,290 @@ public:
             return data_dir_ + "/macro/" + name + ".csv";
         };
 
+        // Every file is parsed on the shared pool. Each job writes only its own
+        // destination and buffers its own warnings; both are merged back in the
+        // fixed order below, so members and log output match a sequential load.
+        struct LoadJob {
+            std::string path;
+            FuturesSeries* fut = nullptr;  // exactly one of fut / ts is set
+            TimeSeries* ts = nullptr;
+            std::ostringstream warn;
+        };
+        const std::vector<std::string> fut_syms = {"HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"};
+        const std::vector<std::pair<std::string, TimeSeries*>> macro_files = {
+            {"dxy", &md.dxy},
+            {"vix", &md.vix},
+            {"high_yield_spread", &md.hy},
+            {"breakeven_10y", &md.breakeven},
+            {"treasury_10y", &md.treasury},
+            {"tips_10y", &md.tips},                  // doc line 682
+            {"spx", &md.spx},
+            {"fed_balance_sheet", &md.fed_bs},
+            {"china_leading_indicator", &md.china_cli},
+            {"cny_usd", &md.cny_usd},                // doc line 689
+        };
+
+        std::vector<LoadJob> jobs(fut_syms.size() + macro_files.size());
+        size_t k = 0;
+        for (const auto& sym : fut_syms) {
+            jobs[k].path = fut_path(sym);
+            jobs[k++].fut = &md.fut[sym];
+        }
+        for (const auto& [name, dst] : macro_files) {
+            jobs[k].path = mac_path(name);
+            jobs[k++].ts = dst;
+        }
+
         std::cout << "[INFO] Loading futures data...\n";
-        for (const auto& sym : {"HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"}) {
-            fut_[sym] = load_futures(fut_path(sym));
-            if (fut_[sym].empty())
+        shared_pool().parallel_for(jobs.size(), [&](size_t j) {
+            LoadJob& job = jobs[j];
+            if (job.fut) *job.fut = load_futures(job.path, job.warn);
+            else         *job.ts = load_macro(job.path, job.warn);
+        });
+
+        k = 0;
+        for (const auto& sym : fut_syms) {
+            std::cerr << jobs[k++].warn.str();
+            if (md.fut[sym].empty())
                 std::cerr << "[WARN] No data for " << sym << "\n";
             else
-                std::cout << "[INFO] Loaded " << fut_[sym].size() << " bars for " << sym << "\n";
+                std::cout << "[INFO] Loaded " << md.fut[sym].size() << " bars for " << sym << "\n";
         }
 
         // Verify units
-        std::cout << "[DEBUG] GC first price: " << fut_["GC"].begin()->second.close << "\n";
-        std::cout << "[DEBUG] GC last price:  " << fut_["GC"].rbegin()->second.close << "\n";
-        std::cout << "[DEBUG] HG first price: " << fut_["HG"].begin()->second.close << "\n";
-        std::cout << "[DEBUG] HG last price:  " << fut_["HG"].rbegin()->second.close << "\n";
-        std::cout << "[DEBUG] 6J first price: " << fut_["6J"].begin()->second.close << "\n";
-        std::cout << "[DEBUG] 6J last price:  " << fut_["6J"].rbegin()->second.close << "\n";
+        std::cout << "[DEBUG] GC first price: " << md.fut["GC"].close.front() << "\n";
+        std::cout << "[DEBUG] GC last price:  " << md.fut["GC"].close.back() << "\n";
+        std::cout << "[DEBUG] HG first price: " << md.fut["HG"].close.front() << "\n";
+        std::cout << "[DEBUG] HG last price:  " << md.fut["HG"].close.back() << "\n";
+        std::cout << "[DEBUG] 6J first price: " << md.fut["6J"].close.front() << "\n";
+        std::cout << "[DEBUG] 6J last price:  " << md.fut["6J"].close.back() << "\n";
 
         std::cout << "[INFO] Loading macro data...\n";
-        dxy_ts_ = load_macro(mac_path("dxy"));
-        vix_ts_ = load_macro(mac_path("vix"));
-        hy_ts_ = load_macro(mac_path("high_yield_spread"));
-        breakeven_ts_ = load_macro(mac_path("breakeven_10y"));
-        treasury_ts_ = load_macro(mac_path("treasury_10y"));
-        tips_ts_ = load_macro(mac_path("tips_10y"));        // doc line 682
-        spx_ts_ = load_macro(mac_path("spx"));
-        fed_bs_ts_ = load_macro(mac_path("fed_balance_sheet"));
-        china_cli_ts_ = load_macro(mac_path("china_leading_indicator"));
-        cny_usd_ts_ = load_macro(mac_path("cny_usd"));     // doc line 689
-
-        std::cout << "[INFO] DXY records: " << dxy_ts_.size() << "\n";
-        std::cout << "[INFO] VIX records: " << vix_ts_.size() << "\n";
-        std::cout << "[INFO] HY spread records: " << hy_ts_.size() << "\n";
-        std::cout << "[INFO] Breakeven records: " << breakeven_ts_.size() << "\n";
-        std::cout << "[INFO] Treasury records: " << treasury_ts_.size() << "\n";
-        std::cout << "[INFO] TIPS records: " << tips_ts_.size() << "\n";
-        std::cout << "[INFO] SPX records: " << spx_ts_.size() << "\n";
-        std::cout << "[INFO] Fed BS records: " << fed_bs_ts_.size() << "\n";
-        std::cout << "[INFO] China CLI records: " << china_cli_ts_.size() << "\n";
-        std::cout << "[INFO] CNY/USD records: " << cny_usd_ts_.size() << "\n";
-
-        return !fut_["HG"].empty() && !fut_["GC"].empty();
-    }
-
-    std::vector<DailySignal> run() {
-        // Date range
-        int start_dk = std::max(fut_["HG"].begin()->first, fut_["GC"].begin()->first);
-        int end_dk = std::min(fut_["HG"].rbegin()->first, fut_["GC"].rbegin()->first);
-
-        std::cout << "[INFO] Date range: " << date_from_int(start_dk)
-                  << " to " << date_from_int(end_dk) << "\n";
-
-        // Build calendar
-        std::map<int, bool> date_set;
-        for (const auto& [sym, series] : fut_) {
-            for (const auto& [dk, bar] : series) {
-                if (dk >= start_dk && dk <= end_dk)
-                    date_set[dk] = true;
-            }
+        for (; k < jobs.size(); ++k)
+            std::cerr << jobs[k].warn.str();
+
+        std::cout << "[INFO] DXY records: " << md.dxy.size() << "\n";
+        std::cout << "[INFO] VIX records: " << md.vix.size() << "\n";
+        std::cout << "[INFO] HY spread records: " << md.hy.size() << "\n";
+        std::cout << "[INFO] Breakeven records: " << md.breakeven.size() << "\n";
+        std::cout << "[INFO] Treasury records: " << md.treasury.size() << "\n";
+        std::cout << "[INFO] TIPS records: " << md.tips.size() << "\n";
+        std::cout << "[INFO] SPX records: " << md.spx.size() << "\n";
+        std::cout << "[INFO] Fed BS records: " << md.fed_bs.size() << "\n";
+        std::cout << "[INFO] China CLI records: " << md.china_cli.size() << "\n";
+        std::cout << "[INFO] CNY/USD records: " << md.cny_usd.size() << "\n";
+
+        const bool ok = !md.fut["HG"].empty() && !md.fut["GC"].empty();
+        data_ = std::move(loaded);
+        return ok;
+    }
+
+    // Aligns every loaded series onto the trading calendar in [start_dk, end_dk]
+    Panel build_panel(int start_dk, int end_dk) const {
+        Panel panel;
+        std::vector<const DateIndex*> srcs;
+        for (const auto& [sym, series] : data_->fut) srcs.push_back(&series);
+        panel.dates = merge_calendar(srcs, start_dk, end_dk);
+        panel.missing.assign(panel.dates.size(), std::numeric_limits<double>::quiet_NaN());
+
+        for (const auto& [sym, series] : data_->fut)
+            panel.fut_close[sym] = asof_join(panel.dates, series, series.close);
+
+        const std::pair<const char*, const TimeSeries*> macro_cols[] = {
+            {"dxy", &data_->dxy}, {"vix", &data_->vix}, {"high_yield_spread", &data_->hy},
+            {"breakeven_10y", &data_->breakeven}, {"treasury_10y", &data_->treasury},
+            {"tips_10y", &data_->tips}, {"spx", &data_->spx}, {"fed_balance_sheet", &data_->fed_bs},
+            {"china_leading_indicator", &data_->china_cli}, {"cny_usd", &data_->cny_usd},
+        };
+        for (const auto& [name, ts] : macro_cols)
+            panel.macro[name] = asof_join(panel.dates, *ts, ts->value);
+        return panel;
+    }
+
+    // Date range of a run: the overlap of the HG and GC histories
+    std::pair<int, int> date_bounds() const {
+        const FuturesSeries& hg = data_->fut.at("HG");
+        const FuturesSeries& gc = data_->fut.at("GC");
+        return {std::max(hg.first_date(), gc.first_date()),
+                std::min(hg.last_date(), gc.last_date())};
+    }
+
+    // Parameter-free series the swept rolling windows are taken over
+    struct RollingInputs {
+        std::vector<double> ratio, real_rate, fed_bs_yoy;
+    };
+
+    static RollingInputs rolling_inputs(const Panel& panel) {
+        RollingInputs in;
+        // Cu_notional = HG_price * 25000 / 100 (convert cents to dollars)
+        // Au_notional = GC_price * 100
+        // ratio = Cu_notional / Au_notional where both prices exist and GC > 0
+        in.ratio = Kernels::ratio(panel.close("HG"), 25000.0, panel.close("GC"), 100.0);
+        in.real_rate = Kernels::sub(panel.macro.at("treasury_10y").value,
+                                    panel.macro.at("breakeven_10y").value);
+        in.fed_bs_yoy = Lag::pct_change(panel.macro.at("fed_balance_sheet").value, TradingCalendar::TRADING_YEAR);
+        return in;
+    }
+
+    // Precomputes every rolling mean/std that a parameter grid will ask for,
+    // one multi-window pass per series. Requires load_data(); pass the result
+    // to set_window_panels() on each strategy instance of the sweep.
+    WindowPanelSet build_window_panels(const std::vector<StrategyParams>& grid) const {
+        const auto [start_dk, end_dk] = date_bounds();
+        const Panel panel = build_panel(start_dk, end_dk);
+        const RollingInputs in = rolling_inputs(panel);
+
+        std::vector<int> ratio_w, rr_w, liq_w;
+        for (const StrategyParams& g : grid) {
+            ratio_w.insert(ratio_w.end(), {g.ma_fast, g.ma_slow, g.zscore_window});
+            rr_w.push_back(g.real_rate_z_window);
+            liq_w.push_back(g.liq_zscore_window);
         }
-        std::vector<int> dates;
-        for (const auto& [dk, _] : date_set) dates.push_back(dk);
-        std::sort(dates.begin(), dates.end());
+        WindowPanelSet set;
+        set.series["ratio"] = rolling_multi(in.ratio, ratio_w);
+        set.series["real_rate"] = rolling_multi(in.real_rate, rr_w);
+        set.series["hy"] = rolling_multi(panel.macro.at("high_yield_spread").value, liq_w);
+        return set;
+    }
 
-        int n = dates.size();
-        std::cout << "[INFO] Total trading days: " << n << "\n";
+    // Drops build_signals()'s progress lines and data validation report;
+    // a sweep prints them once for the whole run rather than per config
+    void set_quiet(bool q) { quiet_ = q; }
 
-        // Extract price series
-        auto extract_close = [&](const std::string& sym) {
-            std::vector<double> v(n, std::numeric_limits<double>::quiet_NaN());
-            for (int i = 0; i < n; ++i)
-                v[i] = ffill_fut_close(fut_[sym], dates[i]);
-            return v;
-        };
+    // Shared window panels (not owned); run() reads rolling stats from them
+    // when present instead of recomputing them
+    void set_window_panels(const WindowPanelSet* wp) { window_panels_ = wp; }
 
-        auto extract_macro = [&](const TimeSeries& ts) {
-            std::vector<double> v(n, std::numeric_limits<double>::quiet_NaN());
-            for (int i = 0; i < n; ++i)
-                v[i] = ffill(ts, dates[i]);
-            return v;
-        };
+    // Phase 1: the per-day signal path (Layers 1-4, filters, base size
+    // multiplier, rebalance triggers). Depends only on market data and the
+    // signal params; the result can be shared by any number of simulate()
+    // calls whose params differ only in risk, sizing or costs.
+    std::shared_ptr<const SignalPipeline> build_signals() const {
+        // Date range
+        const auto [start_dk, end_dk] = date_bounds();
+
+        if (!quiet_)
+            std::cout << "[INFO] Date range: " << date_from_int(start_dk)
+                      << " to " << date_from_int(end_dk) << "\n";
+
+        const Panel panel = build_panel(start_dk, end_dk);
+        auto out = std::make_shared<SignalPipeline>();
+        SignalPipeline& sp = *out;
+        sp.dates = panel.dates;
+        const std::vector<int>& dates = sp.dates;
+
+        int n = dates.size();
+        if (!quiet_) std::cout << "[INFO] Total trading days: " << n << "\n";
+        sp.date_strs = format_dates(dates);
+        sp.calendar = TradingCalendar(dates);
+        const std::vector<std::string>& date_strs = sp.date_strs;
 
-        std::vector<double> hg = extract_close("HG");
-        std::vector<double> gc = extract_close("GC");
-        std::vector<double> cl = extract_close("CL");
-        std::vector<double> si = extract_close("SI");
-        std::vector<double> zn = extract_close("ZN");
-        std::vector<double> ub = extract_close("UB");
-        std::vector<double> jy = extract_close("6J");
-        std::vector<double> mes = extract_close("MES");
-        std::vector<double> mnq = extract_close("MNQ");
+        // Extract price series
+        const std::vector<double>& hg = panel.close("HG");
+        const std::vector<double>& gc = panel.close("GC");
+        const std::vector<double>& cl = panel.close("CL");
+        const std::vector<double>& si = panel.close("SI");
+        const std::vector<double>& zn = panel.close("ZN");
+        const std::vector<double>& ub = panel.close("UB");
+        const std::vector<double>& jy = panel.close("6J");
+        const std::vector<double>& mes = panel.close("MES");
+        const std::vector<double>& mnq = panel.close("MNQ");
 
         // ================================================================
         // DATA VALIDATION - Check for unrealistic price moves
         // ================================================================
-        for (int i = 1; i < n; ++i) {
+        for (int i = 1; i < n && !quiet_; ++i) {
             double hg_change = std::abs(hg[i] - hg[i-1]) / hg[i-1];
             double gc_change = std::abs(gc[i] - gc[i-1]) / gc[i-1];
             double cl_change = std::abs(cl[i] - cl[i-1]) / cl[i-1];
 
             if (hg_change > 0.5) {  // 50% move in one day
                 std::cout << "[ERROR] Unrealistic HG price move: "
-                          << date_from_int(dates[i-1]) << " " << hg[i-1]
-                          << " -> " << date_from_int(dates[i]) << " " << hg[i]
+                          << date_strs[i-1] << " " << hg[i-1]
+                          << " -> " << date_strs[i] << " " << hg[i]
                           << " (" << (hg_change*100) << "%)\n";
             }
             if (gc_change > 0.5) {
                 std::cout << "[ERROR] Unrealistic GC price move: "
-                          << date_from_int(dates[i-1]) << " " << gc[i-1]
-                          << " -> " << date_from_int(dates[i]) << " " << gc[i]
+                          << date_strs[i-1] << " " << gc[i-1]
+                          << " -> " << date_strs[i] << " " << gc[i]
                           << " (" << (gc_change*100) << "%)\n";
             }
             if (cl_change > 0.5) {
                 std::cout << "[ERROR] Unrealistic CL price move: "
-                          << date_from_int(dates[i-1]) << " " << cl[i-1]
-                          << " -> " << date_from_int(dates[i]) << " " << cl[i]
+                          << date_strs[i-1] << " " << cl[i-1]
+                          << " -> " << date_strs[i] << " " << cl[i]
                           << " (" << (cl_change*100) << "%)\n";
             }
         }
 
 
-        std::vector<double> dxy = extract_macro(dxy_ts_);
-        std::vector<double> vix = extract_macro(vix_ts_);
-        std::vector<double> hy = extract_macro(hy_ts_);
-        std::vector<double> breakeven = extract_macro(breakeven_ts_);
-        std::vector<double> treasury = extract_macro(treasury_ts_);
-        std::vector<double> spx = extract_macro(spx_ts_);
-        std::vector<double> fed_bs = extract_macro(fed_bs_ts_);
-        std::vector<double> china_cli = extract_macro(china_cli_ts_);
+        const std::vector<double>& dxy = panel.macro.at("dxy").value;
+        const std::vector<double>& vix = panel.macro.at("vix").value;
+        const std::vector<double>& hy = panel.macro.at("high_yield_spread").value;
+        const std::vector<double>& breakeven = panel.macro.at("breakeven_10y").value;
+        const std::vector<double>& spx = panel.macro.at("spx").value;
+        const std::vector<double>& china_cli = panel.macro.at("china_leading_indicator").value;
 
         // ================================================================
         // Layer 1: Cu/Gold Ratio - NOTIONAL NORMALIZATION
         // ================================================================
-        std::vector<double> ratio(n, std::numeric_limits<double>::quiet_NaN());
-        for (int i = 0; i < n; ++i) {
-            if (!std::isnan(hg[i]) && !std::isnan(gc[i]) && gc[i] > 0.0) {
-                // Cu_notional = HG_price * 25000 / 100 (convert cents to dollars)
-                // Au_notional = GC_price * 100
-                double cu_notional = hg[i] * 25000.0;
-                double au_notional = gc[i] * 100.0;
-                ratio[i] = cu_notional / au_notional;
-            }
-        }
+        const RollingInputs inputs = rolling_inputs(panel);
+        const std::vector<double>& ratio = inputs.ratio;
+
+        // Swept rolling stats: looked up in the shared window panels when a
+        // sweep supplied them, computed here otherwise
+        auto sma = [&](const char* key, const std::vector<double>& v, int w) {
+            const auto* col = window_panels_ ? window_panels_->mean(key, w) : nullptr;
+            return col ? *col : rolling_mean(v, w);
+        };
+        auto sdev = [&](const char* key, const std::vector<double>& v, int w) {
+            const auto* col = window_panels_ ? window_panels_->stddev(key, w) : nullptr;
+            return col ? *col : rolling_std(v, w);
+        };
+        auto zscore = [&](const char* key, const std::vector<double>& v, int w) {
+            const auto* m = window_panels_ ? window_panels_->mean(key, w) : nullptr;
+            const auto* sd = window_panels_ ? window_panels_->stddev(key, w) : nullptr;
+            return (m && sd) ? zscore_from(v, *m, *sd) : rolling_zscore(v, w);
+        };
 
         // Signal calculations
-        auto ratio_sma10 = rolling_mean(ratio, p_.ma_fast);
-        auto ratio_sma50 = rolling_mean(ratio, p_.ma_slow);
-        auto ratio_sma120 = rolling_mean(ratio, p_.zscore_window);
-        auto ratio_std120 = rolling_std(ratio, p_.zscore_window);
+        auto ratio_sma10 = sma("ratio", ratio, p_.ma_fast);
+        auto ratio_sma50 = sma("ratio", ratio, p_.ma_slow);
+        auto ratio_sma120 = sma("ratio", ratio, p_.zscore_window);
+        auto ratio_std120 = sdev("ratio", ratio, p_.zscore_window);
+
+        // Ratio rate of change (Layer 1)
+        const auto ratio_rocs = Lag::pct_changes(
+            ratio, {p_.roc_10_window, p_.roc_20_window, p_.roc_60_window});
+        const std::vector<double>& roc10_col = ratio_rocs[0];
+        const std::vector<double>& roc20_col = ratio_rocs[1];
+        const std::vector<double>& roc60_col = ratio_rocs[2];
 
         // SPX momentum (60d)
-        std::vector<double> spx_mom(n, std::numeric_limits<double>::quiet_NaN());
-        for (int i = p_.spx_mom_window; i < n; ++i) {
-            if (!std::isnan(spx[i]) && !std::isnan(spx[i - p_.spx_mom_window]) && spx[i - p_.spx_mom_window] > 0.0)
-                spx_mom[i] = ((spx[i] / spx[i - p_.spx_mom_window]) - 1.0) * 100.0;
-        }
+        std::vector<double> spx_mom = Lag::pct_change(spx, p_.spx_mom_window, 100.0);
 
         // Breakeven change (20d)
-        std::vector<double> be_chg(n, std::numeric_limits<double>::quiet_NaN());
-        for (int i = p_.breakeven_window; i < n; ++i) {
-            if (!std::isnan(breakeven[i]) && !std::isnan(breakeven[i - p_.breakeven_window]))
-                be_chg[i] = breakeven[i] - breakeven[i - p_.breakeven_window];
-        }
+        std::vector<double> be_chg = Lag::diff(breakeven, p_.breakeven_window);
 
         // Real rates
-        std::vector<double> real_rate(n, std::numeric_limits<double>::quiet_NaN());
-        for (int i = 0; i < n; ++i) {
-            if (!std::isnan(treasury[i]) && !std::isnan(breakeven[i]))
-                real_rate[i] = treasury[i] - breakeven[i];
-        }
+        const std::vector<double>& real_rate = inputs.real_rate;
 
-        std::vector<double> rr_chg(n, std::numeric_limits<double>::quiet_NaN());
-        for (int i = p_.real_rate_chg_window; i < n; ++i) {
-            if (!std::isnan(real_rate[i]) && !std::isnan(real_rate[i - p_.real_rate_chg_window]))
-                rr_chg[i] = real_rate[i] - real_rate[i - p_.real_rate_chg_window];
-        }
+        std::vector<double> rr_chg = Lag::diff(real_rate, p_.real_rate_chg_window);
 
-        auto rr_zscore = rolling_zscore(real_rate, p_.real_rate_z_window);
+        auto rr_zscore = zscore("real_rate", real_rate, p_.real_rate_z_window);
 
-        // Z-scores for liquidity
-        auto vix_z60 = rolling_zscore(vix, p_.liq_zscore_window);
-        auto hy_z60 = rolling_zscore(hy, p_.liq_zscore_window);
+        // Liquidity inputs: VIX enters as its 60d percentile, HY as a z-score
+        auto vix_pct60 = rolling_percentile_rank(vix, 60);
+        auto vix_q90 = rolling_quantile(vix, 60, 0.90);
+        auto hy_z60 = zscore("hy", hy, p_.liq_zscore_window);
 
-        // Fed balance sheet YoY growth
-        std::vector<double> fed_bs_yoy(n, std::numeric_limits<double>::quiet_NaN());
-        for (int i = 252; i < n; ++i) {
-            if (!std::isnan(fed_bs[i]) && !std::isnan(fed_bs[i - 252]) && fed_bs[i - 252] > 0.0)
-                fed_bs_yoy[i] = (fed_bs[i] / fed_bs[i - 252]) - 1.0;
-        }
+        // Fed balance sheet YoY growth; signal_step() scales the raw ratio
+        // onto the other components' range (outline lines 218-222)
+        const std::vector<double>& fed_bs_yoy = inputs.fed_bs_yoy;
 
-        // Z-score the fed balance sheet YoY growth for normalization
-        // (outline lines 218-222: all three components must be on comparable scale)
-        auto fed_bs_yoy_z60 = rolling_zscore(fed_bs_yoy, p_.liq_zscore_window);
+        // DXY momentum (Layer 3)
+        std::vector<double> dxy_mom_col = Lag::pct_change(dxy, p_.dxy_mom_window);
 
         // DXY moving averages
         auto dxy_sma50 = rolling_mean(dxy, 50);
@@ -643,862 +3680,934 @@ public:
         auto china_sma65 = rolling_mean(china_cli, 65);
 
         // ATRs for volatility adjustment
-        auto gc_atr = compute_atr(dates, fut_["GC"], 20);
-        auto si_atr = compute_atr(dates, fut_["SI"], 20);
+        auto gc_atr = compute_atr(dates, data_->fut.at("GC"), 20);
+        auto si_atr = compute_atr(dates, data_->fut.at("SI"), 20);
 
         // Pre-compute returns for correlation
-        auto make_ret = [&](const std::vector<double>& px) {
-            std::vector<double> r(n, std::numeric_limits<double>::quiet_NaN());
-            for (int i = 1; i < n; ++i)
-                if (!std::isnan(px[i]) && !std::isnan(px[i-1]) && px[i-1] > 0.0)
-                    r[i] = std::log(px[i] / px[i-1]);
-            return r;
-        };
-
-        std::vector<std::vector<double>> all_rets = {
-            make_ret(hg), make_ret(gc), make_ret(cl), make_ret(si),
-            make_ret(zn), make_ret(ub), make_ret(jy),
-            make_ret(mes), make_ret(mnq)
-        };
+        std::vector<std::vector<double>> all_rets =
+            Lag::log_returns({&hg, &gc, &cl, &si, &zn, &ub, &jy, &mes, &mnq});
+        const std::vector<double> avg_corr = rolling_avg_pairwise_corr(all_rets, p_.corr_window);
 
         // ================================================================
-        // MAIN LOOP
+        // SIGNAL LOOP
         // ================================================================
-        std::vector<DailySignal> signals;
-        signals.reserve(n);
-
-        double equity = p_.initial_capital;
-        double peak_equity = equity;
+        sp.ratio = ratio;
+        sp.close = {hg, gc, cl, si, zn, ub, jy, mes, mnq};
+
+        // ATR(20) for the position-level stop: mean of the true ranges the
+        // instrument actually printed over the last 20 calendar days
+        for (InstrumentId id : Inst::ALL) {
+            auto it = data_->fut.find(Inst::symbol(id));
+            sp.stop_atr[id] = (it != data_->fut.end())
+                ? rolling_nanmean(true_range(dates, it->second), 20)
+                : std::vector<double>(n, std::numeric_limits<double>::quiet_NaN());
+        }
+        sp.days.reserve(n);
 
-        MacroTilt prev_tilt = MacroTilt::NEUTRAL;
-        MacroTilt pending_tilt = MacroTilt::NEUTRAL;
-        int pending_count = 0;
+        SignalState ss;
+        for (int i = 0; i < n; ++i) {
+            if (std::isnan(ratio[i])) continue;
 
-        // Track positions and entry prices
-        std::unordered_map<std::string, double> positions;
-        std::unordered_map<std::string, double> entry_prices;
-        for (const char* s : {"HG", "GC", "CL", "SI", "ZN", "UB", "6J", "MES", "MNQ"}) {
-            positions[s] = 0.0;
-            entry_prices[s] = std::numeric_limits<double>::quiet_NaN();
-        }
-
-        // Point values
-        const std::unordered_map<std::string, double> POINT_VALUE = {
-            {"HG", 250.0},    // 1 cent = $250
-            {"GC", 100.0},    // $1 = $100
-            {"CL", 1000.0},   // $1 = $1000
-            {"SI", 5000.0},   // $1 = $5000
-            {"ZN", 1000.0},   // 1 point = $1000
-            {"UB", 1000.0},   // 1 point = $1000
-            {"6J", 12.50},    // 1 pip = $12.50
-            {"MES", 5.0},     // 1 point = $5
-            {"MNQ", 2.0}      // 1 point = $2
-        };
+            SignalInputs in;
+            in.row = i;
+            in.day = dates[i];
+            in.is_friday = sp.calendar.is_friday(i);
+            in.ratio = ratio[i];
+            in.roc10 = roc10_col[i];
+            in.roc20 = roc20_col[i];
+            in.roc60 = roc60_col[i];
+            in.ratio_sma_fast = ratio_sma10[i];
+            in.ratio_sma_slow = ratio_sma50[i];
+            in.ratio_sma_z = ratio_sma120[i];
+            in.ratio_std_z = ratio_std120[i];
+            in.spx_mom = spx_mom[i];
+            in.be_chg = be_chg[i];
+            in.breakeven = breakeven[i];
+            in.real_rate = real_rate[i];
+            in.rr_chg = rr_chg[i];
+            in.rr_z = rr_zscore[i];
+            in.vix = vix[i];
+            in.vix_pct60 = vix_pct60[i];
+            in.vix_q90 = vix_q90[i];
+            in.hy_z = hy_z60[i];
+            in.fed_bs_yoy = fed_bs_yoy[i];
+            in.dxy = dxy[i];
+            in.dxy_sma50 = dxy_sma50[i];
+            in.dxy_sma200 = dxy_sma200[i];
+            in.dxy_mom = dxy_mom_col[i];
+            in.china_cli = china_cli[i];
+            in.china_sma65 = china_sma65[i];
+            in.avg_corr = avg_corr[i];
+            in.gc_atr = gc_atr[i];
+            in.si_atr = si_atr[i];
+            in.gc = gc[i];
+            in.spx = spx[i];
+            in.jy = jy[i];
+            if (i > 0) {
+                in.gc_prev = gc[i-1];
+                in.spx_prev = spx[i-1];
+                in.jy_prev = jy[i-1];
+            }
+            sp.days.push_back(signal_step(in, ss));
+            if (sp.days.back().scheduled())
+                sp.events.push_back(static_cast<uint32_t>(sp.days.size() - 1));
+        }
+        sp.infl_shock_days = ss.infl_shock_days;
+        return out;
+    }
 
-        // Price vectors for easy access
-        std::unordered_map<std::string, const std::vector<double>*> px_map = {
-            {"HG", &hg}, {"GC", &gc}, {"CL", &cl}, {"SI", &si},
-            {"ZN", &zn}, {"UB", &ub}, {"6J", &jy}, {"MES", &mes}, {"MNQ", &mnq}
-        };
+    // One valid day of the signal phase: Layers 1-4, filters, base size
+    // multiplier and the signal-side rebalance triggers. Shared by the batch
+    // pipeline and the streaming engine so both walk the same code.
+    SignalDay signal_step(const SignalInputs& in, SignalState& ss) const {
+        const int i = in.row;
+        MacroTilt& prev_tilt     = ss.prev_tilt;
+        MacroTilt& pending_tilt  = ss.pending_tilt;
+        int&       pending_count = ss.pending_count;
+        MacroTilt& last_flip_tilt  = ss.last_flip_tilt;
+        int&       infl_shock_days = ss.infl_shock_days;
+
+        Regime&    prev_regime     = ss.prev_regime;
+        DXYFilter& prev_dxy_filter = ss.prev_dxy_filter;
+        Regime&    pending_regime  = ss.pending_regime;
+        int&       pending_regime_count = ss.pending_regime_count;
 
-        // State variables that persist across iterations (weekly rebalance, regime tracking)
-        // State variables that persist across iterations (weekly rebalance, regime tracking)
-        Regime     prev_regime_state     = Regime::NEUTRAL;
-        DXYFilter  prev_dxy_filter_state = DXYFilter::NEUTRAL;
-        std::deque<int> flip_dates_deque;
-        MacroTilt  last_flip_tilt = MacroTilt::NEUTRAL;
-        double     last_equity_debug = equity;
-        int        infl_shock_days = 0;
+        // ============================================================
+        // Layer 1: Signal Generation
+        double roc10 = in.roc10;
+        double roc20 = in.roc20;
+        double roc60 = in.roc60;
+
+        double signal_ma = 0.0;
+        if (!std::isnan(in.ratio_sma_fast) && !std::isnan(in.ratio_sma_slow))
+            signal_ma = (in.ratio_sma_fast > in.ratio_sma_slow) ? 1.0 : -1.0;
+
+        double zscore = std::numeric_limits<double>::quiet_NaN();
+        double signal_z = 0.0;
+        if (!std::isnan(in.ratio_sma_z) && !std::isnan(in.ratio_std_z) && in.ratio_std_z > 0.0) {
+            zscore = (in.ratio - in.ratio_sma_z) / in.ratio_std_z;
+            if (zscore > p_.zscore_thresh) signal_z = 1.0;
+            else if (zscore < -p_.zscore_thresh) signal_z = -1.0;
+        }
 
+        double composite = std::numeric_limits<double>::quiet_NaN();
+        if (!std::isnan(roc20) && !std::isnan(zscore)) {
+            double sign_roc20 = (roc20 > 0.0) ? 1.0 : -1.0;
+            composite = p_.w1 * sign_roc20 + p_.w2 * signal_ma + p_.w3 * signal_z;
+        }
 
-        for (int i = 0; i < n; ++i) {
-            if (std::isnan(ratio[i])) continue;
+        MacroTilt raw_tilt = MacroTilt::NEUTRAL;
+        if (!std::isnan(composite)) {
+            if (composite > p_.composite_thresh) raw_tilt = MacroTilt::RISK_ON;
+            else if (composite < -p_.composite_thresh) raw_tilt = MacroTilt::RISK_OFF;
+        }
 
-            // ============================================================
-            // Layer 1: Signal Generation
-            double roc10 = std::numeric_limits<double>::quiet_NaN();
-            double roc20 = std::numeric_limits<double>::quiet_NaN();
-            double roc60 = std::numeric_limits<double>::quiet_NaN();
-
-            if (i >= p_.roc_10_window && !std::isnan(ratio[i - p_.roc_10_window]) && ratio[i - p_.roc_10_window] > 0.0)
-                roc10 = (ratio[i] / ratio[i - p_.roc_10_window]) - 1.0;
-            if (i >= p_.roc_20_window && !std::isnan(ratio[i - p_.roc_20_window]) && ratio[i - p_.roc_20_window] > 0.0)
-                roc20 = (ratio[i] / ratio[i - p_.roc_20_window]) - 1.0;
-            if (i >= p_.roc_60_window && !std::isnan(ratio[i - p_.roc_60_window]) && ratio[i - p_.roc_60_window] > 0.0)
-                roc60 = (ratio[i] / ratio[i - p_.roc_60_window]) - 1.0;
-
-            double signal_ma = 0.0;
-            if (!std::isnan(ratio_sma10[i]) && !std::isnan(ratio_sma50[i]))
-                signal_ma = (ratio_sma10[i] > ratio_sma50[i]) ? 1.0 : -1.0;
-
-            double zscore = std::numeric_limits<double>::quiet_NaN();
-            double signal_z = 0.0;
-            if (!std::isnan(ratio_sma120[i]) && !std::isnan(ratio_std120[i]) && ratio_std120[i] > 0.0) {
-                zscore = (ratio[i] - ratio_sma120[i]) / ratio_std120[i];
-                if (zscore > p_.zscore_thresh) signal_z = 1.0;
-                else if (zscore < -p_.zscore_thresh) signal_z = -1.0;
+        // Minimum holding period
+        MacroTilt macro_tilt = prev_tilt;
+        if (raw_tilt != prev_tilt) {
+            if (raw_tilt != pending_tilt) {
+                pending_tilt = raw_tilt;
+                pending_count = 1;
+            } else {
+                pending_count++;
             }
-
-            double composite = std::numeric_limits<double>::quiet_NaN();
-            if (!std::isnan(roc20) && !std::isnan(zscore)) {
-                double sign_roc20 = (roc20 > 0.0) ? 1.0 : -1.0;
-                composite = p_.w1 * sign_roc20 + p_.w2 * signal_ma + p_.w3 * signal_z;
+            if (pending_count >= p_.min_hold_days) {
+                prev_tilt = pending_tilt;
+                macro_tilt = pending_tilt;
+                pending_count = 0;
             }
+        } else {
+            pending_tilt = raw_tilt;
+            pending_count = 0;
+            macro_tilt = prev_tilt;
+        }
 
-            MacroTilt raw_tilt = MacroTilt::NEUTRAL;
-            if (!std::isnan(composite)) {
-                if (composite > p_.composite_thresh) raw_tilt = MacroTilt::RISK_ON;
-                else if (composite < -p_.composite_thresh) raw_tilt = MacroTilt::RISK_OFF;
-            }
+        // ============================================================
+        // Signal Stability Check (doc line 125, 357, 587, 607)
+        // "signal should not flip more than 8-12x per year"
+        // ============================================================
+        // Track flips in the trailing trading year (TRADING_YEAR rows)
+        // We record flip rows in a deque and count those still in the window
+        auto& flip_dates = ss.flip_dates;
+        // Capture tilt_just_changed BEFORE any mutation, so it can be reused
+        // for rebalance detection later in the same iteration (outline lines 361, 587)
+        bool tilt_just_changed = (macro_tilt != last_flip_tilt);
+        if (tilt_just_changed) {
+            flip_dates.push_back(i);
+        }
+        while (!flip_dates.empty() &&
+               static_cast<size_t>(flip_dates.front()) < TradingCalendar::trailing_year_begin(i))
+            flip_dates.pop_front();
+        int flips_trailing_year = static_cast<int>(flip_dates.size());
+
+        // ============================================================
+        // Layer 2: Regime Classifier
+        // ============================================================
+        double growth = std::isnan(in.spx_mom) ? 0.0 : in.spx_mom;
+        double inflation = std::isnan(in.be_chg) ? 0.0 : in.be_chg;
+
+        // EXACT from outline lines 175-179:
+        // Composite liquidity indicator = normalize(
+        //    -1 * VIX_percentile_60d +              # from vix.csv
+        //    -1 * high_yield_spread_zscore +        # from high_yield_spread.csv
+        //    fed_balance_sheet_growth_yoy           # from fed_balance_sheet.csv
+        // )
+
+        // Calculate VIX percentile (60-day)
+        double vix_percentile = 0.0;
+        if (i >= 60 && !std::isnan(in.vix_pct60)) vix_percentile = in.vix_pct60;
+
+        // High yield spread z-score (already computed as hy_z60)
+        double hy_zscore = std::isnan(in.hy_z) ? 0.0 : in.hy_z;
+
+        // Fed balance sheet YoY growth (already computed as fed_bs_yoy)
+
+        // Normalize components (simplified normalization: scale each to approx -3 to +3 range)
+        // Composite liquidity indicator per outline lines 217-222:
+        // normalize(-1*VIX_percentile_60d + -1*HY_spread_zscore + fed_bs_yoy) / 3
+        // All three components z-scored for comparable scale
+        // Doc: normalize the sum of three components, not pre-z-score each
+        // fed_bs_yoy is already a ratio (e.g. 0.15 = 15% YoY growth)
+        // Scale it to be comparable to the other components (approx -3 to +3)
+        double fbs_raw       = std::isnan(in.fed_bs_yoy) ? 0.0 : in.fed_bs_yoy;
+        double vix_component = -1.0 * (vix_percentile * 6.0 - 3.0);
+        double hy_component  = -1.0 * hy_zscore;
+        double fbs_component = fbs_raw * 10.0;  // scale: 0.3 YoY growth -> +3.0
+        double liquidity = (vix_component + hy_component + fbs_component) / 3.0;
+
+        double rr_val = std::isnan(in.real_rate) ? 0.0 : in.real_rate;
+        double rr_chg_val = std::isnan(in.rr_chg) ? 0.0 : in.rr_chg;
+        double rr_z_val = std::isnan(in.rr_z) ? 0.0 : in.rr_z;
+
+        Regime regime = Regime::NEUTRAL;
+        if (liquidity < p_.liquidity_thresh) {
+            regime = Regime::LIQUIDITY_SHOCK;
+        } else if (inflation > 0.10 && growth < 0.5) {
+            regime = Regime::INFLATION_SHOCK;
+        } else if (growth > 0.5) {
+            regime = Regime::GROWTH_POSITIVE;
+        } else if (growth < -0.5) {
+            regime = Regime::GROWTH_NEGATIVE;
+        }
 
-            // Minimum holding period
-            MacroTilt macro_tilt = prev_tilt;
-            if (raw_tilt != prev_tilt) {
-                if (raw_tilt != pending_tilt) {
-                    pending_tilt = raw_tilt;
-                    pending_count = 1;
+        // DEBUG: count inflation shock days
+        if (regime == Regime::INFLATION_SHOCK) infl_shock_days++;
+
+        // DEBUG: Track regime changes (your existing code, keep it)
+        if (regime != ss.last_debug_regime && in.day >= LIQ_DEBUG_FROM) {
+            ss.last_debug_regime = regime;
+        }
+
+        // ============================================================
+        // Layer 3: DXY Filter
+        // ============================================================
+        DXYTrend dxy_trend = DXYTrend::NEUTRAL;
+        if (!std::isnan(in.dxy) && !std::isnan(in.dxy_sma50) && !std::isnan(in.dxy_sma200)) {
+            if (in.dxy > in.dxy_sma50 && in.dxy_sma50 > in.dxy_sma200)
+                dxy_trend = DXYTrend::STRONG;
+            else if (in.dxy < in.dxy_sma50 && in.dxy_sma50 < in.dxy_sma200)
+                dxy_trend = DXYTrend::WEAK;
+        }
+
+        double dxy_mom = in.dxy_mom;
+
+        DXYFilter dxy_filter = DXYFilter::NEUTRAL;
+        // Lines 657-664 - CURRENT CODE:
+        // EXACT from outline lines 160-169 (DXY Filter Rules table):
+        if (!std::isnan(dxy_mom)) {
+            if (dxy_mom > p_.dxy_mom_thresh) {  // DXY momentum > +3%
+                if (macro_tilt == MacroTilt::RISK_ON) {
+                    dxy_filter = DXYFilter::SUSPECT;      // "Suspect - may be USD squeeze, not growth. Reduce size 50%"
+                } else if (macro_tilt == MacroTilt::RISK_OFF) {
+                    dxy_filter = DXYFilter::CONFIRMED;    // "Confirmed risk-off + USD strength. Full risk-off"
                 } else {
-                    pending_count++;
+                    dxy_filter = DXYFilter::NEUTRAL;
                 }
-                if (pending_count >= p_.min_hold_days) {
-                    prev_tilt = pending_tilt;
-                    macro_tilt = pending_tilt;
-                    pending_count = 0;
+            } else if (dxy_mom < -p_.dxy_mom_thresh) {  // DXY momentum < -3%
+                if (macro_tilt == MacroTilt::RISK_ON) {
+                    dxy_filter = DXYFilter::CONFIRMED;    // "Confirmed risk-on + USD weakness. Full risk-on"
+                } else if (macro_tilt == MacroTilt::RISK_OFF) {
+                    dxy_filter = DXYFilter::SUSPECT;      // "Suspect - may be inflation/gold bid. Check regime classifier"
+                } else {
+                    dxy_filter = DXYFilter::NEUTRAL;
                 }
             } else {
-                pending_tilt = raw_tilt;
-                pending_count = 0;
-                macro_tilt = prev_tilt;
-            }
-
-            // ============================================================
-            // Signal Stability Check (doc line 125, 357, 587, 607)
-            // "signal should not flip more than 8-12x per year"
-            // ============================================================
-            // Track flips in trailing 252-day window (1 trading year)
-            // We record flip dates in a deque and count those within 252 days
-            auto& flip_dates = flip_dates_deque;
-            // Capture tilt_just_changed BEFORE any mutation, so it can be reused
-            // for rebalance detection later in the same iteration (outline lines 361, 587)
-            bool tilt_just_changed = (macro_tilt != last_flip_tilt);
-            if (tilt_just_changed) {
-                flip_dates.push_back(i);
+                dxy_filter = DXYFilter::NEUTRAL;          // "DXY neutral. Trust Cu/Gold signal at full size"
             }
-            while (!flip_dates.empty() && (i - flip_dates.front()) > 252)
-                flip_dates.pop_front();
-            int flips_trailing_year = static_cast<int>(flip_dates.size());
+        }
 
-            // ============================================================
-            // Layer 2: Regime Classifier
-            // ============================================================
-            double growth = std::isnan(spx_mom[i]) ? 0.0 : spx_mom[i];
-            double inflation = std::isnan(be_chg[i]) ? 0.0 : be_chg[i];
-
-            // EXACT from outline lines 175-179:
-            // Composite liquidity indicator = normalize(
-            //    -1 * VIX_percentile_60d +              # from vix.csv
-            //    -1 * high_yield_spread_zscore +        # from high_yield_spread.csv
-            //    fed_balance_sheet_growth_yoy           # from fed_balance_sheet.csv
-            // )
-
-            // Calculate VIX percentile (60-day)
-            double vix_percentile = 0.0;
-            if (i >= 60) {
-                std::vector<double> vix_window;
-                for (int k = i - 59; k <= i; ++k) {
-                    if (!std::isnan(vix[k])) vix_window.push_back(vix[k]);
-                }
-                if (!vix_window.empty()) {
-                    std::sort(vix_window.begin(), vix_window.end());
-                    double current_vix = vix[i];
-                    auto it = std::lower_bound(vix_window.begin(), vix_window.end(), current_vix);
-                    int rank = std::distance(vix_window.begin(), it);
-                    vix_percentile = static_cast<double>(rank) / vix_window.size();
-                }
-            }
+        // Safe-haven override
+        bool skip_gold_short = false;
+        if (i > 0 && !std::isnan(in.vix) && !std::isnan(in.gc) && !std::isnan(in.gc_prev) && !std::isnan(in.spx) && !std::isnan(in.spx_prev)) {
+            double vix90 = in.vix_q90;
+            double gold_ret = (in.gc / in.gc_prev) - 1.0;
+            double eq_ret = (in.spx / in.spx_prev) - 1.0;
+            if (!std::isnan(vix90) && in.vix > vix90 && gold_ret > 0.015 && eq_ret < -0.015)
+                skip_gold_short = true;
+        }
 
-            // High yield spread z-score (already computed as hy_z60)
-            double hy_zscore = std::isnan(hy_z60[i]) ? 0.0 : hy_z60[i];
-
-            // Fed balance sheet YoY growth (already computed as fed_bs_yoy)
-
-            // Normalize components (simplified normalization: scale each to approx -3 to +3 range)
-            // Composite liquidity indicator per outline lines 217-222:
-            // normalize(-1*VIX_percentile_60d + -1*HY_spread_zscore + fed_bs_yoy) / 3
-            // All three components z-scored for comparable scale
-            // Doc: normalize the sum of three components, not pre-z-score each
-            // fed_bs_yoy is already a ratio (e.g. 0.15 = 15% YoY growth)
-            // Scale it to be comparable to the other components (approx -3 to +3)
-            double fbs_raw       = std::isnan(fed_bs_yoy[i]) ? 0.0 : fed_bs_yoy[i];
-            double vix_component = -1.0 * (vix_percentile * 6.0 - 3.0);
-            double hy_component  = -1.0 * hy_zscore;
-            double fbs_component = fbs_raw * 10.0;  // scale: 0.3 YoY growth -> +3.0
-            double liquidity = (vix_component + hy_component + fbs_component) / 3.0;
-
-            // DEBUG: Print liquidity values around Nov 2014
-            if (dates[i] >= parse_date("2014-11-01") && dates[i] <= parse_date("2014-12-31")) {
-                std::cout << date_from_int(dates[i])
-                          << " liquidity: " << liquidity
-                          << " vix_comp: " << vix_component
-                          << " hy_comp: " << hy_component
-                          << " fbs_comp: " << fbs_component
-                          << " thresh: " << p_.liquidity_thresh << "\n";
-            }
+        // China filter
+        double china_adj = 1.0;
+        if (p_.use_china_filter && !std::isnan(in.china_cli) && !std::isnan(in.china_sma65)) {
+            if ((in.china_cli - in.china_sma65) < p_.china_cli_thresh)
+                china_adj = 0.7;
+        }
 
-            double rr_val = std::isnan(real_rate[i]) ? 0.0 : real_rate[i];
-            double rr_chg_val = std::isnan(rr_chg[i]) ? 0.0 : rr_chg[i];
-            double rr_z_val = std::isnan(rr_zscore[i]) ? 0.0 : rr_zscore[i];
-
-            Regime regime = Regime::NEUTRAL;
-            if (liquidity < p_.liquidity_thresh) {
-                regime = Regime::LIQUIDITY_SHOCK;
-            } else if (inflation > 0.10 && growth < 0.5) {
-                regime = Regime::INFLATION_SHOCK;
-            } else if (growth > 0.5) {
-                regime = Regime::GROWTH_POSITIVE;
-            } else if (growth < -0.5) {
-                regime = Regime::GROWTH_NEGATIVE;
-            }
+        // BOJ intervention
+        bool boj_int = false;
+        if (i > 0 && !std::isnan(in.jy) && !std::isnan(in.jy_prev) && in.jy_prev > 0.0) {
+            if (std::abs((in.jy / in.jy_prev) - 1.0) > p_.boj_move_thresh)
+                boj_int = true;
+        }
 
-            // DEBUG: breakeven units check
-            if (i % 252 == 0) {
-                std::cout << "[BE_CHECK] " << date_from_int(dates[i])
-                          << " breakeven=" << breakeven[i]
-                          << " be_chg_20d=" << (std::isnan(be_chg[i]) ? 0.0 : be_chg[i])
-                          << " growth=" << growth
-                          << " inflation_check=" << (inflation > 0.10 && growth < 0.5)
-                          << "\n";
-            }
+        // Correlation spike
+        bool corr_spike = false;
+        if (in.avg_corr > p_.corr_thresh)
+            corr_spike = true;
 
-            // DEBUG: count inflation shock days
-            if (regime == Regime::INFLATION_SHOCK) infl_shock_days++;
+        // ============================================================
+        // Size Multiplier (EXACT from doc)
+        // ============================================================
+        double size_mult = 1.0;
+
+        if (regime == Regime::LIQUIDITY_SHOCK) {
+            size_mult = 0.0;
+        } else if (macro_tilt == MacroTilt::RISK_ON && regime == Regime::GROWTH_NEGATIVE) {
+            size_mult = 0.5;
+        } else if (regime == Regime::NEUTRAL) {
+            size_mult = 0.5;
+        } else if (regime == Regime::INFLATION_SHOCK) {
+            size_mult = 0.5;
+        }
 
-            // DEBUG: Track regime changes (your existing code, keep it)
-            static Regime last_debug_regime = Regime::NEUTRAL;
-            if (regime != last_debug_regime && dates[i] >= parse_date("2014-11-01")) {
-                last_debug_regime = regime;
-            }
+        if (dxy_filter == DXYFilter::SUSPECT)
+            size_mult *= 0.5;
 
-            // ============================================================
-            // Layer 3: DXY Filter
-            // ============================================================
-            DXYTrend dxy_trend = DXYTrend::NEUTRAL;
-            if (!std::isnan(dxy[i]) && !std::isnan(dxy_sma50[i]) && !std::isnan(dxy_sma200[i])) {
-                if (dxy[i] > dxy_sma50[i] && dxy_sma50[i] > dxy_sma200[i])
-                    dxy_trend = DXYTrend::STRONG;
-                else if (dxy[i] < dxy_sma50[i] && dxy_sma50[i] < dxy_sma200[i])
-                    dxy_trend = DXYTrend::WEAK;
-            }
+        if (liquidity < p_.liquidity_thresh)
+            size_mult *= 0.25;
 
-            double dxy_mom = std::numeric_limits<double>::quiet_NaN();
-            if (i >= p_.dxy_mom_window && !std::isnan(dxy[i]) && !std::isnan(dxy[i - p_.dxy_mom_window]) && dxy[i - p_.dxy_mom_window] > 0.0)
-                dxy_mom = (dxy[i] / dxy[i - p_.dxy_mom_window]) - 1.0;
-
-            DXYFilter dxy_filter = DXYFilter::NEUTRAL;
-            // Lines 657-664 - CURRENT CODE:
-            // EXACT from outline lines 160-169 (DXY Filter Rules table):
-            if (!std::isnan(dxy_mom)) {
-                if (dxy_mom > p_.dxy_mom_thresh) {  // DXY momentum > +3%
-                    if (macro_tilt == MacroTilt::RISK_ON) {
-                        dxy_filter = DXYFilter::SUSPECT;      // "Suspect - may be USD squeeze, not growth. Reduce size 50%"
-                    } else if (macro_tilt == MacroTilt::RISK_OFF) {
-                        dxy_filter = DXYFilter::CONFIRMED;    // "Confirmed risk-off + USD strength. Full risk-off"
-                    } else {
-                        dxy_filter = DXYFilter::NEUTRAL;
-                    }
-                } else if (dxy_mom < -p_.dxy_mom_thresh) {  // DXY momentum < -3%
-                    if (macro_tilt == MacroTilt::RISK_ON) {
-                        dxy_filter = DXYFilter::CONFIRMED;    // "Confirmed risk-on + USD weakness. Full risk-on"
-                    } else if (macro_tilt == MacroTilt::RISK_OFF) {
-                        dxy_filter = DXYFilter::SUSPECT;      // "Suspect - may be inflation/gold bid. Check regime classifier"
-                    } else {
-                        dxy_filter = DXYFilter::NEUTRAL;
-                    }
-                } else {
-                    dxy_filter = DXYFilter::NEUTRAL;          // "DXY neutral. Trust Cu/Gold signal at full size"
-                }
-            }
+        if (corr_spike)
+            size_mult *= 0.5;
 
-            // Safe-haven override
-            bool skip_gold_short = false;
-            if (i > 0 && !std::isnan(vix[i]) && !std::isnan(gc[i]) && !std::isnan(gc[i-1]) && !std::isnan(spx[i]) && !std::isnan(spx[i-1])) {
-                double vix90 = std::numeric_limits<double>::quiet_NaN();
-                if (i >= 59) {
-                    std::vector<double> vix_window;
-                    for (int k = i - 59; k <= i; ++k)
-                        if (!std::isnan(vix[k])) vix_window.push_back(vix[k]);
-                    if (!vix_window.empty()) {
-                        std::sort(vix_window.begin(), vix_window.end());
-                        int idx = (int)(0.90 * vix_window.size());
-                        if (idx >= (int)vix_window.size()) idx = (int)vix_window.size() - 1;
-                        vix90 = vix_window[idx];
-                    }
-                }
-                double gold_ret = (gc[i] / gc[i-1]) - 1.0;
-                double eq_ret = (spx[i] / spx[i-1]) - 1.0;
-                if (!std::isnan(vix90) && vix[i] > vix90 && gold_ret > 0.015 && eq_ret < -0.015)
-                    skip_gold_short = true;
-            }
+        size_mult *= china_adj;
 
-            // China filter
-            double china_adj = 1.0;
-            if (p_.use_china_filter && !std::isnan(china_cli[i]) && !std::isnan(china_sma65[i])) {
-                if ((china_cli[i] - china_sma65[i]) < p_.china_cli_thresh)
-                    china_adj = 0.7;
+        // ============================================================
+        // Rebalance triggers on the signal path
+        // ============================================================
+        bool is_friday = in.is_friday;
+        // Regime change confirmed by a 3-day debounce
+        if (regime != prev_regime) {
+            if (regime == pending_regime) {
+                pending_regime_count++;
+            } else {
+                pending_regime = regime;
+                pending_regime_count = 1;
             }
+        } else {
+            pending_regime = regime;
+            pending_regime_count = 0;
+        }
+        bool regime_changed = (pending_regime_count >= 3);
+        bool filter_triggered = (dxy_filter == DXYFilter::SUSPECT && prev_dxy_filter != DXYFilter::SUSPECT);
+
+        prev_regime     = regime;
+        prev_dxy_filter = dxy_filter;
+        // last_flip_tilt tracks the confirmed macro_tilt from previous day exactly
+        last_flip_tilt  = macro_tilt;
+
+        // SI volatility adjustment
+        double si_adj = std::numeric_limits<double>::quiet_NaN();
+        if (!std::isnan(in.gc_atr) && !std::isnan(in.si_atr) && in.si_atr > 0.0) {
+            double gc_dollar_atr = in.gc_atr * 100.0;
+            double si_dollar_atr = in.si_atr * 5000.0;
+            if (si_dollar_atr > 0.0)
+                si_adj = gc_dollar_atr / si_dollar_atr;
+        }
 
-            // BOJ intervention
-            bool boj_int = false;
-            if (i > 0 && !std::isnan(jy[i]) && !std::isnan(jy[i-1]) && jy[i-1] > 0.0) {
-                if (std::abs((jy[i] / jy[i-1]) - 1.0) > p_.boj_move_thresh)
-                    boj_int = true;
-            }
+        // ============================================================
+        // Save signal
+        // ============================================================
+        SignalDay d;
+        d.row = i;
+        d.is_friday = is_friday;
+        d.regime_changed = regime_changed;
+        d.filter_triggered = filter_triggered;
+        d.tilt_changed = tilt_just_changed;
+        d.si_adj = si_adj;
+        d.breakeven = in.breakeven;
+        d.vix_component = vix_component;
+        d.hy_component = hy_component;
+        d.fbs_component = fbs_component;
+
+        DailySignal& sig = d.sig;
+        sig.day = in.day;
+        sig.cu_gold_ratio = in.ratio;
+        sig.roc_10 = std::isnan(roc10) ? 0.0 : roc10;
+        sig.roc_20 = std::isnan(roc20) ? 0.0 : roc20;
+        sig.roc_60 = std::isnan(roc60) ? 0.0 : roc60;
+        sig.signal_ma = signal_ma;
+        sig.ratio_zscore = std::isnan(zscore) ? 0.0 : zscore;
+        sig.signal_z = signal_z;
+        sig.composite = std::isnan(composite) ? 0.0 : composite;
+        sig.macro_tilt = macro_tilt;
+
+        sig.growth_signal = growth;
+        sig.inflation_signal = inflation;
+        sig.liquidity_score = liquidity;
+        sig.real_rate_10y = rr_val;
+        sig.real_rate_chg_20d = rr_chg_val;
+        sig.real_rate_zscore = rr_z_val;
+        sig.regime = regime;
+
+        sig.dxy_momentum = std::isnan(dxy_mom) ? 0.0 : dxy_mom;
+        sig.dxy_trend = dxy_trend;
+        sig.dxy_filter = dxy_filter;
+        sig.skip_gold_short = skip_gold_short;
+        sig.china_adjustment = china_adj;
+        sig.boj_intervention = boj_int;
+        sig.corr_spike_active = corr_spike;
+
+        sig.size_multiplier = size_mult;   // before drawdown scaling
+        sig.signal_flips_trailing_year = flips_trailing_year;
+        sig.spx_price = std::isnan(in.spx) ? 0.0 : in.spx;
+        return d;
+    }
 
-            // Correlation spike
-            bool corr_spike = false;
-            if (avg_pairwise_corr(all_rets, i, p_.corr_window) > p_.corr_thresh)
-                corr_spike = true;
+    // Phase 2: replays a signal pipeline under this instance's risk and
+    // sizing params: P&L, ATR stops, drawdown, sizing, caps and costs.
+    // The pipeline's event index names the scheduled rebalances. Every day
+    // is marked to market (P&L, ATR stops, drawdown); only event days and
+    // days the marking forces (drawdown scaling, a flat book that should
+    // trade) go on to sizing. The rest carry the book straight into the
+    // table, with margin utilisation from RunState's cached held margin.
+    SignalTable simulate(const SignalPipeline& sp) const {
+        SignalTable signals;
+        signals.reserve(sp.days.size());
+        RunState st(p_.initial_capital);
+        simulate(sp, 0, sp.days.size(), st, signals);
+        return signals;
+    }
 
-            // ============================================================
-            // Size Multiplier (EXACT from doc)
-            // ============================================================
-            double size_mult = 1.0;
-
-            if (regime == Regime::LIQUIDITY_SHOCK) {
-                size_mult = 0.0;
-            } else if (macro_tilt == MacroTilt::RISK_ON && regime == Regime::GROWTH_NEGATIVE) {
-                size_mult = 0.5;
-            } else if (regime == Regime::NEUTRAL) {
-                size_mult = 0.5;
-            } else if (regime == Regime::INFLATION_SHOCK) {
-                size_mult = 0.5;
+    // Simulates signal days [first, last) of `sp` on the book `st`,
+    // appending to `out`. Walk-forward folds replay slices of one pipeline
+    // this way; the signal path before `first` is already in `sp`.
+    void simulate(const SignalPipeline& sp, size_t first, size_t last,
+                  RunState& st, SignalTable& out) const {
+        DayMarks m;
+        auto next_event = std::lower_bound(sp.events.begin(), sp.events.end(), first);
+        for (size_t k = first; k < last; ++k) {
+            const SignalDay& d = sp.days[k];
+            const int i = d.row;
+            for (InstrumentId id : Inst::ALL) {
+                m.close[id] = sp.close[id][i];
+                m.prev_close[id] = (i > 0) ? sp.close[id][i-1] : std::numeric_limits<double>::quiet_NaN();
+                m.stop_atr[id] = sp.stop_atr[id][i];
             }
+            const bool scheduled = next_event != sp.events.end() && *next_event == k;
+            if (scheduled) ++next_event;
+            DayRisk r;
+            if (mark_to_market(d, m, sp.date_strs[i], scheduled, st, r))
+                out.append(rebalance(d, m, sp.date_strs[i], r, st));
+            else
+                out.append_carry(d.sig, r.size_mult, st.positions, st.equity, carry_margin(st),
+                                 r.dd_warn, r.dd_stop);
+        }
+    }
 
-            if (dxy_filter == DXYFilter::SUSPECT)
-                size_mult *= 0.5;
+    // Day-local risk state left by mark_to_market() for the rebalance
+    struct DayRisk {
+        double size_mult = 1.0;          // after drawdown scaling
+        bool dd_warn = false, dd_stop = false;
+        PerInstrument<bool> stopped_out_today{};
+    };
+
+    // One day of the simulator: marks the book to `m`, applies stops and
+    // drawdown scaling, rebalances when scheduled or triggered and returns
+    // the day's signal with its portfolio fields filled. Used by the
+    // streaming engine; simulate() runs the two halves itself.
+    DailySignal portfolio_step(const SignalDay& d, const DayMarks& m,
+                               const std::string& date_str, bool scheduled,
+                               RunState& st) const {
+        DayRisk r;
+        if (mark_to_market(d, m, date_str, scheduled, st, r))
+            return rebalance(d, m, date_str, r, st);
+        return with_book(d.sig, r, st, carry_margin(st));
+    }
 
-            if (liquidity < p_.liquidity_thresh)
-                size_mult *= 0.25;
+    // Margin utilisation of a carried book
+    static double carry_margin(const RunState& st) {
+        return (st.equity > 0.0) ? st.held_margin / st.equity : 0.0;
+    }
 
-            if (corr_spike)
-                size_mult *= 0.5;
+    // The day's signal fields with the book's portfolio fields on top
+    static DailySignal with_book(const DailySignal& s, const DayRisk& r, const RunState& st,
+                                 double margin_util) {
+        DailySignal sig = s;
+        sig.size_multiplier = r.size_mult;
+        sig.target_contracts = st.positions;
+        sig.portfolio_equity = st.equity;
+        sig.margin_utilization = margin_util;
+        sig.drawdown_warning = r.dd_warn;
+        sig.drawdown_stop = r.dd_stop;
+        return sig;
+    }
 
-            size_mult *= china_adj;
-        std::unordered_set<std::string> stopped_out_today;
+    // First half of a day: P&L, ATR stops and drawdown scaling on `st`.
+    // True when the day rebalances, i.e. it is scheduled or the marking
+    // forces one; `r` carries the day's risk state into rebalance().
+    bool mark_to_market(const SignalDay& d, const DayMarks& m, const std::string& date_str,
+                        bool scheduled, RunState& st, DayRisk& r) const {
+        double& equity      = st.equity;
+        double& peak_equity = st.peak_equity;
+        double& last_equity_debug = st.last_equity_debug;
 
-            // ============================================================
-            // P&L Calculation
-            // ============================================================
-            if (i > 0) {
-                double daily_pnl = 0.0;
-                for (const auto& [sym, qty] : positions) {
-                    if (qty == 0.0) continue;
-                    const auto* px = px_map[sym];
-                    if (!px || std::isnan((*px)[i]) || std::isnan((*px)[i-1])) continue;
-                    double pv = POINT_VALUE.count(sym) ? POINT_VALUE.at(sym) : 0.0;
-                    double price_change = (*px)[i] - (*px)[i-1];
-                    daily_pnl += qty * price_change * pv;
-                }
+        // Track positions and entry prices
+        PerInstrument<double>& positions    = st.positions;
+        PerInstrument<double>& entry_prices = st.entry_prices;
+
+        const int i = d.row;
+        const DailySignal& s = d.sig;
+
+        // Signal-side debug lines, replayed here so they interleave with
+        // the day's portfolio lines exactly as a single pass printed them
+        if (s.day >= LIQ_DEBUG_FROM && s.day <= LIQ_DEBUG_TO) {
+            CG_LOG(DEBUG, LIQUIDITY, date_str
+                      << " liquidity: " << s.liquidity_score
+                      << " vix_comp: " << d.vix_component
+                      << " hy_comp: " << d.hy_component
+                      << " fbs_comp: " << d.fbs_component
+                      << " thresh: " << p_.liquidity_thresh << "\n");
+        }
+        if (i % TradingCalendar::TRADING_YEAR == 0) {
+            CG_LOG(DEBUG, BE_CHECK, "[BE_CHECK] " << date_str
+                      << " breakeven=" << d.breakeven
+                      << " be_chg_20d=" << s.inflation_signal
+                      << " growth=" << s.growth_signal
+                      << " inflation_check=" << (s.inflation_signal > 0.10 && s.growth_signal < 0.5)
+                      << "\n");
+        }
 
-                // Position-level stop: exit if position loss > 2 * ATR(20)
-                // ATR is available for GC and SI; for others use a 20-day price std proxy
-                for (auto& [sym, qty] : positions) {
-                    if (qty == 0.0) continue;
-                    const auto* px = px_map[sym];
-                    if (!px || std::isnan((*px)[i])) continue;
-                    double pv = POINT_VALUE.count(sym) ? POINT_VALUE.at(sym) : 0.0;
-
-                    // Compute 20-day ATR for this symbol from price series
-                    double atr20 = std::numeric_limits<double>::quiet_NaN();
-                    if (i >= 20) {
-                        double tr_sum = 0.0;
-                        int tr_count = 0;
-                        for (int k = i - 19; k <= i; ++k) {
-                            auto it = fut_[sym].find(dates[k]);
-                            if (it == fut_[sym].end()) continue;
-                            auto it_prev = fut_[sym].lower_bound(dates[k]);
-                            if (it_prev == fut_[sym].begin()) continue;
-                            --it_prev;
-                            double pc = it_prev->second.close;
-                            double hi = it->second.high;
-                            double lo = it->second.low;
-                            tr_sum += std::max({hi - lo, std::abs(hi - pc), std::abs(lo - pc)});
-                            tr_count++;
-                        }
-                        if (tr_count > 0) atr20 = tr_sum / tr_count;
-                    }
+        double& size_mult = r.size_mult;
+        size_mult = s.size_multiplier;
+        PerInstrument<bool>& stopped_out_today = r.stopped_out_today;
+        bool any_stopped = false;
+
+        // ============================================================
+        // P&L Calculation
+        // ============================================================
+        if (i > 0) {
+            double daily_pnl = 0.0;
+            for (InstrumentId id : Inst::ALL) {
+                double qty = positions[id];
+                if (qty == 0.0) continue;
+                if (std::isnan(m.close[id]) || std::isnan(m.prev_close[id])) continue;
+                double pv = Inst::POINT_VALUE[id];
+                double price_change = m.close[id] - m.prev_close[id];
+                daily_pnl += qty * price_change * pv;
+            }
 
-                    if (!std::isnan(atr20) && atr20 > 0.0) {
-                        double entry_px = entry_prices.count(sym) ? entry_prices.at(sym) : std::numeric_limits<double>::quiet_NaN();
-                        if (!std::isnan(entry_px)) {
-                            double dollar_atr = atr20 * std::abs(qty) * pv;
-                            double position_dollar_loss = -(qty * ((*px)[i] - entry_px) * pv);
-                            if (position_dollar_loss > 2.0 * dollar_atr) {
-                                qty = 0.0;
-                                entry_prices[sym] = std::numeric_limits<double>::quiet_NaN();
-                                stopped_out_today.insert(sym);
-                            }
+            // Position-level stop: exit if position loss > 2 * ATR(20)
+            // ATR is available for GC and SI; for others use a 20-day price std proxy
+            for (InstrumentId id : Inst::ALL) {
+                double& qty = positions[id];
+                if (qty == 0.0) continue;
+                if (std::isnan(m.close[id])) continue;
+                double pv = Inst::POINT_VALUE[id];
+
+                double atr20 = (i >= 20) ? m.stop_atr[id]
+                                         : std::numeric_limits<double>::quiet_NaN();
+
+                if (!std::isnan(atr20) && atr20 > 0.0) {
+                    double entry_px = entry_prices[id];
+                    if (!std::isnan(entry_px)) {
+                        double dollar_atr = atr20 * std::abs(qty) * pv;
+                        double position_dollar_loss = -(qty * (m.close[id] - entry_px) * pv);
+                        if (position_dollar_loss > 2.0 * dollar_atr) {
+                            qty = 0.0;
+                            entry_prices[id] = std::numeric_limits<double>::quiet_NaN();
+                            stopped_out_today[id] = true;
+                            any_stopped = true;
                         }
                     }
                 }
+            }
+            if (any_stopped) st.held_margin = margin_held(positions);
+
+
+
+            equity += daily_pnl;
+
+            if (daily_pnl > 10000 || daily_pnl < -10000) {
+                CG_LOG(DEBUG, EQUITY, "        Post-equity: $" << equity << "\n");
+            }
+
+            if (equity > peak_equity) peak_equity = equity;
 
 
+            // Add sanity check
+            if (equity > last_equity_debug * 1.5 || equity < last_equity_debug * 0.5) {
+                CG_LOG(WARN, EQUITY, "[WARN] Unusual equity change: "
+                          << last_equity_debug << " -> " << equity << "\n");
+            }
+            last_equity_debug = equity;
+        }
+
+        // Drawdown stops
+        bool& dd_warn = r.dd_warn;
+        bool& dd_stop = r.dd_stop;
+        double drawdown = (peak_equity > 0.0) ? (peak_equity - equity) / peak_equity : 0.0;
+        if (drawdown > p_.drawdown_stop) {
+            size_mult = 0.0;
+            dd_stop = true;
+        } else if (drawdown > p_.drawdown_warn) {
+            size_mult *= 0.5;
+            dd_warn = true;
+        }
+        if (dd_stop && all_positions_zero(positions)) {
+            peak_equity = equity;
+        }
+        if (dd_stop || dd_warn) {
+            CG_LOG(INFO, DRAWDOWN, "[DD] " << date_str
+                      << " equity=" << equity
+                      << " peak=" << peak_equity
+                      << " dd=" << drawdown
+                      << " stop=" << dd_stop
+                      << " warn=" << dd_warn << "\n");
+        }
 
-                equity += daily_pnl;
+        // ============================================================
+        // POSITION SIZING
+        // Doc line 365: "Weekly rebalance check (Fridays)"
+        // Positions only change on:
+        //   1. Friday (weekly calendar rebalance)
+        //   2. Signal flip (composite crosses threshold) — macro_tilt changed
+        //   3. Regime change (classifier changed state)
+        //   4. Filter trigger (DXY or liquidity hits threshold)
+        //   5. Stop-loss triggered (drawdown or ATR stop)
+        // ============================================================
+        // Determine if today is a rebalance day
+        bool stop_triggered = dd_stop || dd_warn;
+        bool do_rebalance = scheduled || stop_triggered;
+
+        if (do_rebalance) {
+            CG_LOG(INFO, REBALANCE, "[REB] " << date_str
+                      << " fri=" << d.is_friday
+                      << " regime=" << d.regime_changed
+                      << " filter=" << d.filter_triggered
+                      << " stop=" << stop_triggered
+                      << " tilt=" << d.tilt_changed
+                      << " flat=" << all_positions_zero(positions)
+                      << " size_mult=" << size_mult
+                      << " dd=" << drawdown
+                      << "\n");
 
-                if (daily_pnl > 10000 || daily_pnl < -10000) {
-                    std::cout << "        Post-equity: $" << equity << "\n";
-                }
+        }
 
-                if (equity > peak_equity) peak_equity = equity;
+        // FORCE REBALANCE if we have no positions but size_mult says we should trade
+        if (!do_rebalance && size_mult > 0.0 && all_positions_zero(positions)) {
+            do_rebalance = true;
+        }
 
+        return do_rebalance;
+    }
 
-                // Add sanity check
-                if (equity > last_equity_debug * 1.5 || equity < last_equity_debug * 0.5) {
-                    std::cout << "[WARN] Unusual equity change: "
-                              << last_equity_debug << " -> " << equity << "\n";
+    // Second half of a rebalance day: sizes the target book from the day's
+    // signal and `r`, applies caps, margin and stops, trades to it and
+    // charges costs.
+    DailySignal rebalance(const SignalDay& d, const DayMarks& m, const std::string& date_str,
+                          const DayRisk& r, RunState& st) const {
+        double& equity = st.equity;
+        PerInstrument<double>& positions    = st.positions;
+        PerInstrument<double>& entry_prices = st.entry_prices;
+
+        const DailySignal& s = d.sig;
+        const MacroTilt macro_tilt = s.macro_tilt;
+        const Regime    regime     = s.regime;
+        const double    china_adj  = s.china_adjustment;
+        const double    si_adj     = d.si_adj;
+        const bool skip_gold_short = s.skip_gold_short;
+        const bool boj_int         = s.boj_intervention;
+        const double size_mult     = r.size_mult;
+        const PerInstrument<bool>& stopped_out_today = r.stopped_out_today;
+
+        PerInstrument<double> new_positions{};
+        // Legs that were given a target this rebalance. Fixed test mode sets
+        // none on a NEUTRAL tilt; those legs are dropped without costs, as
+        // with the string-keyed map.
+        PerInstrument<bool> targeted;
+        targeted.fill(true);
+
+        double margin_util = 0.0;
+
+        if (!p_.use_fixed_positions) {
+            // FULL POSITION SIZING MODE
+
+            // Helper lambda for calculating contract sizes
+            auto contracts_for = [&](InstrumentId id,
+                                     double direction,
+                                     double vol_adj = 1.0) -> double {
+                if (std::abs(direction) < 1e-9 || std::abs(size_mult) < 1e-9)
+                    return 0.0;
+
+                double w = asset_weight(id);
+                double notional_alloc = equity * p_.leverage_target * w;
+                const auto& spec = ContractSpec::get(id);
+                double raw = (notional_alloc / spec.notional) * size_mult * vol_adj;
+                return std::floor(raw * direction + 0.5);
+            };
+
+            double boj_factor = boj_int ? 0.5 : 1.0;
+
+            // TRADE EXPRESSIONS - EXACT from doc
+            if (macro_tilt == MacroTilt::RISK_ON) {
+                if (regime == Regime::INFLATION_SHOCK) {
+                    new_positions[Inst::MES] = 0.0;
+                    new_positions[Inst::MNQ] = 0.0;
+                    new_positions[Inst::HG]  = contracts_for(Inst::HG, 1.0) * china_adj;
+                    new_positions[Inst::CL]  = contracts_for(Inst::CL, 1.0);
+                    new_positions[Inst::SI]  = std::isnan(si_adj) ? 0.0 : contracts_for(Inst::SI, 1.0, si_adj);
+                    new_positions[Inst::GC]  = skip_gold_short ? 0.0 : contracts_for(Inst::GC, -1.0);
+                    new_positions[Inst::ZN]  = contracts_for(Inst::ZN, -1.0);
+                    new_positions[Inst::UB]  = contracts_for(Inst::UB, -1.0);
+                    new_positions[Inst::JY]  = contracts_for(Inst::JY, -1.0) * boj_factor;
+                } else {
+                    new_positions[Inst::MES] = contracts_for(Inst::MES, 1.0);
+                    new_positions[Inst::MNQ] = contracts_for(Inst::MNQ, 1.0);
+                    new_positions[Inst::HG]  = contracts_for(Inst::HG,  1.0) * china_adj;
+                    new_positions[Inst::CL]  = contracts_for(Inst::CL,  1.0);
+                    new_positions[Inst::GC]  = skip_gold_short ? 0.0 : contracts_for(Inst::GC, -1.0);
+                    new_positions[Inst::SI]  = std::isnan(si_adj) ? 0.0 : contracts_for(Inst::SI,  1.0, si_adj);
+                    new_positions[Inst::ZN]  = contracts_for(Inst::ZN, -1.0);
+                    new_positions[Inst::UB]  = contracts_for(Inst::UB, -1.0);
+                    new_positions[Inst::JY]  = contracts_for(Inst::JY, -1.0) * boj_factor;
+                }
+            } else if (macro_tilt == MacroTilt::RISK_OFF) {
+                if (regime == Regime::INFLATION_SHOCK) {
+                    new_positions[Inst::GC]  = contracts_for(Inst::GC,  1.0);
+                    new_positions[Inst::ZN]  = contracts_for(Inst::ZN, -1.0);
+                    new_positions[Inst::UB]  = contracts_for(Inst::UB, -1.0);
+                    new_positions[Inst::MES] = contracts_for(Inst::MES, -0.5);
+                    new_positions[Inst::MNQ] = contracts_for(Inst::MNQ, -0.5);
+                    new_positions[Inst::HG]  = 0.0;
+                    new_positions[Inst::CL]  = 0.0;
+                    new_positions[Inst::SI]  = std::isnan(si_adj) ? 0.0 : contracts_for(Inst::SI,  1.0, si_adj);
+                    new_positions[Inst::JY]  = 0.0;
+                } else {
+                    new_positions[Inst::MES] = contracts_for(Inst::MES, -1.0);
+                    new_positions[Inst::MNQ] = contracts_for(Inst::MNQ, -1.0);
+                    new_positions[Inst::HG]  = contracts_for(Inst::HG,  -1.0);
+                    new_positions[Inst::CL]  = contracts_for(Inst::CL,  -1.0);
+                    new_positions[Inst::GC]  = contracts_for(Inst::GC,   1.0);
+                    new_positions[Inst::SI]  = std::isnan(si_adj) ? 0.0 : contracts_for(Inst::SI,   1.0, si_adj);
+                    new_positions[Inst::ZN]  = contracts_for(Inst::ZN,   1.0);
+                    new_positions[Inst::UB]  = contracts_for(Inst::UB,   1.0);
+                    new_positions[Inst::JY]  = contracts_for(Inst::JY,   1.0) * boj_factor;
                 }
-                last_equity_debug = equity;
-            }
-
-            // Drawdown stops
-            bool dd_warn = false, dd_stop = false;
-            double drawdown = (peak_equity > 0.0) ? (peak_equity - equity) / peak_equity : 0.0;
-            if (drawdown > p_.drawdown_stop) {
-                size_mult = 0.0;
-                dd_stop = true;
-            } else if (drawdown > p_.drawdown_warn) {
-                size_mult *= 0.5;
-                dd_warn = true;
-            }
-            if (dd_stop && all_positions_zero(positions)) {
-                peak_equity = equity;
-            }
-            if (dd_stop || dd_warn) {
-                std::cout << "[DD] " << date_from_int(dates[i])
-                          << " equity=" << equity
-                          << " peak=" << peak_equity
-                          << " dd=" << drawdown
-                          << " stop=" << dd_stop
-                          << " warn=" << dd_warn << "\n";
             }
+            // NEUTRAL: new_positions stays flat
 
             // ============================================================
-            // POSITION SIZING
-            // Doc line 365: "Weekly rebalance check (Fridays)"
-            // Positions only change on:
-            //   1. Friday (weekly calendar rebalance)
-            //   2. Signal flip (composite crosses threshold) — macro_tilt changed
-            //   3. Regime change (classifier changed state)
-            //   4. Filter trigger (DXY or liquidity hits threshold)
-            //   5. Stop-loss triggered (drawdown or ATR stop)
+            // POSITION LIMITS - EXACT from doc
             // ============================================================
-            // Determine if today is a rebalance day
-            bool is_friday = false;
-            {
-                time_t ts = static_cast<time_t>(dates[i]) * 86400;
-                std::tm* t = std::gmtime(&ts);
-                is_friday = (t->tm_wday == 5); // 0=Sun,1=Mon,...,5=Fri
-            }
-            // Track previous regime for change detection
-            Regime&    prev_regime     = prev_regime_state;
-            DXYFilter& prev_dxy_filter = prev_dxy_filter_state;
-            static Regime pending_regime = Regime::NEUTRAL;
-            static int pending_regime_count = 0;
-            if (regime != prev_regime) {
-                if (regime == pending_regime) {
-                    pending_regime_count++;
-                } else {
-                    pending_regime = regime;
-                    pending_regime_count = 1;
-                }
-            } else {
-                pending_regime = regime;
-                pending_regime_count = 0;
+            // Per-instrument notional cap
+
+
+            // Right after new_positions are calculated, before position limits
+            CG_LOG(INFO, SIZING, "[SIZING] " << date_str
+                      << " equity=" << equity
+                      << " size_mult=" << size_mult
+                      << " GC_raw=" << (equity * p_.leverage_target * 0.35 / 200000.0 * size_mult)
+                      << " GC_final=" << new_positions[Inst::GC]
+                      << " com_notional_before_cap="
+                      << (std::abs(new_positions[Inst::HG]) * 110000.0 +
+                          std::abs(new_positions[Inst::GC]) * 200000.0 +
+                          std::abs(new_positions[Inst::CL]) * 75000.0 +
+                          std::abs(new_positions[Inst::SI]) * 150000.0)
+                      << " com_cap=" << (equity * MAX_TOTAL_COMMODITY_NOTIONAL)
+                      << "\n");
+
+            for (InstrumentId id : Inst::ALL) {
+                double& qty = new_positions[id];
+                if (std::isnan(SINGLE_NOTIONAL_LIMIT[id])) continue;
+                double max_q = std::floor(equity * SINGLE_NOTIONAL_LIMIT[id] / ContractSpec::get(id).notional);
+                if (std::abs(qty) > max_q)
+                    qty = std::copysign(max_q, qty);
             }
-            bool regime_changed = (pending_regime_count >= 3);
-            bool filter_triggered = (dxy_filter == DXYFilter::SUSPECT && prev_dxy_filter != DXYFilter::SUSPECT);
-            bool stop_triggered   = dd_stop || dd_warn;
-            // last_flip_tilt tracks the confirmed macro_tilt from previous day exactly
-            bool tilt_changed = tilt_just_changed;
-
-            bool do_rebalance = is_friday || regime_changed || filter_triggered ||
-                    stop_triggered || tilt_changed;
-
-            if (do_rebalance) {
-                std::cout << "[REB] " << date_from_int(dates[i])
-                          << " fri=" << is_friday
-                          << " regime=" << regime_changed
-                          << " filter=" << filter_triggered
-                          << " stop=" << stop_triggered
-                          << " tilt=" << tilt_changed
-                          << " flat=" << all_positions_zero(positions)
-                          << " size_mult=" << size_mult        // ADD THIS
-                          << " dd=" << drawdown               // ADD THIS
-                          << "\n";
 
+            // Total directional equity cap
+            {
+                double eq_not = 0.0;
+                for (InstrumentId id : {Inst::MES, Inst::MNQ})
+                    eq_not += std::abs(new_positions[id]) * ContractSpec::get(id).notional;
+                double max_eq = equity * MAX_TOTAL_EQUITY_NOTIONAL;
+                if (eq_not > max_eq && eq_not > 0.0) {
+                    double scale = max_eq / eq_not;
+                    for (InstrumentId id : {Inst::MES, Inst::MNQ})
+                        new_positions[id] = std::floor(new_positions[id] * scale + 0.5);
+                }
             }
 
-            // FORCE REBALANCE if we have no positions but size_mult says we should trade
-            if (!do_rebalance && size_mult > 0.0 && all_positions_zero(positions)) {
-                do_rebalance = true;
+            // Total directional commodity cap
+            {
+                double com_not = 0.0;
+                for (InstrumentId id : {Inst::HG, Inst::GC, Inst::CL, Inst::SI})
+                    com_not += std::abs(new_positions[id]) * ContractSpec::get(id).notional;
+                double max_com = equity * MAX_TOTAL_COMMODITY_NOTIONAL;
+                if (com_not > max_com && com_not > 0.0) {
+                    double scale = max_com / com_not;
+                    for (InstrumentId id : {Inst::HG, Inst::GC, Inst::CL, Inst::SI})
+                        new_positions[id] = std::floor(new_positions[id] * scale + 0.5);
+                }
             }
 
-            prev_regime     = regime;
-            prev_dxy_filter = dxy_filter;
-
-            std::unordered_map<std::string, double> new_positions;
-            // If not a rebalance day, carry existing positions forward
-            if (!do_rebalance) {
-                new_positions = positions;
-                // Still apply stop-loss checks below (ATR stop runs regardless)
-                // Recalculate margin_util with current positions
-                double margin_util = 0.0;
-                for (const auto& [sym, qty] : positions)
-                    margin_util += std::abs(qty) * ContractSpec::get(sym).margin;
-                margin_util = (equity > 0.0) ? margin_util / equity : 0.0;
-                // Save signal and continue
-                DailySignal sig;
-                sig.date = date_from_int(dates[i]);
-                sig.cu_gold_ratio = ratio[i];
-                sig.roc_10 = std::isnan(roc10) ? 0.0 : roc10;
-                sig.roc_20 = std::isnan(roc20) ? 0.0 : roc20;
-                sig.roc_60 = std::isnan(roc60) ? 0.0 : roc60;
-                sig.signal_ma = signal_ma;
-                sig.ratio_zscore = std::isnan(zscore) ? 0.0 : zscore;
-                sig.signal_z = signal_z;
-                sig.composite = std::isnan(composite) ? 0.0 : composite;
-                sig.macro_tilt = macro_tilt;
-                sig.growth_signal = growth;
-                sig.inflation_signal = inflation;
-                sig.liquidity_score = liquidity;
-                sig.real_rate_10y = rr_val;
-                sig.real_rate_chg_20d = rr_chg_val;
-                sig.real_rate_zscore = rr_z_val;
-                sig.regime = regime;
-                sig.dxy_momentum = std::isnan(dxy_mom) ? 0.0 : dxy_mom;
-                sig.dxy_trend = dxy_trend;
-                sig.dxy_filter = dxy_filter;
-                sig.skip_gold_short = skip_gold_short;
-                sig.china_adjustment = china_adj;
-                sig.boj_intervention = boj_int;
-                sig.corr_spike_active = corr_spike;
-                sig.size_multiplier = size_mult;
-                sig.target_contracts = positions;
-                sig.portfolio_equity = equity;
-                sig.margin_utilization = margin_util;
-                sig.drawdown_warning = dd_warn;
-                sig.drawdown_stop = dd_stop;
-                sig.signal_flips_trailing_year = flips_trailing_year;
-                sig.spx_price = std::isnan(spx[i]) ? 0.0 : spx[i];
-                signals.push_back(sig);
-                continue;
+            // Margin utilization
+            double total_margin = 0.0;
+            for (InstrumentId id : Inst::ALL)
+                total_margin += std::abs(new_positions[id]) * ContractSpec::get(id).margin;
+            margin_util = (equity > 0.0) ? total_margin / equity : 0.0;
+            if (margin_util > p_.max_margin_util && margin_util > 0.0) {
+                double scale = p_.max_margin_util / margin_util;
+                for (double& qty : new_positions)
+                    qty = std::floor(qty * scale + 0.5);
+                margin_util = p_.max_margin_util;
             }
 
-            double margin_util = 0.0;
-
-            if (!p_.use_fixed_positions) {
-                // FULL POSITION SIZING MODE
-
-                // Helper lambda for calculating contract sizes
-                auto contracts_for = [&](const std::string& sym,
-                                         double direction,
-                                         double vol_adj = 1.0) -> double {
-                    if (std::abs(direction) < 1e-9 || std::abs(size_mult) < 1e-9)
-                        return 0.0;
-
-                    const auto cls = asset_class(sym);
-                    double w = ASSET_WEIGHTS.count(cls) ? ASSET_WEIGHTS.at(cls) : 0.1;
-                    double notional_alloc = equity * p_.leverage_target * w;
-                    const auto spec = ContractSpec::get(sym);
-                    double raw = (notional_alloc / spec.notional) * size_mult * vol_adj;
-                    return std::floor(raw * direction + 0.5);
-                };
-
-                // SI volatility adjustment
-                double si_adj = std::numeric_limits<double>::quiet_NaN();
-                if (!std::isnan(gc_atr[i]) && !std::isnan(si_atr[i]) && si_atr[i] > 0.0) {
-                    double gc_dollar_atr = gc_atr[i] * 100.0;
-                    double si_dollar_atr = si_atr[i] * 5000.0;
-                    if (si_dollar_atr > 0.0)
-                        si_adj = gc_dollar_atr / si_dollar_atr;
-                }
-
-                double boj_factor = boj_int ? 0.5 : 1.0;
-
-                // TRADE EXPRESSIONS - EXACT from doc
-                if (macro_tilt == MacroTilt::RISK_ON) {
-                    if (regime == Regime::INFLATION_SHOCK) {
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = 0.0;
-                        new_positions["HG"]  = contracts_for("HG", 1.0) * china_adj;
-                        new_positions["CL"]  = contracts_for("CL", 1.0);
-                        new_positions["SI"]  = std::isnan(si_adj) ? 0.0 : contracts_for("SI", 1.0, si_adj);
-                        new_positions["GC"]  = skip_gold_short ? 0.0 : contracts_for("GC", -1.0);
-                        new_positions["ZN"]  = contracts_for("ZN", -1.0);
-                        new_positions["UB"]  = contracts_for("UB", -1.0);
-                        new_positions["6J"]  = contracts_for("6J", -1.0) * boj_factor;
-                    } else {
-                        new_positions["MES"] = contracts_for("MES", 1.0);
-                        new_positions["MNQ"] = contracts_for("MNQ", 1.0);
-                        new_positions["HG"]  = contracts_for("HG",  1.0) * china_adj;
-                        new_positions["CL"]  = contracts_for("CL",  1.0);
-                        new_positions["GC"]  = skip_gold_short ? 0.0 : contracts_for("GC", -1.0);
-                        new_positions["SI"]  = std::isnan(si_adj) ? 0.0 : contracts_for("SI",  1.0, si_adj);
-                        new_positions["ZN"]  = contracts_for("ZN", -1.0);
-                        new_positions["UB"]  = contracts_for("UB", -1.0);
-                        new_positions["6J"]  = contracts_for("6J", -1.0) * boj_factor;
-                    }
-                } else if (macro_tilt == MacroTilt::RISK_OFF) {
-                    if (regime == Regime::INFLATION_SHOCK) {
-                        new_positions["GC"]  = contracts_for("GC",  1.0);
-                        new_positions["ZN"]  = contracts_for("ZN", -1.0);
-                        new_positions["UB"]  = contracts_for("UB", -1.0);
-                        new_positions["MES"] = contracts_for("MES", -0.5);
-                        new_positions["MNQ"] = contracts_for("MNQ", -0.5);
-                        new_positions["HG"]  = 0.0;
-                        new_positions["CL"]  = 0.0;
-                        new_positions["SI"]  = std::isnan(si_adj) ? 0.0 : contracts_for("SI",  1.0, si_adj);
-                        new_positions["6J"]  = 0.0;
-                    } else {
-                        new_positions["MES"] = contracts_for("MES", -1.0);
-                        new_positions["MNQ"] = contracts_for("MNQ", -1.0);
-                        new_positions["HG"]  = contracts_for("HG",  -1.0);
-                        new_positions["CL"]  = contracts_for("CL",  -1.0);
-                        new_positions["GC"]  = contracts_for("GC",   1.0);
-                        new_positions["SI"]  = std::isnan(si_adj) ? 0.0 : contracts_for("SI",   1.0, si_adj);
-                        new_positions["ZN"]  = contracts_for("ZN",   1.0);
-                        new_positions["UB"]  = contracts_for("UB",   1.0);
-                        new_positions["6J"]  = contracts_for("6J",   1.0) * boj_factor;
-                    }
+        } else {
+            // TEST MODE: fixed positions
+            double pos_size = p_.fixed_position_size * size_mult;
+
+            if (macro_tilt == MacroTilt::RISK_ON) {
+                if (regime == Regime::INFLATION_SHOCK) {
+                    new_positions[Inst::HG] = pos_size;
+                    new_positions[Inst::CL] = pos_size;
+                    new_positions[Inst::SI] = pos_size;
+                    new_positions[Inst::GC] = skip_gold_short ? 0.0 : -pos_size;
+                    new_positions[Inst::ZN] = -pos_size;
+                    new_positions[Inst::UB] = -pos_size;
+                    new_positions[Inst::JY] = -pos_size * (boj_int ? 0.5 : 1.0);
+                    new_positions[Inst::MES] = 0.0;
+                    new_positions[Inst::MNQ] = 0.0;
                 } else {
-                    for (const char* s : {"HG","GC","CL","SI","MES","MNQ","ZN","UB","6J"})
-                        new_positions[s] = 0.0;
-                }
-
-                // ============================================================
-                // POSITION LIMITS - EXACT from doc
-                // ============================================================
-                // Per-instrument notional cap
-
-
-                // Right after new_positions are calculated, before position limits
-                std::cout << "[SIZING] " << date_from_int(dates[i])
-                          << " equity=" << equity
-                          << " size_mult=" << size_mult
-                          << " GC_raw=" << (equity * p_.leverage_target * 0.35 / 200000.0 * size_mult)
-                          << " GC_final=" << new_positions["GC"]
-                          << " com_notional_before_cap="
-                          << (std::abs(new_positions["HG"]) * 110000.0 +
-                              std::abs(new_positions["GC"]) * 200000.0 +
-                              std::abs(new_positions["CL"]) * 75000.0 +
-                              std::abs(new_positions["SI"]) * 150000.0)
-                          << " com_cap=" << (equity * MAX_TOTAL_COMMODITY_NOTIONAL)
-                          << "\n";
-
-                for (auto& [sym, qty] : new_positions) {
-                    auto lit = SINGLE_NOTIONAL_LIMIT.find(sym);
-                    if (lit == SINGLE_NOTIONAL_LIMIT.end()) continue;
-                    double max_q = std::floor(equity * lit->second / ContractSpec::get(sym).notional);
-                    if (std::abs(qty) > max_q)
-                        qty = std::copysign(max_q, qty);
-                }
-
-                // Total directional equity cap
-                {
-                    double eq_not = 0.0;
-                    for (const auto& s : {"MES", "MNQ"}) {
-                        auto it = new_positions.find(s);
-                        if (it != new_positions.end())
-                            eq_not += std::abs(it->second) * ContractSpec::get(s).notional;
-                    }
-                    double max_eq = equity * MAX_TOTAL_EQUITY_NOTIONAL;
-                    if (eq_not > max_eq && eq_not > 0.0) {
-                        double scale = max_eq / eq_not;
-                        for (const auto& s : {"MES", "MNQ"}) {
-                            auto it = new_positions.find(s);
-                            if (it != new_positions.end())
-                                it->second = std::floor(it->second * scale + 0.5);
-                        }
-                    }
-                }
-
-                // Total directional commodity cap
-                {
-                    double com_not = 0.0;
-                    for (const auto& s : {"HG", "GC", "CL", "SI"}) {
-                        auto it = new_positions.find(s);
-                        if (it != new_positions.end())
-                            com_not += std::abs(it->second) * ContractSpec::get(s).notional;
-                    }
-                    double max_com = equity * MAX_TOTAL_COMMODITY_NOTIONAL;
-                    if (com_not > max_com && com_not > 0.0) {
-                        double scale = max_com / com_not;
-                        for (const auto& s : {"HG", "GC", "CL", "SI"}) {
-                            auto it = new_positions.find(s);
-                            if (it != new_positions.end())
-                                it->second = std::floor(it->second * scale + 0.5);
-                        }
-                    }
+                    new_positions[Inst::MES] = pos_size;
+                    new_positions[Inst::MNQ] = pos_size;
+                    new_positions[Inst::HG] = pos_size;
+                    new_positions[Inst::CL] = pos_size;
+                    new_positions[Inst::SI] = pos_size;
+                    new_positions[Inst::GC] = skip_gold_short ? 0.0 : -pos_size;
+                    new_positions[Inst::ZN] = -pos_size;
+                    new_positions[Inst::UB] = -pos_size;
+                    new_positions[Inst::JY] = -pos_size * (boj_int ? 0.5 : 1.0);
                 }
-
-                // Margin utilization
-                double total_margin = 0.0;
-                for (const auto& [sym, qty] : new_positions)
-                    total_margin += std::abs(qty) * ContractSpec::get(sym).margin;
-                margin_util = (equity > 0.0) ? total_margin / equity : 0.0;
-                if (margin_util > p_.max_margin_util && margin_util > 0.0) {
-                    double scale = p_.max_margin_util / margin_util;
-                    for (auto& [sym, qty] : new_positions)
-                        qty = std::floor(qty * scale + 0.5);
-                    margin_util = p_.max_margin_util;
+            } else if (macro_tilt == MacroTilt::RISK_OFF) {
+                if (regime == Regime::INFLATION_SHOCK) {
+                    new_positions[Inst::GC] = pos_size;
+                    new_positions[Inst::ZN] = -pos_size;
+                    new_positions[Inst::UB] = -pos_size;
+                    new_positions[Inst::SI] = pos_size;
+                    new_positions[Inst::MES] = -pos_size * 0.5;
+                    new_positions[Inst::MNQ] = -pos_size * 0.5;
+                    new_positions[Inst::HG] = 0.0;
+                    new_positions[Inst::CL] = 0.0;
+                    new_positions[Inst::JY] = 0.0;
+                } else {
+                    new_positions[Inst::MES] = -pos_size;
+                    new_positions[Inst::MNQ] = -pos_size;
+                    new_positions[Inst::HG] = -pos_size;
+                    new_positions[Inst::CL] = -pos_size;
+                    new_positions[Inst::GC] = pos_size;
+                    new_positions[Inst::SI] = pos_size;
+                    new_positions[Inst::ZN] = pos_size;
+                    new_positions[Inst::UB] = pos_size;
+                    new_positions[Inst::JY] = pos_size * (boj_int ? 0.5 : 1.0);
                 }
-
             } else {
-                // TEST MODE: fixed positions
-                double pos_size = p_.fixed_position_size * size_mult;
-
-                if (macro_tilt == MacroTilt::RISK_ON) {
-                    if (regime == Regime::INFLATION_SHOCK) {
-                        new_positions["HG"] = pos_size;
-                        new_positions["CL"] = pos_size;
-                        new_positions["SI"] = pos_size;
-                        new_positions["GC"] = skip_gold_short ? 0.0 : -pos_size;
-                        new_positions["ZN"] = -pos_size;
-                        new_positions["UB"] = -pos_size;
-                        new_positions["6J"] = -pos_size * (boj_int ? 0.5 : 1.0);
-                        new_positions["MES"] = 0.0;
-                        new_positions["MNQ"] = 0.0;
-                    } else {
-                        new_positions["MES"] = pos_size;
-                        new_positions["MNQ"] = pos_size;
-                        new_positions["HG"] = pos_size;
-                        new_positions["CL"] = pos_size;
-                        new_positions["SI"] = pos_size;
-                        new_positions["GC"] = skip_gold_short ? 0.0 : -pos_size;
-                        new_positions["ZN"] = -pos_size;
-                        new_positions["UB"] = -pos_size;
-                        new_positions["6J"] = -pos_size * (boj_int ? 0.5 : 1.0);
-                    }
-                } else if (macro_tilt == MacroTilt::RISK_OFF) {
-                    if (regime == Regime::INFLATION_SHOCK) {
-                        new_positions["GC"] = pos_size;
-                        new_positions["ZN"] = -pos_size;
-                        new_positions["UB"] = -pos_size;
-                        new_positions["SI"] = pos_size;
-                        new_positions["MES"] = -pos_size * 0.5;
-                        new_positions["MNQ"] = -pos_size * 0.5;
-                        new_positions["HG"] = 0.0;
-                        new_positions["CL"] = 0.0;
-                        new_positions["6J"] = 0.0;
-                    } else {
-                        new_positions["MES"] = -pos_size;
-                        new_positions["MNQ"] = -pos_size;
-                        new_positions["HG"] = -pos_size;
-                        new_positions["CL"] = -pos_size;
-                        new_positions["GC"] = pos_size;
-                        new_positions["SI"] = pos_size;
-                        new_positions["ZN"] = pos_size;
-                        new_positions["UB"] = pos_size;
-                        new_positions["6J"] = pos_size * (boj_int ? 0.5 : 1.0);
-                    }
-                }
+                targeted.fill(false);
             }
-            // Respect ATR stops - don't re-enter stopped positions on same day
-            for (const auto& sym : stopped_out_today) {
-                new_positions[sym] = 0.0;
+        }
+        // Respect ATR stops - don't re-enter stopped positions on same day
+        for (InstrumentId id : Inst::ALL) {
+            if (stopped_out_today[id]) {
+                new_positions[id] = 0.0;
+                targeted[id] = true;
             }
+        }
 
-            // Update positions for next day — deduct full transaction costs on changes
-            // doc Phase 6 line 749: "spread + slippage + commission per contract"
-            for (const auto& [sym, new_qty] : new_positions) {
-                double old_qty = positions.count(sym) ? positions.at(sym) : 0.0;
-                double qty_change = std::abs(new_qty - old_qty);
-                if (qty_change > 0.0) {
-                    double total_cost = ContractSpec::total_cost_rt(sym) * qty_change;
-                    equity -= total_cost;
-                }
-                // Record entry price when position opens from flat
-                if (old_qty == 0.0 && new_qty != 0.0) {
-                    const auto* px = px_map.count(sym) ? px_map.at(sym) : nullptr;
-                    entry_prices[sym] = (px && !std::isnan((*px)[i])) ? (*px)[i] : std::numeric_limits<double>::quiet_NaN();
-                } else if (new_qty == 0.0) {
-                    entry_prices[sym] = std::numeric_limits<double>::quiet_NaN();
+        // Update positions for next day — deduct full transaction costs on changes
+        // doc Phase 6 line 749: "spread + slippage + commission per contract"
+        for (InstrumentId id : Inst::ALL) {
+            if (!targeted[id]) continue;
+            double new_qty = new_positions[id];
+            double old_qty = positions[id];
+            double qty_change = std::abs(new_qty - old_qty);
+            if (qty_change > 0.0) {
+                double total_cost = ContractSpec::total_cost_rt(id) * qty_change;
+                equity -= total_cost;
+            }
+            // Record entry price when position opens from flat
+            if (old_qty == 0.0 && new_qty != 0.0) {
+                entry_prices[id] = !std::isnan(m.close[id]) ? m.close[id] : std::numeric_limits<double>::quiet_NaN();
+            } else if (new_qty == 0.0) {
+                entry_prices[id] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+        positions = new_positions;
+        st.held_margin = margin_held(positions);
+
+        // Print debug every 6 months (126 trading days)
+
+
+        // Show non-zero positions (limit to 5 to keep output manageable).
+        // The five are the first non-zero ones in registry order (HG GC CL
+        // SI ZN UB 6J MES MNQ). Before InstrumentId this walked an
+        // unordered_map whose order was unspecified and changed between
+        // days, so both the order and which symbols made the cut differ
+        // from logs of those builds; the line format is unchanged.
+        if (Log::enabled(Log::INFO, Log::POSITIONS)) {
+            std::string pos_str;
+            int pos_count = 0;
+            for (InstrumentId id : Inst::ALL) {
+                double qty = positions[id];
+                if (qty != 0.0 && pos_count < 5) {
+                    char buf[50];
+                    snprintf(buf, sizeof(buf), "%s:%.0f ", Inst::symbol(id), qty);
+                    pos_str += buf;
+                    pos_count++;
                 }
             }
-            positions = new_positions;
-
-            // Print debug every 6 months (126 trading days)
+            if (!pos_str.empty())
+                CG_LOG(INFO, POSITIONS, "        Positions: " << pos_str << "\n");
+        }
 
 
-                // Show non-zero positions (limit to 5 to keep output manageable)
-                std::string pos_str;
-                int pos_count = 0;
-                for (const auto& [sym, qty] : positions) {
-                    if (qty != 0.0 && pos_count < 5) {
-                        char buf[50];
-                        snprintf(buf, sizeof(buf), "%s:%.0f ", sym.c_str(), qty);
-                        pos_str += buf;
-                        pos_count++;
-                    }
+        // Print warning if position sizes get too large
+        if (!p_.use_fixed_positions) {
+            for (double qty : positions) {
+                if (std::abs(qty) > 100) {
+                    //std::cout << "[WARN] Large position: " << sym << " = " << qty
+                              //<< " at " << date_str << "\n";
                 }
-                if (!pos_str.empty())
-                    std::cout << "        Positions: " << pos_str << "\n";
+            }
+        }
 
+        DailySignal sig = with_book(s, r, st, margin_util);
+        for (InstrumentId id : Inst::ALL) sig.dropped[id] = !targeted[id];
+        return sig;
+    }
 
-            // Print warning if position sizes get too large
-            if (!p_.use_fixed_positions) {
-                for (const auto& [sym, qty] : positions) {
-                    if (std::abs(qty) > 100) {
-                        //std::cout << "[WARN] Large position: " << sym << " = " << qty
-                                  //<< " at " << date_from_int(dates[i]) << "\n";
-                    }
-                }
-            }
+    // Shared signal pipeline; run() replays it instead of rebuilding the
+    // signal path. Must come from an instance with the same signal params.
+    void set_signal_pipeline(std::shared_ptr<const SignalPipeline> sp) { signal_pipeline_ = std::move(sp); }
+
+    SignalTable run() {
+        const std::shared_ptr<const SignalPipeline> pipeline =
+            signal_pipeline_ ? signal_pipeline_ : build_signals();
+        SignalTable signals = simulate(*pipeline);
+        Log::flush();  // per-day log lines land before the summary
+
+        const int n = static_cast<int>(pipeline->dates.size());
+        const std::vector<double>& ratio = pipeline->ratio;
+        const int infl_shock_days = pipeline->infl_shock_days;
 
-            // ============================================================
-            // Save signal
-            // ============================================================
-            DailySignal sig;
-            sig.date = date_from_int(dates[i]);
-            sig.cu_gold_ratio = ratio[i];
-            sig.roc_10 = std::isnan(roc10) ? 0.0 : roc10;
-            sig.roc_20 = std::isnan(roc20) ? 0.0 : roc20;
-            sig.roc_60 = std::isnan(roc60) ? 0.0 : roc60;
-            sig.signal_ma = signal_ma;
-            sig.ratio_zscore = std::isnan(zscore) ? 0.0 : zscore;
-            sig.signal_z = signal_z;
-            sig.composite = std::isnan(composite) ? 0.0 : composite;
-            sig.macro_tilt = macro_tilt;
-
-            sig.growth_signal = growth;
-            sig.inflation_signal = inflation;
-            sig.liquidity_score = liquidity;
-            sig.real_rate_10y = rr_val;
-            sig.real_rate_chg_20d = rr_chg_val;
-            sig.real_rate_zscore = rr_z_val;
-            sig.regime = regime;
-
-            sig.dxy_momentum = std::isnan(dxy_mom) ? 0.0 : dxy_mom;
-            sig.dxy_trend = dxy_trend;
-            sig.dxy_filter = dxy_filter;
-            sig.skip_gold_short = skip_gold_short;
-            sig.china_adjustment = china_adj;
-            sig.boj_intervention = boj_int;
-            sig.corr_spike_active = corr_spike;
-
-            sig.size_multiplier = size_mult;
-            sig.target_contracts = positions;
-            sig.portfolio_equity = equity;
-            sig.margin_utilization = margin_util;
-            sig.drawdown_warning = dd_warn;
-            sig.drawdown_stop = dd_stop;
-            sig.signal_flips_trailing_year = flips_trailing_year;
-            sig.spx_price = std::isnan(spx[i]) ? 0.0 : spx[i];
-
-            signals.push_back(sig);
-            last_flip_tilt = macro_tilt;
-        }
             // ================================================================
             // DIAGNOSTIC SUMMARY - runs once after full backtest
             // ================================================================
@@ -1512,21 +4621,20 @@ public:
                 // ── 1. DATA INGESTION CHECK ──────────────────────────────────────
                 std::cout << "\n── 1. DATA INGESTION (first valid prices) ──\n";
                 for (const auto& sym : {"HG","GC","CL","SI","ZN","UB","6J","MES","MNQ"}) {
-                    auto it = fut_.find(sym);
-                    if (it == fut_.end() || it->second.empty()) {
+                    auto it = data_->fut.find(sym);
+                    if (it == data_->fut.end() || it->second.empty()) {
                         std::cout << "  " << sym << ": NO DATA\n";
                     } else {
-                        auto& bar = it->second.begin()->second;
                         std::cout << "  " << sym << ": first=" << std::fixed << std::setprecision(4)
-                                  << bar.close
-                                  << "  last=" << it->second.rbegin()->second.close
+                                  << it->second.close.front()
+                                  << "  last=" << it->second.close.back()
                                   << "  bars=" << it->second.size() << "\n";
                     }
                 }
-                std::cout << "  DXY records : " << dxy_ts_.size()
-                          << "   VIX: " << vix_ts_.size()
-                          << "   HY: " << hy_ts_.size()
-                          << "   FedBS: " << fed_bs_ts_.size() << "\n";
+                std::cout << "  DXY records : " << data_->dxy.size()
+                          << "   VIX: " << data_->vix.size()
+                          << "   HY: " << data_->hy.size()
+                          << "   FedBS: " << data_->fed_bs.size() << "\n";
 
                 // ── 2. RATIO SANITY ─────────────────────────────────────────────
                 std::cout << "\n── 2. CU/GOLD RATIO ──\n";
@@ -1550,20 +4658,22 @@ public:
                 int cnt_ron=0, cnt_roff=0, cnt_neut=0;
                 int cnt_gpos=0, cnt_gneg=0, cnt_inf=0, cnt_liq=0, cnt_rneu=0;
                 double liq_min=1e9, liq_max=-1e9, liq_sum=0; int liq_n=0;
-                for (const auto& s : signals) {
-                    if      (s.macro_tilt == MacroTilt::RISK_ON)  ++cnt_ron;
-                    else if (s.macro_tilt == MacroTilt::RISK_OFF) ++cnt_roff;
-                    else                                           ++cnt_neut;
-                    switch (s.regime) {
+                const auto& liq_col = signals.liquidity_score();
+                for (size_t r = 0; r < signals.size(); ++r) {
+                    MacroTilt t = signals.macro_tilt(r);
+                    if      (t == MacroTilt::RISK_ON)  ++cnt_ron;
+                    else if (t == MacroTilt::RISK_OFF) ++cnt_roff;
+                    else                               ++cnt_neut;
+                    switch (signals.regime(r)) {
                         case Regime::GROWTH_POSITIVE: ++cnt_gpos; break;
                         case Regime::GROWTH_NEGATIVE: ++cnt_gneg; break;
                         case Regime::INFLATION_SHOCK: ++cnt_inf;  break;
                         case Regime::LIQUIDITY_SHOCK: ++cnt_liq;  break;
                         default:                      ++cnt_rneu; break;
                     }
-                    liq_min = std::min(liq_min, s.liquidity_score);
-                    liq_max = std::max(liq_max, s.liquidity_score);
-                    liq_sum += s.liquidity_score;
+                    liq_min = std::min(liq_min, liq_col[r]);
+                    liq_max = std::max(liq_max, liq_col[r]);
+                    liq_sum += liq_col[r];
                     ++liq_n;
                 }
                 std::cout << "  Tilt   RISK_ON=" << cnt_ron << "  RISK_OFF=" << cnt_roff
@@ -1583,10 +4693,11 @@ public:
                 std::cout << "\n── 4. SIGNAL FLIPS ──\n";
                 int total_flips = 0;
                 MacroTilt prev_t2 = MacroTilt::NEUTRAL;
-                for (const auto& s : signals) {
-                    if (s.macro_tilt != prev_t2) { ++total_flips; prev_t2 = s.macro_tilt; }
+                for (size_t r = 0; r < signals.size(); ++r) {
+                    MacroTilt t = signals.macro_tilt(r);
+                    if (t != prev_t2) { ++total_flips; prev_t2 = t; }
                 }
-                double yrs = n_signals / 252.0;
+                double yrs = n_signals / static_cast<double>(TradingCalendar::TRADING_YEAR);
                 double fpy = (yrs > 0) ? total_flips / yrs : 0;
                 std::cout << "  Total flips: " << total_flips
                           << "  Years: " << std::setprecision(1) << yrs
@@ -1597,13 +4708,14 @@ public:
                 std::cout << "\n── 5. POSITION ACTIVITY ──\n";
                 int days_with_positions = 0;
                 double max_abs_gc = 0, max_abs_hg = 0;
-                for (const auto& s : signals) {
+                for (size_t r = 0; r < signals.size(); ++r) {
+                    const double* qty = signals.contracts_row(r);
                     bool any = false;
-                    for (const auto& [sym, qty] : s.target_contracts) {
-                        if (qty != 0) { any = true; }
-                        if (sym == "GC") max_abs_gc = std::max(max_abs_gc, std::abs(qty));
-                        if (sym == "HG") max_abs_hg = std::max(max_abs_hg, std::abs(qty));
+                    for (int k = 0; k < Inst::COUNT; ++k) {
+                        if (qty[k] != 0) { any = true; }
                     }
+                    max_abs_gc = std::max(max_abs_gc, std::abs(qty[Inst::GC]));
+                    max_abs_hg = std::max(max_abs_hg, std::abs(qty[Inst::HG]));
                     if (any) ++days_with_positions;
                 }
                 double pct_invested = (n_signals > 0) ? 100.0 * days_with_positions / n_signals : 0;
@@ -1616,7 +4728,7 @@ public:
 
                 // ── 6. EQUITY / RETURN CHECK ────────────────────────────────────
                 std::cout << "\n── 6. EQUITY ──\n";
-                double final_eq = signals.empty() ? p_.initial_capital : signals.back().portfolio_equity;
+                double final_eq = signals.empty() ? p_.initial_capital : signals.back().portfolio_equity();
                 double total_ret = (final_eq / p_.initial_capital) - 1.0;
                 double ann_ret   = (yrs > 0) ? std::pow(1.0 + total_ret, 1.0 / yrs) - 1.0 : 0.0;
                 std::cout << "  Start: $" << std::fixed << std::setprecision(0) << p_.initial_capital
@@ -1633,18 +4745,18 @@ public:
                 if (n_signals >= 5) {
                     for (int k = 0; k < 5; ++k) {
                         int idx = k * (n_signals - 1) / 4;
-                        const auto& s = signals[idx];
+                        const auto s = signals[idx];
                         char line[256];
                         snprintf(line, sizeof(line),
                             "  %-10s  %6.4f  %+6.3f  %-7s  %-17s  %+5.2f  %8.2f  %10.0f\n",
-                            s.date.c_str(),
-                            s.cu_gold_ratio,
-                            s.composite,
-                            tilt_str(s.macro_tilt),
-                            regime_str(s.regime),
-                            s.liquidity_score,
-                            s.size_multiplier,
-                            s.portfolio_equity);
+                            s.date().c_str(),
+                            s.cu_gold_ratio(),
+                            s.composite(),
+                            tilt_str(s.macro_tilt()),
+                            regime_str(s.regime()),
+                            s.liquidity_score(),
+                            s.size_multiplier(),
+                            s.portfolio_equity());
                         std::cout << line;
                     }
                 }
@@ -1665,21 +4777,957 @@ public:
         return signals;
     }
 
+    // ================================================================
+    // Streaming mode
+    // ================================================================
+    // on_bar() advances every indicator, debounce counter and the book by
+    // one calendar day in O(1) and returns that day's signal, or nothing on
+    // a day without a Cu/Gold ratio (run() skips those too). A bar that is
+    // not after the last one folded in (a restored snapshot's day included)
+    // is rejected with an error and changes nothing. warm_up()
+    // starts a fresh stream and replays a history through on_bar(),
+    // returning how many signal days it produced. Fed run()'s calendar from
+    // its first day (market_days() builds it from the loaded files) and
+    // prior_closes() of that day, the sequence is the same as run()'s table.
+    size_t warm_up(const std::vector<MarketDay>& history, const PerInstrument<double>& prior_close) {
+        live_ = std::make_unique<LiveState>(p_);
+        live_->indicators.seed_prev_close(prior_close);
+        size_t produced = 0;
+        for (const MarketDay& md : history)
+            produced += on_bar(md.day, md.bars, md.macro).has_value();
+        return produced;
+    }
+
+    std::optional<DailySignal> on_bar(int day, const PerInstrument<OHLCVBar>& bars,
+                                      const MacroBar& macro) {
+        if (!live_) live_ = std::make_unique<LiveState>(p_);
+        // A bar at or before the last one would fold its P&L, debounce
+        // counts and costs into the state a second time
+        if (day <= live_->last_day) {
+            std::cerr << "[ERROR] Bar " << date_from_int(day) << " is not after the last bar "
+                      << date_from_int(live_->last_day) << "; ignored\n";
+            return std::nullopt;
+        }
+        SignalInputs in;
+        DayMarks m;
+        live_->indicators.push(day, bars, macro, in, m);
+        live_->last_day = day;
+        if (std::isnan(in.ratio)) return std::nullopt;
+        const SignalDay d = signal_step(in, live_->signal);
+        return portfolio_step(d, m, date_from_int(day), d.scheduled(), live_->book);
+    }
+
+    // Writes the streaming state as of the last on_bar() day to `path`.
+    // restore_state() loads it into an instance built with the same params,
+    // whose next on_bar() then continues from the following day exactly as
+    // the saving instance would have.
+    bool save_state(const std::string& path) const {
+        if (!live_) {
+            std::cerr << "[WARN] No streaming state to save\n";
+            return false;
+        }
+        StateIO::Writer w;
+        live_->indicators.save(w);
+        live_->signal.save(w);
+        live_->book.save(w);
+        if (!StateIO::write(path, live_->last_day, params_fingerprint(p_), w.bytes())) {
+            std::cerr << "[ERROR] Failed to write state snapshot: " << path << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool restore_state(const std::string& path) {
+        std::string buf;
+        StateIO::Header h;
+        std::string_view payload;
+        if (!StateIO::read(path, params_fingerprint(p_), buf, h, payload)) return false;
+
+        auto state = std::make_unique<LiveState>(p_);
+        StateIO::Reader r(payload);
+        state->indicators.load(r);
+        state->signal.load(r);
+        state->book.load(r);
+        if (!r.done()) {
+            std::cerr << "[ERROR] Malformed state snapshot: " << path << "\n";
+            return false;
+        }
+        state->last_day = static_cast<int>(h.day);
+        live_ = std::move(state);
+        return true;
+    }
+
+    // Each instrument's last raw close strictly before `day`, NaN where it
+    // has none: the warm_up() seed for a history starting on `day`
+    PerInstrument<double> prior_closes(int day) const {
+        PerInstrument<double> out;
+        for (InstrumentId id : Inst::ALL) {
+            out[id] = std::numeric_limits<double>::quiet_NaN();
+            auto it = data_->fut.find(Inst::symbol(id));
+            if (it == data_->fut.end()) continue;
+            const size_t r = it->second.lower_bound(day);
+            if (r > 0) out[id] = it->second.close[r - 1];
+        }
+        return out;
+    }
+
+    // The loaded files as streaming input on run()'s calendar
+    std::vector<MarketDay> market_days() const {
+        const auto [start_dk, end_dk] = date_bounds();
+        const Panel panel = build_panel(start_dk, end_dk);
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+
+        std::vector<MarketDay> days(panel.dates.size());
+        for (size_t i = 0; i < days.size(); ++i) {
+            MarketDay& md = days[i];
+            md.day = panel.dates[i];
+            for (InstrumentId id : Inst::ALL) {
+                OHLCVBar& b = md.bars[id];
+                b.close = nan;
+                auto it = data_->fut.find(Inst::symbol(id));
+                if (it == data_->fut.end()) continue;
+                const FuturesSeries& fs = it->second;
+                size_t r = fs.find(md.day);
+                if (r == DateIndex::npos) continue;
+                b = OHLCVBar{fs.open[r], fs.high[r], fs.low[r], fs.close[r], fs.volume[r]};
+            }
+            MacroBar& mb = md.macro;
+            mb.dxy = panel.macro.at("dxy").value[i];
+            mb.vix = panel.macro.at("vix").value[i];
+            mb.high_yield_spread = panel.macro.at("high_yield_spread").value[i];
+            mb.breakeven_10y = panel.macro.at("breakeven_10y").value[i];
+            mb.treasury_10y = panel.macro.at("treasury_10y").value[i];
+            mb.spx = panel.macro.at("spx").value[i];
+            mb.fed_balance_sheet = panel.macro.at("fed_balance_sheet").value[i];
+            mb.china_leading_indicator = panel.macro.at("china_leading_indicator").value[i];
+        }
+        return days;
+    }
+
 private:
+    // Carried state of the streaming mode
+    struct LiveState {
+        IndicatorStream indicators;
+        SignalState signal;
+        RunState book;
+        int last_day = std::numeric_limits<int>::min();  // no bar yet
+        explicit LiveState(const StrategyParams& p) : indicators(p), book(p.initial_capital) {}
+    };
+
     std::string data_dir_;
     StrategyParams p_;
 
-    std::unordered_map<std::string, FuturesSeries> fut_;
-    TimeSeries dxy_ts_, vix_ts_, hy_ts_, breakeven_ts_, treasury_ts_;
-    TimeSeries tips_ts_;       // doc line 682: 10Y TIPS yield
-    TimeSeries spx_ts_, fed_bs_ts_, china_cli_ts_;
-    TimeSeries cny_usd_ts_;    // doc line 689: CNY/USD, China FX filter
+    std::shared_ptr<const MarketData> data_;
+    const WindowPanelSet* window_panels_ = nullptr;
+    std::shared_ptr<const SignalPipeline> signal_pipeline_;
+    std::unique_ptr<LiveState> live_;
+    bool quiet_ = false;
+};
+
+// ============================================================
+// Performance metrics
+// ============================================================
+// The acceptance-criteria metrics main() prints (doc lines 591-608),
+// from a finished run's table. Needs at least two signal days.
+struct PerformanceMetrics {
+    double ann_return = 0.0, ann_std = 0.0;
+    double sharpe = 0.0, sortino = 0.0, max_dd = 0.0;
+    double win_rate = 0.0, profit_factor = 0.0;
+    double annual_turnover = 0.0, corr_spx = 0.0, flips_per_year = 0.0;
+};
+
+static PerformanceMetrics compute_metrics(const SignalTable& signals, double initial_capital) {
+    const std::vector<double>& equity_col = signals.portfolio_equity();
+    std::vector<double> daily_equity;
+    daily_equity.reserve(equity_col.size() + 1);
+    daily_equity.push_back(initial_capital);
+    daily_equity.insert(daily_equity.end(), equity_col.begin(), equity_col.end());
+
+    int N = (int)daily_equity.size() - 1;
+
+    std::vector<double> daily_returns(N);
+    for (int i = 0; i < N; ++i)
+        daily_returns[i] = (daily_equity[i+1] - daily_equity[i]) / daily_equity[i];
+
+    const double year = TradingCalendar::TRADING_YEAR;   // annualisation basis
+    double total_days = N;
+    double total_return = (daily_equity.back() / daily_equity.front()) - 1.0;
+    double ann_return = std::pow(1.0 + total_return, year / total_days) - 1.0;
+
+    double mean_ret = 0.0;
+    for (double r : daily_returns) mean_ret += r;
+    mean_ret /= N;
+
+    double var = 0.0;
+    for (double r : daily_returns) var += (r - mean_ret) * (r - mean_ret);
+    var /= N;
+    double ann_std = std::sqrt(var) * std::sqrt(year);
+
+    double sharpe = (ann_std > 0.0) ? ann_return / ann_std : 0.0;
+
+    double downside_var = 0.0;
+    int downside_count = 0;
+    for (double r : daily_returns) {
+        if (r < 0.0) { downside_var += r * r; downside_count++; }
+    }
+    double downside_std = (downside_count > 0)
+        ? std::sqrt(downside_var / downside_count) * std::sqrt(year) : 0.0;
+    double sortino = (downside_std > 0.0) ? ann_return / downside_std : 0.0;
+
+    double peak = initial_capital, max_dd = 0.0;
+    for (double eq : daily_equity) {
+        if (eq > peak) peak = eq;
+        double dd = (peak - eq) / peak;
+        if (dd > max_dd) max_dd = dd;
+    }
+
+    double gross_profit = 0.0, gross_loss = 0.0;
+    int wins = 0;
+    for (double r : daily_returns) {
+        double pnl = r * daily_equity[0];
+        if (pnl > 0.0) { gross_profit += pnl; wins++; }
+        else if (pnl < 0.0) { gross_loss += std::abs(pnl); }
+    }
+    double win_rate = (N > 0) ? (double)wins / N : 0.0;
+    double profit_factor = (gross_loss > 0.0) ? gross_profit / gross_loss : 0.0;
+
+    double total_notional_traded = 0.0;
+    for (size_t i = 1; i < signals.size(); ++i) {
+        const double* qty = signals.contracts_row(i);
+        const double* prev_qty = signals.contracts_row(i - 1);
+        const uint16_t dropped = signals.dropped_mask(i);
+        for (InstrumentId id : Inst::ALL)
+            if (!(dropped >> id & 1u))
+                total_notional_traded += std::abs(qty[id] - prev_qty[id]) * ContractSpec::get(id).notional;
+    }
+    double avg_equity = 0.0;
+    for (double eq : equity_col) avg_equity += eq;
+    avg_equity /= (double)signals.size();
+    double years = total_days / year;
+    double annual_turnover = (avg_equity > 0.0 && years > 0.0)
+        ? (total_notional_traded / years) / avg_equity : 0.0;
+
+    int all_flips = 0;
+    MacroTilt prev_t = MacroTilt::NEUTRAL;
+    for (size_t r = 0; r < signals.size(); ++r) {
+        MacroTilt t = signals.macro_tilt(r);
+        if (t != prev_t) { all_flips++; prev_t = t; }
+    }
+    double flips_per_year = (years > 0.0) ? all_flips / years : 0.0;
+
+    // Correlation to SPX — doc line 603: minimum < 0.5, target < 0.3
+    double corr_spx = 0.0;
+    {
+        std::vector<double> spx_rets, strat_rets;
+        const std::vector<double>& spx_col = signals.spx_price();
+        for (size_t i = 1; i < signals.size(); ++i) {
+            if (spx_col[i] > 0.0 && spx_col[i-1] > 0.0) {
+                spx_rets.push_back((spx_col[i] / spx_col[i-1]) - 1.0);
+                strat_rets.push_back((equity_col[i] / equity_col[i-1]) - 1.0);
+            }
+        }
+        int M = (int)spx_rets.size();
+        if (M > 2) {
+            double ms = 0.0, mp = 0.0;
+            for (int j = 0; j < M; ++j) { ms += strat_rets[j]; mp += spx_rets[j]; }
+            ms /= M; mp /= M;
+            double cov = 0.0, vs = 0.0, vp = 0.0;
+            for (int j = 0; j < M; ++j) {
+                double ds = strat_rets[j] - ms, dp = spx_rets[j] - mp;
+                cov += ds * dp; vs += ds * ds; vp += dp * dp;
+            }
+            double denom = std::sqrt(vs * vp);
+            if (denom > 0.0) corr_spx = cov / denom;
+        }
+    }
+
+    PerformanceMetrics m;
+    m.ann_return = ann_return;
+    m.ann_std = ann_std;
+    m.sharpe = sharpe;
+    m.sortino = sortino;
+    m.max_dd = max_dd;
+    m.win_rate = win_rate;
+    m.profit_factor = profit_factor;
+    m.annual_turnover = annual_turnover;
+    m.corr_spx = corr_spx;
+    m.flips_per_year = flips_per_year;
+    return m;
+}
+
+// ============================================================
+// Parameter sweep
+// ============================================================
+// copper_gold_strategy --sweep <spec> [data_dir] [out.csv]
+//
+// Loads the market data once and backtests every config of a spec against
+// that shared copy. A spec is either a grid, one axis per line, expanded
+// to the Cartesian product of its axes (first axis varies slowest):
+//     ma_slow = 40, 50, 60
+//     drawdown_stop = 0.12, 0.15
+// or a list: a CSV whose header names fields and whose rows are configs.
+// Fields a spec does not name keep their defaults; '#' lines are comments.
+//
+// Configs that agree on every signal param share one build_signals() pass
+// and the whole grid's rolling windows are computed once up front, so a
+// risk or sizing axis costs one simulate() per value. Signal groups and
+// the configs inside each group are spread over the shared pool. The
+// output has one row per config, in spec order.
+namespace Sweep {
+
+struct Field {
+    const char* name;
+    int StrategyParams::*    i = nullptr;  // exactly one member is set
+    double StrategyParams::* d = nullptr;
+    bool StrategyParams::*   b = nullptr;
+
+    Field(const char* n, int StrategyParams::* f)    : name(n), i(f) {}
+    Field(const char* n, double StrategyParams::* f) : name(n), d(f) {}
+    Field(const char* n, bool StrategyParams::* f)   : name(n), b(f) {}
+};
+
+static const Field FIELDS[] = {
+    {"roc_10_window", &StrategyParams::roc_10_window},
+    {"roc_20_window", &StrategyParams::roc_20_window},
+    {"roc_60_window", &StrategyParams::roc_60_window},
+    {"ma_fast", &StrategyParams::ma_fast},
+    {"ma_slow", &StrategyParams::ma_slow},
+    {"zscore_window", &StrategyParams::zscore_window},
+    {"zscore_thresh", &StrategyParams::zscore_thresh},
+    {"composite_thresh", &StrategyParams::composite_thresh},
+    {"w1", &StrategyParams::w1},
+    {"w2", &StrategyParams::w2},
+    {"w3", &StrategyParams::w3},
+    {"spx_mom_window", &StrategyParams::spx_mom_window},
+    {"breakeven_window", &StrategyParams::breakeven_window},
+    {"liq_zscore_window", &StrategyParams::liq_zscore_window},
+    {"real_rate_chg_window", &StrategyParams::real_rate_chg_window},
+    {"real_rate_z_window", &StrategyParams::real_rate_z_window},
+    {"liquidity_thresh", &StrategyParams::liquidity_thresh},
+    {"dxy_mom_window", &StrategyParams::dxy_mom_window},
+    {"dxy_mom_thresh", &StrategyParams::dxy_mom_thresh},
+    {"corr_window", &StrategyParams::corr_window},
+    {"corr_thresh", &StrategyParams::corr_thresh},
+    {"boj_move_thresh", &StrategyParams::boj_move_thresh},
+    {"leverage_target", &StrategyParams::leverage_target},
+    {"max_margin_util", &StrategyParams::max_margin_util},
+    {"drawdown_warn", &StrategyParams::drawdown_warn},
+    {"drawdown_stop", &StrategyParams::drawdown_stop},
+    {"min_hold_days", &StrategyParams::min_hold_days},
+    {"use_china_filter", &StrategyParams::use_china_filter},
+    {"china_cli_thresh", &StrategyParams::china_cli_thresh},
+    {"initial_capital", &StrategyParams::initial_capital},
+    {"use_fixed_positions", &StrategyParams::use_fixed_positions},
+    {"fixed_position_size", &StrategyParams::fixed_position_size},
 };
 
+static const Field* find_field(std::string_view name) {
+    for (const Field& f : FIELDS)
+        if (name == f.name) return &f;
+    return nullptr;
+}
+
+static bool set_field(StrategyParams& p, const Field& f, std::string_view v) {
+    if (f.d) {
+        auto r = std::from_chars(v.data(), v.data() + v.size(), p.*f.d);
+        return r.ec == std::errc() && r.ptr == v.data() + v.size();
+    }
+    if (f.i) {
+        auto r = std::from_chars(v.data(), v.data() + v.size(), p.*f.i);
+        return r.ec == std::errc() && r.ptr == v.data() + v.size();
+    }
+    if (v == "1" || v == "true")  { p.*f.b = true;  return true; }
+    if (v == "0" || v == "false") { p.*f.b = false; return true; }
+    return false;
+}
+
+static void write_field(std::ostream& os, const StrategyParams& p, const Field& f) {
+    if (f.d)      os << p.*f.d;
+    else if (f.i) os << p.*f.i;
+    else          os << (p.*f.b ? 1 : 0);
+}
+
+struct Spec {
+    std::vector<const Field*> columns;   // fields the spec sets, in spec order
+    std::vector<StrategyParams> configs;
+};
+
+// Fills `spec` from a grid or list file; false (with a message) on any
+// unknown field or unparsable value
+static bool parse_spec(const std::string& path, Spec& spec) {
+    std::string buf;
+    if (!read_file(path, buf)) {
+        std::cerr << "[ERROR] Cannot open sweep spec " << path << "\n";
+        return false;
+    }
+    std::vector<std::string_view> lines;
+    std::string_view rest(buf), line;
+    while (next_line(rest, line)) {
+        line = trim(line);
+        if (!line.empty() && line.front() != '#') lines.push_back(line);
+    }
+    if (lines.empty()) {
+        std::cerr << "[ERROR] Sweep spec " << path << " has no configs\n";
+        return false;
+    }
+    auto bad = [&](std::string_view what, std::string_view v) {
+        std::cerr << "[ERROR] Sweep spec " << path << ": " << what << " '" << v << "'\n";
+        return false;
+    };
+
+    // Grid: expand axis by axis
+    if (lines.front().find('=') != std::string_view::npos) {
+        spec.configs.assign(1, StrategyParams{});
+        for (std::string_view axis : lines) {
+            size_t eq = axis.find('=');
+            if (eq == std::string_view::npos) return bad("expected <field> = <values>", axis);
+            std::string_view name = trim(axis.substr(0, eq));
+            const Field* f = find_field(name);
+            if (!f) return bad("unknown field", name);
+            spec.columns.push_back(f);
+
+            std::vector<StrategyParams> expanded;
+            std::string_view values = axis.substr(eq + 1);
+            std::vector<std::string_view> vs;
+            while (!values.empty()) vs.push_back(trim(next_field(values)));
+            expanded.reserve(spec.configs.size() * vs.size());
+            for (const StrategyParams& base : spec.configs) {
+                for (std::string_view v : vs) {
+                    expanded.push_back(base);
+                    if (!set_field(expanded.back(), *f, v)) return bad("bad value", v);
+                }
+            }
+            spec.configs = std::move(expanded);
+        }
+        return true;
+    }
+
+    // List: header of field names, then one config per row
+    std::string_view header = lines.front();
+    while (!header.empty()) {
+        std::string_view name = trim(next_field(header));
+        const Field* f = find_field(name);
+        if (!f) return bad("unknown field", name);
+        spec.columns.push_back(f);
+    }
+    for (size_t r = 1; r < lines.size(); ++r) {
+        std::string_view row = lines[r];
+        StrategyParams p;
+        for (const Field* f : spec.columns) {
+            std::string_view v = trim(next_field(row));
+            if (!set_field(p, *f, v)) return bad("bad value", v);
+        }
+        if (!row.empty()) return bad("more fields than the header in row", lines[r]);
+        spec.configs.push_back(p);
+    }
+    return true;
+}
+
+// Config indices per signal fingerprint, groups in order of first use
+static std::vector<std::vector<size_t>> group_by_signal(const std::vector<StrategyParams>& configs) {
+    std::vector<std::vector<size_t>> groups;
+    std::unordered_map<uint64_t, size_t> group_of;
+    for (size_t k = 0; k < configs.size(); ++k) {
+        auto [it, fresh] = group_of.emplace(signal_fingerprint(configs[k]), groups.size());
+        if (fresh) groups.emplace_back();
+        groups[it->second].push_back(k);
+    }
+    return groups;
+}
+
+// Metric columns of the sweep and walk-forward outputs
+static constexpr const char* METRIC_COLUMNS =
+    "ann_return,sharpe,sortino,max_dd,win_rate,profit_factor,annual_turnover,corr_spx,flips_per_year";
+
+// Writes ",<metric>..." in METRIC_COLUMNS order; empty fields without metrics
+static void write_metrics(std::ostream& out, const PerformanceMetrics* m) {
+    if (!m) {
+        out << ",,,,,,,,,";
+        return;
+    }
+    out << ',' << m->ann_return << ',' << m->sharpe << ',' << m->sortino << ',' << m->max_dd
+        << ',' << m->win_rate << ',' << m->profit_factor << ',' << m->annual_turnover
+        << ',' << m->corr_spx << ',' << m->flips_per_year;
+}
+
+// Per-day diagnostics of thousands of runs are noise; CG_LOG_LEVEL still
+// turns them back on
+static void quiet_logs() {
+    if (!std::getenv("CG_LOG_LEVEL")) Log::g_level.store(Log::ERROR);
+}
+
+// Full-history metrics of every config: one pipeline per signal group,
+// built on the shared window panels, then one simulator pass per member.
+// has_metrics[k] is false when config k has fewer than two signal days.
+// Returns the number of signal groups.
+static size_t evaluate(const std::shared_ptr<const MarketData>& data, const WindowPanelSet& panels,
+                       const std::vector<StrategyParams>& configs,
+                       std::vector<PerformanceMetrics>& metrics, std::vector<char>& has_metrics) {
+    const std::vector<std::vector<size_t>> groups = group_by_signal(configs);
+    metrics.assign(configs.size(), PerformanceMetrics{});
+    has_metrics.assign(configs.size(), 0);
+    shared_pool().parallel_for(groups.size(), [&](size_t g) {
+        const std::vector<size_t>& members = groups[g];
+        CopperGoldStrategy head(data, configs[members.front()]);
+        head.set_quiet(true);
+        head.set_window_panels(&panels);
+        const std::shared_ptr<const SignalPipeline> sp = head.build_signals();
+        shared_pool().parallel_for(members.size(), [&](size_t j) {
+            const size_t k = members[j];
+            const StrategyParams& p = configs[k];
+            const SignalTable signals = CopperGoldStrategy(data, p).simulate(*sp);
+            if (signals.size() < 2) return;
+            metrics[k] = compute_metrics(signals, p.initial_capital);
+            has_metrics[k] = 1;
+        });
+    });
+    Log::flush();
+    return groups.size();
+}
+
+static int run(const std::string& spec_path, const std::string& data_dir, const std::string& out_path) {
+    Spec spec;
+    if (!parse_spec(spec_path, spec)) return 1;
+    const size_t n = spec.configs.size();
+    quiet_logs();
+
+    CopperGoldStrategy loader(data_dir, StrategyParams{});
+    if (!loader.load_data()) {
+        std::cerr << "[ERROR] Failed to load data\n";
+        return 1;
+    }
+    const std::shared_ptr<const MarketData> data = loader.market_data();
+    const WindowPanelSet panels = loader.build_window_panels(spec.configs);
+
+    std::vector<PerformanceMetrics> metrics;
+    std::vector<char> has_metrics;
+    const auto t0 = std::chrono::steady_clock::now();
+    const size_t n_groups = evaluate(data, panels, spec.configs, metrics, has_metrics);
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::ofstream out(out_path);
+    if (!out) {
+        std::cerr << "[ERROR] Cannot write " << out_path << "\n";
+        return 1;
+    }
+    out << "config";
+    for (const Field* f : spec.columns) out << ',' << f->name;
+    out << ',' << METRIC_COLUMNS << '\n';
+    out << std::setprecision(10);
+    for (size_t k = 0; k < n; ++k) {
+        out << k;
+        for (const Field* f : spec.columns) {
+            out << ',';
+            write_field(out, spec.configs[k], *f);
+        }
+        write_metrics(out, has_metrics[k] ? &metrics[k] : nullptr);
+        out << '\n';
+    }
+
+    std::cout << "[INFO] Sweep: " << n << " configs in " << n_groups << " signal groups, "
+              << std::fixed << std::setprecision(2) << secs << "s ("
+              << std::setprecision(0) << (secs > 0.0 ? n * 60.0 / secs : 0.0)
+              << " configs/min) -> " << out_path << "\n";
+    return 0;
+}
+}
+
+// ============================================================
+// Walk-forward optimization
+// ============================================================
+// copper_gold_strategy --walk-forward <spec> [data_dir] [is_years]
+//                      [oos_years] [rolling|anchored] [out_prefix]
+//
+// Slices the panel at calendar-year boundaries into folds. Each fold picks
+// the config of a sweep spec with the best in-sample Sharpe, then trades
+// it on the following out-of-sample years. Rolling folds keep an is_years
+// window; anchored ones grow from the first panel year. Folds advance by
+// oos_years, so the OOS windows tile the panel after the first IS window.
+//
+// Indicators are built once per signal group over the whole history and
+// every fold simulates a slice of those pipelines, so a fold costs only
+// simulator passes and its signals carry the same warm-up as a full run.
+// Per-fold OOS metrics trade each winner from a flat book. The stitched
+// OOS curve is one account: equity, peak and the open book carry across
+// fold boundaries, so the next fold marks the previous fold's positions
+// into its first day and its first rebalance trades from them, paying the
+// usual costs. Writes <out_prefix>_folds.csv (windows, chosen
+// config, IS Sharpe and OOS metrics per fold) and <out_prefix>_equity.csv
+// (the stitched OOS curve), and prints the stitched curve's metrics.
+namespace WalkForward {
+
+struct Fold {
+    size_t is_first, is_last, oos_first, oos_last;   // signal-day indices, [first, last)
+};
+
+static std::vector<Fold> make_folds(const SignalPipeline& sp, size_t is_years, size_t oos_years,
+                                    bool anchored) {
+    const TradingCalendar& cal = sp.calendar;
+    const size_t years = cal.periods(TradingCalendar::YEAR);
+    // First signal day of year y; days.size() past the last year
+    auto year_start = [&](size_t y) {
+        if (y >= years) return sp.days.size();
+        const size_t row = cal.period_start(TradingCalendar::YEAR, y);
+        return static_cast<size_t>(std::lower_bound(sp.days.begin(), sp.days.end(), row,
+            [](const SignalDay& d, size_t r) { return static_cast<size_t>(d.row) < r; })
+            - sp.days.begin());
+    };
+    std::vector<Fold> folds;
+    for (size_t y = is_years; y < years; y += oos_years) {
+        Fold f;
+        f.is_first = year_start(anchored ? 0 : y - is_years);
+        f.is_last = f.oos_first = year_start(y);
+        f.oos_last = year_start(y + oos_years);
+        if (f.is_first < f.is_last && f.oos_first < f.oos_last) folds.push_back(f);
+    }
+    return folds;
+}
+
+// Metrics of `s` traded on signal days [first, last) from a flat book
+static std::optional<PerformanceMetrics> slice_metrics(const CopperGoldStrategy& s,
+                                                       const SignalPipeline& sp,
+                                                       size_t first, size_t last, double capital) {
+    SignalTable t;
+    RunState st(capital);
+    s.simulate(sp, first, last, st, t);
+    if (t.size() < 2) return std::nullopt;
+    return compute_metrics(t, capital);
+}
+
+static int run(const std::string& spec_path, const std::string& data_dir, int is_years,
+               int oos_years, bool anchored, const std::string& out_prefix) {
+    if (is_years < 1 || oos_years < 1) {
+        std::cerr << "[ERROR] Walk-forward windows must be at least one year\n";
+        return 1;
+    }
+    Sweep::Spec spec;
+    if (!Sweep::parse_spec(spec_path, spec)) return 1;
+    const size_t n = spec.configs.size();
+    Sweep::quiet_logs();
+
+    CopperGoldStrategy loader(data_dir, StrategyParams{});
+    if (!loader.load_data()) {
+        std::cerr << "[ERROR] Failed to load data\n";
+        return 1;
+    }
+    const std::shared_ptr<const MarketData> data = loader.market_data();
+    const WindowPanelSet panels = loader.build_window_panels(spec.configs);
+
+    // One full-history pipeline per signal group, shared by every fold
+    const std::vector<std::vector<size_t>> groups = Sweep::group_by_signal(spec.configs);
+    std::vector<size_t> group_of(n);
+    for (size_t g = 0; g < groups.size(); ++g)
+        for (size_t k : groups[g]) group_of[k] = g;
+    std::vector<std::shared_ptr<const SignalPipeline>> pipelines(groups.size());
+    const auto t0 = std::chrono::steady_clock::now();
+    shared_pool().parallel_for(groups.size(), [&](size_t g) {
+        CopperGoldStrategy head(data, spec.configs[groups[g].front()]);
+        head.set_quiet(true);
+        head.set_window_panels(&panels);
+        pipelines[g] = head.build_signals();
+    });
+    auto pipeline_of = [&](size_t k) -> const SignalPipeline& { return *pipelines[group_of[k]]; };
+
+    // The calendar and valid days do not depend on params
+    const SignalPipeline& ref = *pipelines.front();
+    const size_t years = ref.calendar.periods(TradingCalendar::YEAR);
+    if (static_cast<size_t>(is_years) + static_cast<size_t>(oos_years) > years) {
+        std::cerr << "[ERROR] Walk-forward windows of " << is_years << " IS + " << oos_years
+                  << " OOS years do not fit in the panel's " << years << " calendar years\n";
+        return 1;
+    }
+    const std::vector<Fold> folds = make_folds(ref, is_years, oos_years, anchored);
+    if (folds.empty()) {
+        std::cerr << "[ERROR] No walk-forward fold has signal days in both windows\n";
+        return 1;
+    }
+
+    // In-sample Sharpe of every (fold, config)
+    std::vector<double> is_sharpe(folds.size() * n, std::numeric_limits<double>::quiet_NaN());
+    shared_pool().parallel_for(is_sharpe.size(), [&](size_t j) {
+        const Fold& f = folds[j / n];
+        const size_t k = j % n;
+        const StrategyParams& p = spec.configs[k];
+        const auto m = slice_metrics(CopperGoldStrategy(data, p), pipeline_of(k),
+                                     f.is_first, f.is_last, p.initial_capital);
+        if (m) is_sharpe[j] = m->sharpe;
+    });
+
+    // Winner per fold: best finite IS Sharpe, earliest config on ties or
+    // when none is finite
+    std::vector<size_t> chosen(folds.size(), 0);
+    for (size_t f = 0; f < folds.size(); ++f) {
+        double best = -std::numeric_limits<double>::infinity();
+        for (size_t k = 0; k < n; ++k) {
+            const double v = is_sharpe[f * n + k];
+            if (std::isfinite(v) && v > best) { best = v; chosen[f] = k; }
+        }
+    }
+
+    // OOS: each winner alone from a flat book, and all of them stitched
+    // on one carried book
+    std::vector<std::optional<PerformanceMetrics>> oos(folds.size());
+    shared_pool().parallel_for(folds.size(), [&](size_t f) {
+        const StrategyParams& p = spec.configs[chosen[f]];
+        oos[f] = slice_metrics(CopperGoldStrategy(data, p), pipeline_of(chosen[f]),
+                               folds[f].oos_first, folds[f].oos_last, p.initial_capital);
+    });
+    const double start_capital = spec.configs[chosen.front()].initial_capital;
+    SignalTable stitched;
+    std::vector<size_t> stitched_fold;
+    RunState st(start_capital);   // one account across folds, open book included
+    for (size_t f = 0; f < folds.size(); ++f) {
+        CopperGoldStrategy(data, spec.configs[chosen[f]])
+            .simulate(pipeline_of(chosen[f]), folds[f].oos_first, folds[f].oos_last, st, stitched);
+        stitched_fold.resize(stitched.size(), f);
+    }
+    Log::flush();
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const std::string folds_path = out_prefix + "_folds.csv";
+    const std::string equity_path = out_prefix + "_equity.csv";
+    std::ofstream fout(folds_path), eout(equity_path);
+    if (!fout || !eout) {
+        std::cerr << "[ERROR] Cannot write " << (fout ? equity_path : folds_path) << "\n";
+        return 1;
+    }
+    auto date_of = [&](size_t day) { return ref.date_strs[ref.days[day].row]; };
+    fout << "fold,is_start,is_end,oos_start,oos_end,config";
+    for (const Sweep::Field* fld : spec.columns) fout << ',' << fld->name;
+    fout << ",is_sharpe";
+    for (std::string_view rest(Sweep::METRIC_COLUMNS); !rest.empty();)
+        fout << ",oos_" << next_field(rest);
+    fout << '\n' << std::setprecision(10);
+    for (size_t f = 0; f < folds.size(); ++f) {
+        const Fold& fd = folds[f];
+        fout << f << ',' << date_of(fd.is_first) << ',' << date_of(fd.is_last - 1)
+             << ',' << date_of(fd.oos_first) << ',' << date_of(fd.oos_last - 1) << ',' << chosen[f];
+        for (const Sweep::Field* fld : spec.columns) {
+            fout << ',';
+            Sweep::write_field(fout, spec.configs[chosen[f]], *fld);
+        }
+        fout << ',' << is_sharpe[f * n + chosen[f]];
+        Sweep::write_metrics(fout, oos[f] ? &*oos[f] : nullptr);
+        fout << '\n';
+    }
+    eout << "date,fold,config,equity\n" << std::fixed << std::setprecision(2);
+    for (size_t r = 0; r < stitched.size(); ++r)
+        eout << date_from_int(stitched.days()[r]) << ',' << stitched_fold[r] << ','
+             << chosen[stitched_fold[r]] << ',' << stitched.portfolio_equity()[r] << '\n';
+
+    std::cout << "[INFO] Walk-forward: " << folds.size() << (anchored ? " anchored" : " rolling")
+              << " folds (" << is_years << "y IS / " << oos_years << "y OOS), " << n
+              << " configs in " << groups.size() << " signal groups, " << std::fixed
+              << std::setprecision(2) << secs << "s\n";
+    if (stitched.size() >= 2) {
+        const PerformanceMetrics m = compute_metrics(stitched, start_capital);
+        std::cout << "[INFO] Stitched OOS " << date_of(folds.front().oos_first) << " to "
+                  << date_of(folds.back().oos_last - 1) << std::setprecision(4)
+                  << ": return " << m.ann_return * 100.0 << "%/yr, Sharpe " << m.sharpe
+                  << ", Sortino " << m.sortino << ", MaxDD " << m.max_dd * 100.0 << "%\n";
+    }
+    std::cout << "[INFO] Wrote " << folds_path << " and " << equity_path << "\n";
+    return 0;
+}
+}
+
+// ============================================================
+// Streaming check
+// ============================================================
+// Field-by-field, bit-exact comparison of a batch row with a streamed day
+static bool same_signal(const SignalTable::Row& a, const DailySignal& b) {
+    auto eq = [](double x, double y) { return x == y || (std::isnan(x) && std::isnan(y)); };
+    bool same = a.day() == b.day
+        && eq(a.cu_gold_ratio(), b.cu_gold_ratio) && eq(a.roc_10(), b.roc_10)
+        && eq(a.roc_20(), b.roc_20) && eq(a.roc_60(), b.roc_60)
+        && eq(a.signal_ma(), b.signal_ma) && eq(a.ratio_zscore(), b.ratio_zscore)
+        && eq(a.signal_z(), b.signal_z) && eq(a.composite(), b.composite)
+        && a.macro_tilt() == b.macro_tilt
+        && eq(a.growth_signal(), b.growth_signal) && eq(a.inflation_signal(), b.inflation_signal)
+        && eq(a.liquidity_score(), b.liquidity_score) && eq(a.real_rate_10y(), b.real_rate_10y)
+        && eq(a.real_rate_chg_20d(), b.real_rate_chg_20d) && eq(a.real_rate_zscore(), b.real_rate_zscore)
+        && a.regime() == b.regime
+        && eq(a.dxy_momentum(), b.dxy_momentum) && a.dxy_trend() == b.dxy_trend
+        && a.dxy_filter() == b.dxy_filter && a.skip_gold_short() == b.skip_gold_short
+        && eq(a.china_adjustment(), b.china_adjustment) && a.boj_intervention() == b.boj_intervention
+        && a.corr_spike_active() == b.corr_spike_active
+        && eq(a.size_multiplier(), b.size_multiplier) && eq(a.portfolio_equity(), b.portfolio_equity)
+        && eq(a.margin_utilization(), b.margin_utilization)
+        && a.drawdown_warning() == b.drawdown_warning && a.drawdown_stop() == b.drawdown_stop
+        && a.signal_flips_trailing_year() == b.signal_flips_trailing_year
+        && eq(a.spx_price(), b.spx_price);
+    for (InstrumentId id : Inst::ALL)
+        same = same && eq(a.target_contracts(id), b.target_contracts[id])
+            && a.dropped(id) == b.dropped[id];
+    return same;
+}
+
+// copper_gold_strategy --verify-stream [data_dir]: runs the batch pipeline,
+// then warms a streaming instance up on the first half of the calendar,
+// snapshots it, restores the snapshot into a fresh instance and steps that
+// one through the rest with on_bar(), comparing every produced day. The
+// snapshot day is replayed first and must be rejected.
+static int verify_stream(const std::string& data_dir) {
+    StrategyParams params;
+    CopperGoldStrategy batch(data_dir, params);
+    if (!batch.load_data()) {
+        std::cerr << "[ERROR] Failed to load data\n";
+        return 1;
+    }
+    const SignalTable expected = batch.simulate(*batch.build_signals());
+    const std::vector<MarketDay> days = batch.market_days();
+    Log::flush();
+
+    // The streaming instance reads nothing from disk; the batch one feeds it
+    CopperGoldStrategy live(data_dir, params);
+    const size_t split = days.size() / 2;
+    size_t row = live.warm_up({days.begin(), days.begin() + split},
+                              batch.prior_closes(days.front().day));
+
+    const std::string snap_path =
+        (std::filesystem::temp_directory_path() / "copper_gold_stream.state").string();
+    CopperGoldStrategy resumed(data_dir, params);
+    if (!live.save_state(snap_path) || !resumed.restore_state(snap_path)) return 1;
+    std::remove(snap_path.c_str());
+
+    // Replaying the snapshot's own day must be refused and leave the state
+    // as restored, or every later day below diverges
+    size_t mismatches = 0;
+    const MarketDay& last = days[split - 1];
+    if (resumed.on_bar(last.day, last.bars, last.macro)) {
+        std::cerr << "[ERROR] Replayed bar " << date_from_int(last.day) << " was accepted\n";
+        ++mismatches;
+    }
+    for (size_t k = split; k < days.size(); ++k) {
+        const auto sig = resumed.on_bar(days[k].day, days[k].bars, days[k].macro);
+        if (!sig) continue;
+        if (row >= expected.size() || !same_signal(expected[row], *sig)) {
+            if (mismatches++ == 0)
+                std::cerr << "[ERROR] Stream diverges from batch on " << date_from_int(days[k].day) << "\n";
+        }
+        ++row;
+    }
+    Log::flush();
+    if (row != expected.size()) ++mismatches;
+    std::cout << "[INFO] Stream check: " << row << " of " << expected.size()
+              << " signal days, warm-up " << split << " calendar days (resumed from snapshot), "
+              << mismatches << " mismatches\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+// ============================================================
+// Sweep check
+// ============================================================
+// copper_gold_strategy --verify-sweep [data_dir]: evaluates a small grid
+// around the default params through the sweep path (shared window panels,
+// one pipeline per signal group) and compares every config's signal path
+// and metrics with a plain panel-free build_signals() + simulate(), as
+// run() computes them. The panels must reproduce rolling_mean/rolling_std
+// bit for bit.
+static int verify_sweep(const std::string& data_dir) {
+    std::vector<StrategyParams> grid(1);   // defaults first
+    auto vary = [&](auto StrategyParams::* f, auto v) {
+        grid.push_back(grid.front());
+        grid.back().*f = v;
+    };
+    vary(&StrategyParams::ma_fast, 20);
+    vary(&StrategyParams::ma_slow, 100);
+    vary(&StrategyParams::zscore_window, 60);
+    vary(&StrategyParams::liq_zscore_window, 120);
+    vary(&StrategyParams::real_rate_z_window, 60);
+    vary(&StrategyParams::drawdown_warn, 0.05);
+    vary(&StrategyParams::use_fixed_positions, true);
+    Sweep::quiet_logs();
+
+    CopperGoldStrategy loader(data_dir, StrategyParams{});
+    if (!loader.load_data()) {
+        std::cerr << "[ERROR] Failed to load data\n";
+        return 1;
+    }
+    const std::shared_ptr<const MarketData> data = loader.market_data();
+    const WindowPanelSet panels = loader.build_window_panels(grid);
+    std::vector<PerformanceMetrics> metrics;
+    std::vector<char> has_metrics;
+    const size_t n_groups = Sweep::evaluate(data, panels, grid, metrics, has_metrics);
+
+    // Bit-exact; the default book blows through zero, so some metrics are NaN on both sides
+    auto eq = [](double x, double y) { return x == y || (std::isnan(x) && std::isnan(y)); };
+    size_t mismatches = 0;
+    for (size_t k = 0; k < grid.size(); ++k) {
+        CopperGoldStrategy plain(data, grid[k]), paneled(data, grid[k]);
+        plain.set_quiet(true);
+        paneled.set_quiet(true);
+        paneled.set_window_panels(&panels);
+        const std::shared_ptr<const SignalPipeline> ref = plain.build_signals();
+
+        // Signal path first: z-scores reach the metrics only through thresholds
+        SignalTable path;
+        for (const SignalDay& d : paneled.build_signals()->days) path.append(d.sig);
+        bool same = path.size() == ref->days.size();
+        for (size_t r = 0; same && r < path.size(); ++r)
+            same = same_signal(path[r], ref->days[r].sig);
+
+        const SignalTable signals = plain.simulate(*ref);
+        const bool has_ref = signals.size() >= 2;
+        same = same && has_ref == static_cast<bool>(has_metrics[k]);
+        if (same && has_ref) {
+            const PerformanceMetrics a = compute_metrics(signals, grid[k].initial_capital);
+            const PerformanceMetrics& b = metrics[k];
+            same = eq(a.ann_return, b.ann_return) && eq(a.ann_std, b.ann_std)
+                && eq(a.sharpe, b.sharpe) && eq(a.sortino, b.sortino) && eq(a.max_dd, b.max_dd)
+                && eq(a.win_rate, b.win_rate) && eq(a.profit_factor, b.profit_factor)
+                && eq(a.annual_turnover, b.annual_turnover) && eq(a.corr_spx, b.corr_spx)
+                && eq(a.flips_per_year, b.flips_per_year);
+        }
+        if (!same) {
+            ++mismatches;
+            std::cerr << "[ERROR] Sweep config " << k << " differs from a plain run\n";
+        }
+    }
+    Log::flush();
+    std::cout << "[INFO] Sweep check: " << grid.size() << " configs in " << n_groups
+              << " signal groups, " << mismatches << " mismatches\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
 // ============================================================
 // Main
 // ============================================================
 int main(int argc, char* argv[]) {
+    // Cache converter: copper_gold_strategy --build-cache [data_dir]
+    if (argc >= 2 && std::string(argv[1]) == "--build-cache")
+        return build_cache(argc >= 3 ? argv[2] : "./data/raw");
+    // Streaming and snapshot check: copper_gold_strategy --verify-stream [data_dir]
+    if (argc >= 2 && std::string(argv[1]) == "--verify-stream")
+        return verify_stream(argc >= 3 ? argv[2] : "./data/raw");
+    // Sweep panel check: copper_gold_strategy --verify-sweep [data_dir]
+    if (argc >= 2 && std::string(argv[1]) == "--verify-sweep")
+        return verify_sweep(argc >= 3 ? argv[2] : "./data/raw");
+    // Parameter sweep: copper_gold_strategy --sweep <spec> [data_dir] [out.csv]
+    if (argc >= 3 && std::string(argv[1]) == "--sweep")
+        return Sweep::run(argv[2], argc >= 4 ? argv[3] : "./data/raw",
+                          argc >= 5 ? argv[4] : "sweep_results.csv");
+    // Walk-forward: copper_gold_strategy --walk-forward <spec> [data_dir] [is_years]
+    //               [oos_years] [rolling|anchored] [out_prefix]
+    if (argc >= 3 && std::string(argv[1]) == "--walk-forward") {
+        int is_years = 5, oos_years = 1;
+        auto years_arg = [&](int k, int& out) {
+            if (argc <= k) return true;
+            std::string_view v(argv[k]);
+            auto r = std::from_chars(v.data(), v.data() + v.size(), out);
+            return r.ec == std::errc() && r.ptr == v.data() + v.size() && out >= 1;
+        };
+        const std::string mode = argc >= 7 ? argv[6] : "rolling";
+        if (!years_arg(4, is_years) || !years_arg(5, oos_years)
+            || (mode != "rolling" && mode != "anchored")) {
+            std::cerr << "[ERROR] Usage: " << argv[0] << " --walk-forward <spec> [data_dir]"
+                      << " [is_years >= 1] [oos_years >= 1] [rolling|anchored] [out_prefix]\n";
+            return 1;
+        }
+        return WalkForward::run(argv[2], argc >= 4 ? argv[3] : "./data/raw", is_years, oos_years,
+                                mode == "anchored", argc >= 8 ? argv[7] : "walk_forward");
+    }
+
     std::cout << "[INFO] Copper-Gold Strategy v2.0\n";
 
     std::string data_dir = "./data/raw";
@@ -1711,22 +5759,23 @@ int main(int argc, char* argv[]) {
 
     std::cout << "\n======= FINAL RESULTS =======\n";
     if (!signals.empty()) {
-        const auto& last = signals.back();
-        std::cout << "Final Date:   " << last.date << "\n";
-        std::cout << "Final Equity: $" << std::fixed << std::setprecision(2) << last.portfolio_equity << "\n";
+        const auto last = signals.back();
+        std::cout << "Final Date:   " << last.date() << "\n";
+        std::cout << "Final Equity: $" << std::fixed << std::setprecision(2) << last.portfolio_equity() << "\n";
         std::cout << "Total Return: " << std::setprecision(2)
-                  << ((last.portfolio_equity / initial_capital) - 1.0) * 100.0 << "%\n";
-        std::cout << "Final Signal: " << tilt_str(last.macro_tilt) << "\n";
-        std::cout << "Final Regime: " << regime_str(last.regime) << "\n";
-        std::cout << "Signal Flips (trailing year): " << last.signal_flips_trailing_year << "\n";
+                  << ((last.portfolio_equity() / initial_capital) - 1.0) * 100.0 << "%\n";
+        std::cout << "Final Signal: " << tilt_str(last.macro_tilt()) << "\n";
+        std::cout << "Final Regime: " << regime_str(last.regime()) << "\n";
+        std::cout << "Signal Flips (trailing year): " << last.signal_flips_trailing_year() << "\n";
 
         if (!use_fixed) {
             std::cout << "Final Margin Util: " << std::setprecision(1)
-                      << (last.margin_utilization * 100.0) << "%\n";
+                      << (last.margin_utilization() * 100.0) << "%\n";
             std::cout << "\nFinal Positions:\n";
-            for (const auto& [sym, qty] : last.target_contracts) {
+            for (InstrumentId id : Inst::ALL) {
+                double qty = last.target_contracts(id);
                 if (qty != 0.0)
-                    std::cout << "  " << sym << ": " << qty << " contracts\n";
+                    std::cout << "  " << Inst::symbol(id) << ": " << qty << " contracts\n";
             }
         }
 
@@ -1737,133 +5786,35 @@ int main(int argc, char* argv[]) {
         // ============================================================
         std::cout << "\n======= PERFORMANCE METRICS =======\n";
 
-        std::vector<double> daily_equity;
-        daily_equity.push_back(initial_capital);
-        for (const auto& sig : signals)
-            daily_equity.push_back(sig.portfolio_equity);
-
-        int N = (int)daily_equity.size() - 1;
-        if (N < 2) { std::cout << "Insufficient data for metrics.\n"; return 0; }
-
-        std::vector<double> daily_returns(N);
-        for (int i = 0; i < N; ++i)
-            daily_returns[i] = (daily_equity[i+1] - daily_equity[i]) / daily_equity[i];
-
-        double total_days = N;
-        double total_return = (daily_equity.back() / daily_equity.front()) - 1.0;
-        double ann_return = std::pow(1.0 + total_return, 252.0 / total_days) - 1.0;
-
-        double mean_ret = 0.0;
-        for (double r : daily_returns) mean_ret += r;
-        mean_ret /= N;
-
-        double var = 0.0;
-        for (double r : daily_returns) var += (r - mean_ret) * (r - mean_ret);
-        var /= N;
-        double ann_std = std::sqrt(var) * std::sqrt(252.0);
-
-        double sharpe = (ann_std > 0.0) ? ann_return / ann_std : 0.0;
-
-        double downside_var = 0.0;
-        int downside_count = 0;
-        for (double r : daily_returns) {
-            if (r < 0.0) { downside_var += r * r; downside_count++; }
-        }
-        double downside_std = (downside_count > 0)
-            ? std::sqrt(downside_var / downside_count) * std::sqrt(252.0) : 0.0;
-        double sortino = (downside_std > 0.0) ? ann_return / downside_std : 0.0;
-
-        double peak = initial_capital, max_dd = 0.0;
-        for (double eq : daily_equity) {
-            if (eq > peak) peak = eq;
-            double dd = (peak - eq) / peak;
-            if (dd > max_dd) max_dd = dd;
-        }
-
-        double gross_profit = 0.0, gross_loss = 0.0;
-        int wins = 0;
-        for (double r : daily_returns) {
-            double pnl = r * daily_equity[0];
-            if (pnl > 0.0) { gross_profit += pnl; wins++; }
-            else if (pnl < 0.0) { gross_loss += std::abs(pnl); }
-        }
-        double win_rate = (N > 0) ? (double)wins / N : 0.0;
-        double profit_factor = (gross_loss > 0.0) ? gross_profit / gross_loss : 0.0;
-
-        double total_notional_traded = 0.0;
-        for (int i = 1; i < (int)signals.size(); ++i) {
-            for (const auto& [sym, qty] : signals[i].target_contracts) {
-                double prev_qty = 0.0;
-                auto it = signals[i-1].target_contracts.find(sym);
-                if (it != signals[i-1].target_contracts.end()) prev_qty = it->second;
-                total_notional_traded += std::abs(qty - prev_qty) * ContractSpec::get(sym).notional;
-            }
-        }
-        double avg_equity = 0.0;
-        for (const auto& sig : signals) avg_equity += sig.portfolio_equity;
-        avg_equity /= (double)signals.size();
-        double years = total_days / 252.0;
-        double annual_turnover = (avg_equity > 0.0 && years > 0.0)
-            ? (total_notional_traded / years) / avg_equity : 0.0;
-
-        int all_flips = 0;
-        MacroTilt prev_t = MacroTilt::NEUTRAL;
-        for (const auto& sig : signals) {
-            if (sig.macro_tilt != prev_t) { all_flips++; prev_t = sig.macro_tilt; }
-        }
-        double flips_per_year = (years > 0.0) ? all_flips / years : 0.0;
-
-        // Correlation to SPX — doc line 603: minimum < 0.5, target < 0.3
-        double corr_spx = 0.0;
-        {
-            std::vector<double> spx_rets, strat_rets;
-            for (int i = 1; i < (int)signals.size(); ++i) {
-                if (signals[i].spx_price > 0.0 && signals[i-1].spx_price > 0.0) {
-                    spx_rets.push_back((signals[i].spx_price / signals[i-1].spx_price) - 1.0);
-                    strat_rets.push_back((signals[i].portfolio_equity / signals[i-1].portfolio_equity) - 1.0);
-                }
-            }
-            int M = (int)spx_rets.size();
-            if (M > 2) {
-                double ms = 0.0, mp = 0.0;
-                for (int j = 0; j < M; ++j) { ms += strat_rets[j]; mp += spx_rets[j]; }
-                ms /= M; mp /= M;
-                double cov = 0.0, vs = 0.0, vp = 0.0;
-                for (int j = 0; j < M; ++j) {
-                    double ds = strat_rets[j] - ms, dp = spx_rets[j] - mp;
-                    cov += ds * dp; vs += ds * ds; vp += dp * dp;
-                }
-                double denom = std::sqrt(vs * vp);
-                if (denom > 0.0) corr_spx = cov / denom;
-            }
-        }
+        if (signals.size() < 2) { std::cout << "Insufficient data for metrics.\n"; return 0; }
+        const PerformanceMetrics pm = compute_metrics(signals, initial_capital);
 
         std::cout << std::fixed << std::setprecision(4);
-        std::cout << "Annualized Return:    " << ann_return * 100.0 << "%\n";
-        std::cout << "Annualized Volatility:" << ann_std * 100.0 << "%\n";
-        std::cout << "Sharpe Ratio:         " << sharpe
-                  << (sharpe >= 0.8 ? " ✓ (>=0.8)" : " ✗ (<0.8 threshold)") << "\n";
-        std::cout << "Sortino Ratio:        " << sortino
-                  << (sortino >= 1.0 ? " ✓ (>=1.0)" : " ✗ (<1.0 threshold)") << "\n";
-        std::cout << "Max Drawdown:         " << max_dd * 100.0 << "%"
-                  << (max_dd < 0.20 ? " ✓ (<20%)" : " ✗ (>=20% threshold)") << "\n";
-        std::cout << "Win Rate:             " << win_rate * 100.0 << "%"
-                  << (win_rate >= 0.45 ? " ✓ (>=45%)" : " ✗ (<45% threshold)") << "\n";
-        std::cout << "Profit Factor:        " << profit_factor
-                  << (profit_factor >= 1.3 ? " ✓ (>=1.3)" : " ✗ (<1.3 threshold)") << "\n";
-        std::cout << "Annual Turnover:      " << annual_turnover << "x"
-                  << (annual_turnover < 15.0 ? " ✓ (<15x)" : " ✗ (>=15x threshold)") << "\n";
-        std::cout << "Correlation to SPX:   " << corr_spx
-                  << (std::abs(corr_spx) < 0.5 ? " ✓ (<0.5)" : " ✗ (>=0.5 threshold)") << "\n";
-        std::cout << "Signal Flips/Year:    " << std::setprecision(1) << flips_per_year
-                  << (flips_per_year <= 12.0 ? " ✓ (<=12)" : " ✗ (>12 — overfit warning)") << "\n";
+        std::cout << "Annualized Return:    " << pm.ann_return * 100.0 << "%\n";
+        std::cout << "Annualized Volatility:" << pm.ann_std * 100.0 << "%\n";
+        std::cout << "Sharpe Ratio:         " << pm.sharpe
+                  << (pm.sharpe >= 0.8 ? " ✓ (>=0.8)" : " ✗ (<0.8 threshold)") << "\n";
+        std::cout << "Sortino Ratio:        " << pm.sortino
+                  << (pm.sortino >= 1.0 ? " ✓ (>=1.0)" : " ✗ (<1.0 threshold)") << "\n";
+        std::cout << "Max Drawdown:         " << pm.max_dd * 100.0 << "%"
+                  << (pm.max_dd < 0.20 ? " ✓ (<20%)" : " ✗ (>=20% threshold)") << "\n";
+        std::cout << "Win Rate:             " << pm.win_rate * 100.0 << "%"
+                  << (pm.win_rate >= 0.45 ? " ✓ (>=45%)" : " ✗ (<45% threshold)") << "\n";
+        std::cout << "Profit Factor:        " << pm.profit_factor
+                  << (pm.profit_factor >= 1.3 ? " ✓ (>=1.3)" : " ✗ (<1.3 threshold)") << "\n";
+        std::cout << "Annual Turnover:      " << pm.annual_turnover << "x"
+                  << (pm.annual_turnover < 15.0 ? " ✓ (<15x)" : " ✗ (>=15x threshold)") << "\n";
+        std::cout << "Correlation to SPX:   " << pm.corr_spx
+                  << (std::abs(pm.corr_spx) < 0.5 ? " ✓ (<0.5)" : " ✗ (>=0.5 threshold)") << "\n";
+        std::cout << "Signal Flips/Year:    " << std::setprecision(1) << pm.flips_per_year
+                  << (pm.flips_per_year <= 12.0 ? " ✓ (<=12)" : " ✗ (>12 — overfit warning)") << "\n";
 
         std::cout << "\n======= KILL CRITERIA =======\n";
-        if (flips_per_year > 20.0)
-            std::cout << "❌ KILL CRITERION TRIGGERED: Signal flips " << flips_per_year
+        if (pm.flips_per_year > 20.0)
+            std::cout << "❌ KILL CRITERION TRIGGERED: Signal flips " << pm.flips_per_year
                       << "/year (>20 threshold). Stop development.\n";
         else
-            std::cout << "✓ Kill criterion passed: " << flips_per_year
+            std::cout << "✓ Kill criterion passed: " << pm.flips_per_year
                       << " flips/year (<=20 threshold)\n";
     }
 